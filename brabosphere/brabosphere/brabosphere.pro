@@ -27,6 +27,7 @@ HEADERS += include/aboutbox.h \
            include/commandhistory.h \
            include/densitybase.h \
            include/densitygrid.h \
+           include/densitypyramidthread.h \
            include/glmoleculeview.h \
            include/globalbase.h \
            include/glorbitalview.h \
@@ -37,15 +38,18 @@ HEADERS += include/aboutbox.h \
            include/loaddensitythread.h \
            include/loadpltthread.h \
            include/newatombase.h \
+           include/orbitalcache.h \
            include/orbitalthread.h \
            include/orbitalviewerbase.h \
            include/paths.h \
            include/plotmapbase.h \
            include/plotmaplabel.h \
+           include/pointbuffer.h \
            include/preferencesbase.h \
            include/relaxbase.h \
            include/splash.h \
            include/statustext.h \
+           include/triangleorder.h \
            include/utils.h \
            include/xbrabo.h \
            include/xbraboview.h
@@ -57,6 +61,7 @@ SOURCES += source/aboutbox.cpp \
            source/commandhistory.cpp \
            source/densitybase.cpp \
            source/densitygrid.cpp \
+           source/densitypyramidthread.cpp \
            source/glmoleculeview.cpp \
            source/globalbase.cpp \
            source/glorbitalview.cpp \
@@ -67,14 +72,17 @@ SOURCES += source/aboutbox.cpp \
            source/loadpltthread.cpp \
            source/main.cpp \
            source/newatombase.cpp \
+           source/orbitalcache.cpp \
            source/orbitalthread.cpp \
            source/orbitalviewerbase.cpp \
            source/paths.cpp \
            source/plotmapbase.cpp \
            source/plotmaplabel.cpp \
+           source/pointbuffer.cpp \
            source/preferencesbase.cpp \
            source/relaxbase.cpp \
            source/statustext.cpp \
+           source/triangleorder.cpp \
            source/utils.cpp \
            source/xbrabo.cpp \
            source/xbraboview.cpp
@@ -355,6 +355,21 @@ class CommandSelectNone : public CommandSelection
     virtual bool initialRun();          // Selects all atoms
 };
 
+///// class CommandSelectNeighbours ///////////////////////////////////////////
+class CommandSelectNeighbours : public CommandSelection
+{
+  public:
+    ///// constructor/destructor
+    CommandSelectNeighbours(XbraboView* parent, const QString description, const double radius); // constructor
+    virtual CommandSelectNeighbours* clone() const;  // virtual copy constructor
+
+    ///// public member functions
+    virtual bool initialRun();          // Selects the atoms near the selected atoms
+
+  private:
+    double selectionRadius;             // The distance from the selected atoms within which atoms are selected.
+};
+
 ///// class CommandSelectEntity ///////////////////////////////////////////////
 class CommandSelectEntity : public CommandSelection
 {
@@ -24,18 +24,20 @@
 ///// Forward class declarations & header files ///////////////////////////////
 
 // STL includes
+#include <list>
 #include <vector>
 
 // Qt forward class declarations
 class QFile;
 
 // Xbrabo forward class declarations
-class DensityGrid;
+class AtomSet;
 class LoadDensityThread;
 class MappedSurfaceWidget;
 
 // Xbrabo includes
 #include <point3d.h>
+#include "densitygrid.h"
 
 // Base class header files
 #include "densitywidget.h"
@@ -47,7 +49,7 @@ class DensityBase : public DensityWidget
 
   public:
     ///// constructor/destructor
-    DensityBase(DensityGrid* grid, QWidget* parent = 0, const char* name = 0, bool modal = FALSE, WFlags fl = 0);       // constructor
+    DensityBase(DensityGrid* grid, AtomSet* atomSet = 0, const std::list<unsigned int>* selection = 0, QWidget* parent = 0, const char* name = 0, bool modal = FALSE, WFlags fl = 0);       // constructor
     ~DensityBase();                     // destructor
 
     ///// public enums
@@ -76,6 +78,7 @@ class DensityBase : public DensityWidget
     void addSurfacePair();              // adds a pair of surfaces with opposite signs
     void deleteSurface();               // deletes an existing surface
     void updateAll();                   // updates all changes
+    void updateMissRatio();             // shows the vertex cache miss ratios of the selected surface
 
   protected:
     void customEvent(QCustomEvent* e);  // reimplemented to receive events from loadingThread
@@ -97,6 +100,8 @@ class DensityBase : public DensityWidget
     void resetVolumeMaxima();           // resets the maxima for rendering volumes to their original values
     void resetSliceMaxima();            // resets the maxima for rendering slices to their original values
     void checkUpdate();                 // calls updateAll if automatic updates are enabled
+    void updateRegionWidgets();         // enables/disables the widgets for the region of interest
+    void updateTriangleOrder();         // switches the reordering of the triangles of surfaces on or off
 
   private:
     friend class GLMoleculeView; // temporary for volume rendering test2
@@ -116,6 +121,7 @@ class DensityBase : public DensityWidget
     bool updateIsoSurfaces();           // updates all changes concerning isosurfaces
     bool updateVolume();                // updates all changes concerning volumetric rendering
     bool updateSlice();                 // updates all changes concerning slices.
+    DensityGrid::Region selectionRegion() const;  // returns the region of interest around the selected atoms
 
     ///// private structs
     struct SurfaceProperties            
@@ -152,6 +158,9 @@ class DensityBase : public DensityWidget
 
     ///// private member data
     DensityGrid* densityGrid;           ///< A pointer to the DensityGrid.
+    AtomSet* atoms;                     ///< A pointer to the atoms for determining the region of interest.
+    const std::list<unsigned int>* selectedAtoms; ///< A pointer to the list of selected atoms.
+    DensityGrid::Region surfaceRegion;  ///< The region of interest used for the current isosurfaces.
     unsigned int idCounter;             ///< A counter for uniquely identifying defined surfaces.
     std::vector<SurfaceProperties> surfaceProperties;       ///< A list of the properties of each defined surface.
     LoadDensityThread* loadingThread;   ///< A thread that does the actual reading of the density points from the grid file.
@@ -32,6 +32,10 @@ using std::vector;
 // Qt forward class declarations
 class QColor;
 class QImage;
+class QObject;
+
+// Xbrabo forward class declarations
+class DensityPyramidThread;
 
 // Xbrabo includes
 #include <point3d.h>
@@ -49,16 +53,51 @@ class DensityGrid
                       MAP_WHITE_RAINBOW_BLACK, MAP_BLUE_MAGENTA_RED, MAP_RED_MAGENTA_BLUE,
                       MAP_LAST};        ///< currently equal to the possibilities in the class MappedSurfaceWidget
     enum Plane{PLANE_XY, PLANE_XZ, PLANE_YZ, PLANE_ZX};     ///< Different orientations for slices
+    enum SurfaceEngine{ENGINE_MARCHING_CUBES = 0, ENGINE_FLYING_EDGES, ENGINE_LAST};  ///< The available isosurface extraction algorithms
+    enum RegionType{REGION_NONE = 0, REGION_BOX, REGION_SPHERE};    ///< The shapes of a region of interest
+
+    ///// public structs
+    struct Region
+    /// Describes a region of interest to which the calculation of a surface is limited.
+    {
+      Region() : type(REGION_NONE), radius(0.0f) {}
+      bool operator==(const Region& r) const
+      /// Returns whether both regions cover the same part of space.
+      {
+        if(type != r.type)
+          return false;
+        if(type == REGION_BOX)
+          return minimum == r.minimum && maximum == r.maximum;
+        if(type == REGION_SPHERE)
+          return center == r.center && radius == r.radius;
+        return true;
+      }
+      unsigned int type;                ///< corresponds to the enum RegionType
+      Point3D<float> minimum;           ///< the lower corner of a box
+      Point3D<float> maximum;           ///< the upper corner of a box
+      Point3D<float> center;            ///< the center of a sphere
+      float radius;                     ///< the radius of a sphere
+    };
 
     ///// public member functions for changing data
-	  void setParameters(const std::vector<double>* values, const Point3D<unsigned int>& pointDimension, const Point3D<float>& pointDelta, const Point3D<float>& pointOrigin);         // set up the parameters for the surface 
+	  void setParameters(const std::vector<double>* values, const Point3D<unsigned int>& pointDimension, const Point3D<float>& pointDelta, const Point3D<float>& pointOrigin, const bool calculateLevels = true);         // set up the parameters for the surface 
     void setMappingParameters(const std::vector<double>* values, const unsigned int map, const float maxValue, const float minValue);       // sets up the mapping density for the given regular density and the color map
-	  void addSurface(const double isoDensity); // calculates a new surface
-    void changeSurface(const unsigned int surface, const double isoDensity);      // recalculates a surface
+	  void addSurface(const double isoDensity, const Region& region = Region()); // calculates a new surface
+    void changeSurface(const unsigned int surface, const double isoDensity, const Region& region = Region());      // recalculates a surface
+    void recalculateSurface(const unsigned int surface);  // recalculates a surface with its own isodensity and region
+    bool refreshSurface(const unsigned int surface);  // recalculates a surface if the surface resolution asks for another level
+    void setSurfaceEngine(const unsigned int engine); // sets the algorithm used for calculating surfaces
+    void setSurfaceResolution(const unsigned int size); // sets the number of points along each direction sufficient for calculating surfaces
+    void setOptimizeTriangleOrder(const bool optimize); // sets whether the triangles of surfaces are reordered for vertex cache locality
+    void setOrderReceiver(QObject* receiver);   // sets the object notified when triangles reordered in the background are ready
+    void updateTriangleOrder(vector<unsigned int>& surfaces); // uses the triangle orders calculated in the background
 
     ///// public member functions for retrieving data
     bool densityPresent() const;          // returns whether a density has been loaded
     bool hasMapping() const;              // returns whether a mapping density is present
+    unsigned int surfaceEngine() const;   // returns the algorithm used for calculating surfaces
+    bool optimizeTriangleOrder() const;   // returns whether the triangles of surfaces are reordered
+    bool missRatios(const unsigned int surface, float& original, float& ordered) const; // returns the vertex cache miss ratios of a surface before and after reordering
     unsigned int numSurfaces() const;     // returns the number of calculated surfaces
     unsigned int numTriangles(const unsigned int surface) const;        // returns the number of triangles a certain surface consists of
 	  unsigned int numVertices(const unsigned int surface) const;         // returns the number of points a certain surface consists of
@@ -70,31 +109,74 @@ class DensityGrid
     void clearParameters();               // clear all data
     void clearSurfaces();                 // removes all existing surfaces
     void removeSurface(const unsigned int surface); // removes a certain surface
-    Point3D<float> getOrigin() const;               // returns the set origin
-    Point3D<float> getDelta() const;                // returns the set deltas
-    Point3D<unsigned int> getNumPoints() const;     // returns the number of points in all directions
+    Point3D<float> getOrigin(const unsigned int level = 0) const;           // returns the set origin
+    Point3D<float> getDelta(const unsigned int level = 0) const;            // returns the set deltas
+    Point3D<unsigned int> getNumPoints(const unsigned int level = 0) const; // returns the number of points in all directions
+    unsigned int numLevels() const;                 // returns the number of available resolution levels
+    unsigned int levelForSize(const unsigned int size) const; // returns the finest level fitting the given number of points
     double getMaximumDensity() const;               // returns the most positive value of the density
     double getMinimumDensity() const;               // returns the most negative value of the density
     QImage getSlice(const unsigned int plane, const unsigned int index, const QColor& positiveColor, const QColor& negativeColor, 
-                    const double maxPlotValue, const double minPlotValue, const unsigned int colorMap = MAP_LAST) const;// Returns an image to be used as a slice
+                    const double maxPlotValue, const double minPlotValue, const unsigned int colorMap = MAP_LAST, const unsigned int level = 0) const;// Returns an image to be used as a slice
 
   private:
+    ///// private enums
+    enum FlyingEdgesPass{PASS_CLASSIFY, PASS_COUNT, PASS_GENERATE}; ///< The passes of the flying edges engine processed per slice
+
+    ///// private classes
+    class SliceWorker;
+    friend class SliceWorker;
+    class OrderWorker;
+
 	  ///// private structs
 	  struct Triangle
     /// A utility struct containing the ID's of 3 points making up a triangle.
 	  {
       unsigned int pointID[3];
 	  };
+    struct RowInfo
+    /// A utility struct containing the flying edges data for a row of grid points along z.
+    {
+      unsigned int edgeMin, edgeMax;    ///< the range of grid points with intersected edges along z
+      unsigned int vertexMin, vertexMax;///< the range of grid points owning intersected edges
+      unsigned int cellMin, cellMax;    ///< the range of cells possibly containing triangles
+      unsigned int numVertices;         ///< the number of vertices owned by the row
+      unsigned int numTriangles;        ///< the number of triangles generated by the row of cells
+      unsigned int firstVertex;         ///< the index of the first vertex of the row in the output
+      unsigned int firstTriangle;       ///< the index of the first triangle of the row in the output
+    };
 
     ///// private member functions
+    unsigned int extractSurface(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices, const Region& region = Region());    // calculates a surface with the active engine
+    unsigned int surfaceLevel() const;    // returns the resolution level to use for surfaces
+    void extractSurfaceRegion(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices, const Region& region); // calculates a surface limited to a region
+    void extractSurfaceEngine(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices); // calculates a surface for the whole grid with the active engine
+    bool regionPoints(const Region& region, Point3D<unsigned int>& firstPoint, Point3D<unsigned int>& lastPoint) const;  // returns the range of grid points covering a region
+    void clipSurface(const Region& region, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices) const; // removes the triangles outside a spherical region
     void calculateSurface(const double isoDensity); // does the basic surface calculation
+    bool classifyCells(const unsigned int x, const unsigned int y); // determines the table lookup indices for a row of cells
+    void calculateSurfaceFlyingEdges(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices); // calculates a surface using flying edges
+    void runPass(const unsigned int pass, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices); // runs a flying edges pass over all slices, in parallel for large grids
+    void processSlice(const unsigned int pass, const unsigned int x, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices); // runs a flying edges pass over the rows of a slice
+    void classifyRow(const unsigned int row);       // flying edges pass 1: classifies the grid points and edges along z of a row
+    void countRow(const unsigned int x, const unsigned int y);  // flying edges pass 2: counts the vertices and triangles of a row
+    void generateRow(const unsigned int x, const unsigned int y, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices); // flying edges pass 4: generates the vertices and triangles of a row
+    void gridRange(const unsigned int* rows, const unsigned int count, unsigned int& first, unsigned int& last) const;   // returns the range of grid points where edges between the rows can be intersected
+    unsigned int edgeCuts(const unsigned int x, const unsigned int y, const unsigned int z) const;  // returns the intersected edges owned by a grid point
+    unsigned int cellCase(const unsigned int x, const unsigned int y, const unsigned int z) const;  // returns the table lookup index of a cell
     Point3D<float> intersection(const unsigned int x, const unsigned int y, const unsigned int z, const unsigned int edge);    // calculates the intersection
     Point3D<float> interpolate(const Point3D<float> point1, const Point3D<float> point2, const double var1, const double var2);   // linear interpolation
 	  unsigned int getEdgeID(const unsigned int x, const unsigned int y, const unsigned int z, const unsigned int edge);  // returns the ID of the edge 
 	  unsigned int getVertexID(const unsigned int x, const unsigned int y, const unsigned int z);     // returns the ID of the vertex 
 	  void renameVerticesAndTriangles(vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices);  // renames the vertices and triangles
     void calculateNormals(vector<float>* singleNormals, const unsigned int surface);        // calculates the normals
+    void finishSurface(const unsigned int surface);   // calculates the normals and optionally reorders the triangles
+    void startTriangleOrder(const unsigned int surface);  // reorders the triangles of a surface, in the background if a receiver is set
+    void applyTriangleOrder(OrderWorker* worker, vector<unsigned int>& surfaces); // uses the triangle order calculated by a worker
+    void stopTriangleOrders();            // waits for all background reorderings to finish and discards them
     unsigned int getArrayIndex(const unsigned int x, const unsigned int y, const unsigned int z) const;         // returns the index into the densityValues array
+    const vector<double>& levelValues(const unsigned int level) const; // returns the density values of a resolution level
+    void stopPyramid();                   // stops the calculation of the resolution levels
     QColor mapColor(const double value) const;    // returns the color from the active color map on a scale of value (0.0 - 1.0)
 
     ///// private member data
@@ -107,17 +189,36 @@ class DensityGrid
     vector<Triangle> triangles;           ///< the list of triangles forming the isosurface
     double currentIsoLevel;               ///< holds the current isodensity value
     vector<double> isoLevels;             ///< a list of isodensity values for each calculated surface
+    vector<Region> surfaceRegions;        ///< the region of interest of each calculated surface
+    vector<unsigned int> surfaceLevels;   ///< the resolution level each surface was calculated at
     vector< vector<Point3D<float> >* > verticesList;///< an easily accessible list of vertices for each calculated surface
     vector< vector<unsigned int>* > triangleIndices;///< an easily accessible list of vertex indices for each calculated surface
     vector< vector<float>* > normals;     ///< a list of normals for each calculated surface
     mutable unsigned int colorMap;        ///< holds the current color map type (temporarily mutated only in getSlice)
     double maxDensity, minDensity;        ///< hold the extrema of the density values
     double maxMapValue, minMapValue;      ///< hold the extrema between which the mapping colors have to be interpolated
+    unsigned int engine;                  ///< the algorithm used for calculating surfaces
+    vector<unsigned char> cellCases;      ///< marching cubes: the table lookup indices for a row of cells along z
+    vector<unsigned char> pointStates;    ///< flying edges: 1 for each grid point below the isodensity, 0 otherwise
+    vector<RowInfo> rowInfo;              ///< flying edges: the data for each row of grid points along z
+    DensityPyramidThread* pyramidThread;  ///< the thread calculating the downsampled resolution levels
+    vector< vector<double> > pyramidValues;         ///< the density values of the downsampled levels (level 1 and up)
+    vector<Point3D<unsigned int> > pyramidPoints;   ///< the number of points in the 3 directions for the downsampled levels
+    unsigned int surfaceResolution;       ///< the number of points along each direction sufficient for surfaces (0 = full resolution)
+    bool optimizeOrder;                   ///< whether the triangles of surfaces are reordered for vertex cache locality
+    QObject* orderReceiver;               ///< the object notified when a background reordering is ready (0 = reorder synchronously)
+    vector<OrderWorker*> orderWorkers;    ///< the threads reordering the triangles of surfaces in the background
+    vector<unsigned int> surfaceSerials;  ///< a unique number for each calculated version of each surface
+    unsigned int serialCounter;           ///< the last number handed out as a surface serial
+    vector<float> originalMissRatios;     ///< the vertex cache miss ratio of each surface as calculated (negative = not known yet)
+    vector<float> orderedMissRatios;      ///< the vertex cache miss ratio of each surface after reordering (negative = not known yet)
 
 	  ///// private static member data
 	  static const unsigned int edgeTable[256];        ///< lookup table for edges
 	  static const int triTable[256][16];     ///< lookup table for triangles. The original implementation used unsigned ints which is very
                                             ///< strange as the table contains negative number. Works either way, though.
+    static const unsigned int triangleCountTable[256];///< lookup table for the number of triangles in each entry of triTable
+    static const unsigned int parallelPoints;         ///< the minimum number of grid points for running the flying edges passes with multiple threads
 };
 
 #endif
@@ -0,0 +1,65 @@
+/***************************************************************************
+                   densitypyramidthread.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/// \file
+/// Contains the declaration of the class DensityPyramidThread.
+
+#ifndef DENSITYPYRAMIDTHREAD_H
+#define DENSITYPYRAMIDTHREAD_H
+
+///// Forward class declarations & header files ///////////////////////////////
+
+// STL includes
+#include <vector>
+
+// Xbrabo includes
+#include "point3d.h"
+
+// Qt includes
+#include <qmutex.h>
+
+// Base class header files
+#include <qthread.h>
+
+///// class DensityPyramidThread //////////////////////////////////////////////
+class DensityPyramidThread : public QThread
+{
+  public:
+    ///// constructor/destructor
+    DensityPyramidThread(const double* densityValues, const Point3D<unsigned int>& points, std::vector< std::vector<double> >* levelValues, std::vector<Point3D<unsigned int> >* levelPoints);  // constructor
+    ~DensityPyramidThread();            // destructor
+
+    ///// public member functions
+    void stop();                        // requests stopping the thread
+
+  private:
+    ///// private member functions
+    virtual void run();                 // reimplementation of this pure virtual does the actual work
+    bool isStopRequested();             // returns whether stopping the thread was requested
+    void downsample(const double* source, const Point3D<unsigned int>& sourcePoints, std::vector<double>& target, const Point3D<unsigned int>& targetPoints);  // filters a grid into a grid with half the resolution
+    static void halveAxis(const double* source, const unsigned int outer, const unsigned int count, const unsigned int inner, double* target); // filters one direction of a grid to half the resolution
+
+    ///// private member data
+    const double* fullValues;           ///< The full resolution density values.
+    Point3D<unsigned int> fullPoints;   ///< The number of full resolution points in each direction.
+    std::vector< std::vector<double> >* values;   ///< The density values of each calculated level.
+    std::vector<Point3D<unsigned int> >* numPoints; ///< The number of points in each direction for each calculated level.
+    bool stopRequested;                 ///< Is set to true if the thread should be stopped.
+    QMutex stopMutex;                   ///< Locks stopRequested.
+};
+
+#endif
+
@@ -27,6 +27,10 @@
 #include <list>
 #include <vector>
 
+// Qt forward class declarations
+class QCustomEvent;
+class QTimer;
+
 // Xbrabo forward class declarations
 class AtomSet;
 class DensityGrid;
@@ -61,10 +65,16 @@ class GLMoleculeView : public GLSimpleMoleculeView
       int maximumSize;                  ///< The maximum size of a 2D/3D texture (should be a power of 2)
       bool use3DTextures;               ///< Determines whether 3D texturing is used instead of stacks of 2D textures
     };
+    struct GLSurfaceParameters
+    /// A struct containing all the parameters pertaining to the calculation of isosurfaces.
+    {
+      unsigned int engine;              ///< The algorithm used for calculating isosurfaces (corresponds to DensityGrid::SurfaceEngine)
+    };
 
     ///// static public member functions
     static void toggleSelectionMode();  // Toggles the manipulation target
     static void setParameters(GLTextureParameters params);  // sets new OpenGL texture parameters
+    static void setParameters(GLSurfaceParameters params);  // sets new isosurface parameters
 
   signals:
     void atomsetChanged();              ///< Is emitted when the number of atoms has been changed
@@ -76,6 +86,7 @@ class GLMoleculeView : public GLSimpleMoleculeView
     void deleteSelectedAtomsCommand();  // creates a Command to delete all selected atoms
     void selectAllCommand();            // creates a Command to select all atoms.
     void unselectAllCommand();          // creates a Command to deselect all atoms.
+    void selectNeighboursCommand();     // creates a Command to select the atoms near the selected atoms.
     void centerViewCommand();           // creates a Command to center the view
     void resetOrientationCommand();     // creates a Command to reset the orientation of the view
     void zoomFitCommand();              // creates a Command to zoom the scene for a perfect fit
@@ -87,6 +98,7 @@ class GLMoleculeView : public GLSimpleMoleculeView
 
   protected:
     //virtual void initializeGL();        // initial OpenGL setup
+    void customEvent(QCustomEvent* e);  // reimplemented to receive events from the triangle reordering of densityGrid
     void mouseMoveEvent(QMouseEvent* e);// event which takes place when the mouse is moved while a mousebutton is pressed
     void keyPressEvent(QKeyEvent* e);   // event which takes places when a key is pressed
     virtual void updateShapes();        // updates the shapes vector
@@ -97,6 +109,7 @@ class GLMoleculeView : public GLSimpleMoleculeView
     void translateSelectionCommand(const int amountX, const int amountY, const int amountZ);        // creates a Command to translate the selected atoms
     void rotateSelectionCommand(const double amountX, const double amountY, const double amountZ);  // creates a Command to rotate the selected atoms
     void changeSelectedICCommand(const int range);// creates a Command to change the selected internal coordinate
+    void zoomChanged();                 // schedules updating the resolution of the isosurfaces
 
 private slots:
     void addGLSurface(const unsigned int index);  // adds a surface to the GL display list
@@ -105,6 +118,7 @@ private slots:
     void updateScene();                 // does the necessary updating when something changed in DensityBase
     void updateVolume();                // updates the textures used for volume rendering
     void updateSlice();                 // updates the current slice
+    void updateSurfaceResolution();     // sets the resolution of isosurfaces according to the on-screen size of the density grid
 
   private:
     friend class CommandCoordinates;
@@ -158,11 +172,15 @@ private slots:
     GLuint* textureID2D;                ///< Holds the list of texture names for the 2D textures
     GLuint textureID3D;                 ///< Holds the texture name of the 3D texture
     Point3D<unsigned int> volumeTextureSize; ///< Holds the size of the 3D volume texture
+    unsigned int volumeLevel;           ///< Holds the density grid resolution level stored in the 3D volume texture
     GLuint sliceObject;                 ///< Holds the OpenGL display list number for slices
+    QTimer* resolutionTimer;            ///< Delays updating the resolution of the isosurfaces until zooming stops
 
     ///// static private member data
     static bool manipulateSelection;    ///< If true, only the selected atoms are manipulated instead of the entire system.
     static GLTextureParameters textureParameters; ///< Holds the OpenGL texturing parameters
+    static GLSurfaceParameters surfaceParameters; ///< Holds the isosurface parameters
+    static const int resolutionWait;    ///< Number of msec without zooming after which the resolution of the isosurfaces is updated
 };
    
 #endif
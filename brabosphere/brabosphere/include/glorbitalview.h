@@ -28,10 +28,10 @@
 
 // Qt forward class declarations
 class QColor;
-#include <qmutex.h>
 
 // Xbrabo header files
 #include "point3d.h"
+#include "pointbuffer.h"
 
 // Base class header file
 #include <glview.h>
@@ -48,25 +48,32 @@ class GLOrbitalView : public GLView
 
     // public member functions
     void updateColors(QColor pos, QColor neg);
-    std::vector<Point3D<float> >* getCoordinates();         // returns a pointer to the coords vector
-    QMutex* getMutex();                   // returns a pointer to the mutex used for accessing the coords vector
+    PointBuffer* getPoints();           // returns a pointer to the buffer of points
+    void clearPoints();                 // removes all points
     void setMaximumRadius(const double radius);   // updates the maximum radius of the coordinates
+    void setSurfaces(const std::vector<double>* values, const Point3D<unsigned int>& points, const Point3D<float>& delta, const Point3D<float>& origin, const double level); // calculates the isosurfaces of both phases from a grid
+    void clearSurfaces();               // removes the isosurfaces
         
   protected:
     void drawScene();                   // does the local drawing of the scene
     float boundingSphereRadius();       // calculates the radius of the bounding sphere
     
   private:
+    // private member functions
+    void drawPoints(const unsigned int phase);    // draws the points of a phase
+
     // private enums
     //enum Precision{PRECISION_UNKNOWN, PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_LONG_DOUBLE};
     
     // private member variables
     QColor colorPositive;               ///< The color of positive values.
     QColor colorNegative;               ///< The color of negative values.
-    std::vector<Point3D<float> > coords;          ///< The coordinates including phases.
-    QMutex mutex;                       ///< The mutex for accessing the coords vector.
+    PointBuffer points;                 ///< The coordinates of the points of both phases.
+    std::vector<GLuint> vertexBuffers[PointBuffer::PHASE_LAST]; ///< The vertex buffer objects holding the chunks of each phase (if supported).
+    unsigned int numUploaded[PointBuffer::PHASE_LAST];  ///< The number of points of each phase copied to the vertex buffer objects.
     float maximumRadius;                ///< The overall maximum radius (used by boundingSphereRadius).
     float scaleFactor;                  ///< A scaling factor used when maximumRadius exceeds the far z-value (100.0f).
+    GLuint surfaceLists;                ///< The display lists of the positive and negative isosurface (0 if not present).
 };
 
 #endif
@@ -59,9 +59,14 @@ class NewAtomBase : public NewAtomWidget
     void checkAdd();                    // check whether an atom can be added with the current status of the widgets
 
   private:
+    ///// private member functions
+    void checkContacts(const unsigned int atom);  // warns when an atom overlaps with other atoms
 
     ///// private member data
     AtomSet* atoms;                     ///< A pointer to the active AtomSet
+
+    ///// static private member data
+    static const double minimumDistance;///< The distance in Angstrom below which atoms are considered to overlap.
 };
 
 #endif
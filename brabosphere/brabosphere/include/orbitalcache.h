@@ -0,0 +1,104 @@
+/***************************************************************************
+                        orbitalcache.h  -  description
+                             -------------------
+    begin                : Sun Oct 18 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/// \file
+/// Contains the declaration of the class OrbitalCache.
+
+#ifndef ORBITALCACHE_H
+#define ORBITALCACHE_H
+
+///// Forward class declarations & header files ///////////////////////////////
+
+// STL includes
+#include <list>
+#include <utility>
+#include <vector>
+
+// Qt header files
+#include <qstring.h>
+
+// Xbrabo includes
+#include "point3d.h"
+#include "pointbuffer.h"
+
+///// class OrbitalCache //////////////////////////////////////////////////////
+class OrbitalCache
+{
+  public:
+    ///// constructor/destructor
+    OrbitalCache();                     // constructor
+    ~OrbitalCache();                    // destructor
+
+    ///// public structs
+    struct Key
+    /// The parameters determining the result of a calculation.
+    {
+      unsigned int type;                ///< the type of calculation
+      unsigned int atom;                ///< the atomic number
+      unsigned int n;                   ///< the principal quantum number
+      unsigned int l;                   ///< the orbital quantum number
+      int m;                            ///< the angular momentum quantum number
+      float resolution;                 ///< the resolution
+      float probability;                ///< the iso or accumulated probability
+      unsigned int dots;                ///< the number of random dots
+      unsigned int seed;                ///< the seed of the random number generator
+    };
+
+    struct Entry
+    /// The result of a calculation.
+    {
+      std::vector<float> points[PointBuffer::PHASE_LAST]; ///< the packed coordinates of the points of each phase
+      std::vector<double> gridValues;   ///< the values of psi on the grid points (empty if not calculated)
+      Point3D<unsigned int> gridPoints; ///< the number of grid points in each direction
+      Point3D<float> gridDelta;         ///< the spacing of the grid points
+      Point3D<float> gridOrigin;        ///< the position of the first grid point
+      double gridLevel;                 ///< the value of psi at the positive isosurface
+      double radius;                    ///< the radius of the bounding sphere
+    };
+
+    ///// public member functions
+    const Entry* find(const Key& key);  // returns the stored result for a key
+    void insert(const Key& key, const Entry& entry); // stores a result
+    void setDirectory(const QString& dir);        // sets the directory of the disk store
+    void clear();                       // removes all results from memory
+
+  private:
+    ///// private typedefs
+    typedef std::pair<QString, Entry> Item;
+
+    ///// private member functions
+    OrbitalCache(const OrbitalCache&);  // not copyable
+    OrbitalCache& operator=(const OrbitalCache&); // not assignable
+    void evict();                       // removes the least recently used results exceeding the memory limit
+    bool load(const QString& description, Entry& entry);  // reads a result from the disk store
+    void save(const QString& description, const Entry& entry);  // writes a result to the disk store
+    QString fileName(const QString& description) const; // returns the file of the disk store for a description
+    static QString describe(const Key& key);  // returns a unique description of a key
+    static unsigned int memoryUsage(const Entry& entry);  // returns the amount of memory used by a result
+
+    ///// private member data
+    std::list<Item> items;              ///< The results in memory, most recently used first.
+    unsigned int usedMemory;            ///< The amount of memory used by the results in bytes.
+    QString directory;                  ///< The directory of the disk store (empty if disabled).
+
+    ///// private static constants
+    static const unsigned int maximumMemory;      ///< The maximum amount of memory used by the results in bytes.
+    static const Q_UINT32 magicNumber;  ///< Identifies the files of the disk store.
+    static const Q_UINT32 fileVersion;  ///< The version of the format of the files.
+};
+
+#endif
+
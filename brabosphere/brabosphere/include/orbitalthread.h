@@ -27,9 +27,14 @@
 #include <vector>
 
 // Qt forward class declarations
-class QMutex;
 class QWidget;
 
+// Xbrabo forward class declarations
+class PointBuffer;
+
+// Qt header files
+#include <qmutex.h>
+
 // Xbrabo header files
 #include "point3d.h"
 
@@ -41,38 +46,91 @@ class OrbitalThread : public QThread
 {
   public:
     ///// constructor/destructor
-    OrbitalThread(QWidget* parentWidget, QMutex* sharedMutex, std::vector<Point3D<float> >* coordinates, const unsigned int type, const unsigned int atom, const unsigned int n, const unsigned int l, const int m, const float res, const float prob, const unsigned int dots);        // constructor
+    OrbitalThread(QWidget* parentWidget, PointBuffer* pointBuffer, const unsigned int type, const unsigned int atom, const unsigned int n, const unsigned int l, const int m, const float res, const float prob, const unsigned int dots, const unsigned int threads = 1, const unsigned int seed = 0);        // constructor
     ~OrbitalThread();                   // destructor
 
     ///// public enums
-    enum Types{IsoProbability = 0, Density, AngularPart, AccumulatedProbability, RadialPart}; ///< Holds the types of calculations available
+    enum Types{IsoProbability = 0, Density, AngularPart, Surface, AccumulatedProbability, RadialPart}; ///< Holds the types of calculations available
 
     ///// public member functions
     void stop();                        // requests stopping the thread
     double boundingSphereRadius();      // returns the radius of the bounding sphere
+    unsigned int seed() const;          // returns the seed of the random number generator used by the last run
+    bool completed() const;             // returns whether the last run calculated the complete orbital
+    const std::vector<double>* surfaceValues() const; // returns the values of psi on the grid of the Surface type
+    Point3D<unsigned int> surfacePoints() const;  // returns the number of grid points in each direction
+    Point3D<float> surfaceDelta() const;  // returns the spacing of the grid points
+    Point3D<float> surfaceOrigin() const; // returns the position of the first grid point
+    double surfaceLevel() const;        // returns the value of psi at the positive isosurface
+
+    ///// static public member functions
+    static unsigned int surfaceSize(const float res); // returns the number of grid points in each direction for a resolution
+    static bool usesRandomNumbers(const unsigned int type); // returns whether the result of a type depends on the seed
 
   private:
     // private enums
     enum Precision{PRECISION_UNKNOWN, PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_LONG_DOUBLE}; ///< The needed precision for a certain set of quantum numbers
 
+    // private structs
+    struct WorkerState
+    /// The data private to each worker thread.
+    {
+      unsigned int index;               ///< the number of the worker
+      Q_UINT64 randomState;             ///< the state of the random number generator of the worker
+      float maximumRadius;              ///< the maximum encountered value of r of the worker
+    };
+
+    struct RadialLobe
+    /// A part of the radial table between two nodes.
+    {
+      unsigned int first;               ///< the index of the last point before the first node (or 0)
+      unsigned int peak;                ///< the index of the point with the largest absolute value
+      unsigned int last;                ///< the index of the first point after the second node (or the last point)
+      bool positive;                    ///< whether the radial part is positive in the lobe
+    };
+
+    // private classes
+    class Worker;
+    friend class Worker;
+
     ///// private member functions
     virtual void run();                 // reimplementation of this pure virtual does the actual work
-    void calcIsoProbability();          // calculates an isoprobability
-    void calcAccumulatedProbability();  // calculates points with the given total accumulated probability
-    void calcRandomDots();              // calculates random points according to the probability
-    void calcRadialPart();              // calculates only the radial part of the orbital
-    void calcAngularPart();             // calculates only the angular part of the orbital
-    void updateList(std::vector<Point3D<float> >& newCoords, bool final = false);         // updates the shared list of coordinates with a new set
-    float associatedLegendre(const float x, const int m, const unsigned int l); // returns the associated Legendre polynomial
-    float associatedLaguerre(const float x, const int m, const unsigned int n); // returns the associated Laguerre polynomial
+    void calculate(WorkerState& state); // does the part of the calculation assigned to a worker
+    template <class T> void calculate(WorkerState& state);  // does the part of the calculation assigned to a worker with precision T
+    template <class T> void calcIsoProbability(WorkerState& state);  // calculates an isoprobability
+    template <class T> void calcAccumulatedProbability(WorkerState& state);  // calculates points with the given total accumulated probability
+    template <class T> void calcRandomDots(WorkerState& state);      // calculates random points according to the probability
+    template <class T> void calcRandomDot(WorkerState& state, std::vector<Point3D<float> >& coordsList); // calculates a single random point
+    template <class T> void calcRadialPart(WorkerState& state);      // calculates only the radial part of the orbital
+    template <class T> void calcAngularPart(WorkerState& state);     // calculates only the angular part of the orbital
+    template <class T> void calcSurface(WorkerState& state);         // calculates psi on the grid points
+    bool nextRow(unsigned int& row);    // returns the next row of the theta/phi domain to be calculated
+    void addProgress(const unsigned int amount);  // increases the progress and notifies the receiver when needed
+    void tabulateRadialPart();          // tabulates the radial part and its cumulative probability
+    void tabulateAngularPart();         // tabulates the factors of the angular part and their cumulative distributions
+    void prepareSurface();              // determines the grid for the Surface type
+    void tabulateCumulative(const std::vector<double>& values, const double step, const bool sinTheta, std::vector<double>& cumulative); // tabulates the cumulative distribution of an angular factor
+    double inverseCumulative(const std::vector<double>& cumulative, const double step, const double value);  // returns the position for a value of a cumulative distribution
+    double interpolate(const std::vector<double>& values, const double step, const double x);  // interpolates a table
+    template <class T> T radialPart(const T r); // returns the interpolated radial part
+    template <class T> T radialFunction(const T r); // calculates the radial part
+    float cumulativeRadius(const double cumulative);  // returns the radius for a cumulative radial probability
+    template <class T> void findRadii(const T value, std::vector<float>& radii, std::vector<bool>& positive); // finds the radii where the radial part has a given absolute value
+    float splineRoot(const unsigned int interval, const double value); // returns the radius where the spline has a given value
+    void updateList(std::vector<Point3D<float> >& newCoords, bool final = false);         // publishes a set of new points to the shared buffer
+    template <class T> T associatedLegendre(const T x, const int m, const unsigned int l); // returns the associated Legendre polynomial
+    template <class T> T associatedLaguerre(const T x, const int m, const unsigned int n); // returns the associated Laguerre polynomial
     template <class T> T factorial(const unsigned int number);        // returns the factorial (n!) of the number (n)
-    float random(const float min, const float max);         // returns a random number between min and max
+    float random(Q_UINT64& state, const float min, const float max); // returns a random number between min and max
+    Q_UINT64 randomStream(const unsigned int task) const; // returns the initial state of the random number generator for a task
     template <class T> T largestResult(const unsigned int n, const unsigned int l, const int m, const unsigned int Z);  // calculates the largest possible result for the given quantum numbers
+    template <class T> bool isSufficient(const long double condition);  // returns whether the precision of T suffices for the calculation
+    template <class T> bool isFinite(const T value);  // returns whether the value is finite
+    long double conditionNumber();      // estimates the loss of accuracy in the polynomials
 
     ///// private member data
     QWidget* receiver;                  ///< The widget that receives any sent events.
-    QMutex* mutex;                      ///< A mutex to lock the access to the vector of calculated points.
-    std::vector<Point3D<float> >* coords;         ///< Coordinates of calculated probability points.
+    PointBuffer* points;                ///< Receives the coordinates of calculated probability points.
     unsigned int atomNumber;            ///< The atom type for which the orbital is to be shown.
     unsigned int qnPrincipal;           ///< Principal quantum number (n) (1 - x).
     unsigned int qnOrbital;             ///< Orbital quantum number (l) (0 - n-1).
@@ -81,13 +139,46 @@ class OrbitalThread : public QThread
     float probability;                  ///< The iso or accumulated probability.
     float resolution;                   ///< The desired resolution.
     unsigned int numDots;               ///< The number of dots to calculate for random dots.
+    unsigned int numThreads;            ///< The number of worker threads.
+    unsigned int randomSeed;            ///< The seed of the random number generator (0 for a new seed on every run).
+    unsigned int usedSeed;              ///< The seed of the random number generator used by the last run.
     bool stopRequested;                 ///< Is set to true if the thread should be stopped.
+    unsigned int neededPrecision;       ///< The precision used for the calculation.
     float maximumRadius;                ///< Holds the maximum encountered value of r during the calculation.
     unsigned int progress;              ///< Holds the progress of the calculation.
+    unsigned int progressStep;          ///< The increase in progress after which the receiver is notified.
+    QMutex workMutex;                   ///< Locks the distribution of the work and the progress among the workers.
+    unsigned int nextTask;              ///< The next row of the theta/phi domain to be calculated.
+    unsigned int numTasks;              ///< The number of rows of the theta/phi domain.
+    double radialStep;                  ///< The step in r between the points of the radial table.
+    std::vector<double> radialValues;   ///< The tabulated radial part.
+    std::vector<double> radialCurvatures; ///< The second derivatives of the spline through the radial part times radialStep^2/6.
+    std::vector<double> radialCumulative; ///< The tabulated cumulative radial probability.
+    std::vector<RadialLobe> radialLobes; ///< The lobes of the tabulated radial part.
+    double thetaStep;                   ///< The step in theta between the points of the angular tables.
+    std::vector<double> thetaValues;    ///< The tabulated theta dependent factor of the angular part.
+    std::vector<double> thetaCumulative; ///< The tabulated cumulative distribution of theta.
+    double phiStep;                     ///< The step in phi between the points of the angular tables.
+    std::vector<double> phiValues;      ///< The tabulated phi dependent factor of the angular part (not normalized).
+    std::vector<double> phiCumulative;  ///< The tabulated cumulative distribution of phi.
+    std::vector<double> gridValues;     ///< The values of psi on the grid points for the Surface type.
+    Point3D<unsigned int> gridPoints;   ///< The number of grid points in each direction.
+    Point3D<float> gridDelta;           ///< The spacing of the grid points.
+    Point3D<float> gridOrigin;          ///< The position of the first grid point.
 
     // private static constants
     static const float abohr;           ///< The Bohr radius.
-    static const unsigned int updateSize;         // The amount of dots that have to be calculated before the list of dots is updated and the mutex is locked
+    static const unsigned int updateSize;         // The amount of dots that have to be calculated before they are published to the buffer
+    static const long double maximumError;        ///< The maximum relative error allowed by the chosen precision.
+    static const double tableStep;      ///< The maximum step in rho between the points of the radial table.
+    static const unsigned int minimumIntervals;   ///< The minimum number of intervals of the radial table.
+    static const unsigned int maximumIntervals;   ///< The maximum number of intervals of the radial table.
+    static const double radialTolerance;          ///< The relative accuracy of the radii found by findRadii.
+    static const unsigned int maximumIterations;  ///< The maximum number of iterations for refining a radius.
+    static const double maximumExtent;            ///< The largest radius searched by findRadii in units of the table range.
+    static const unsigned int angularIntervals;   ///< The number of intervals of the angular tables.
+    static const unsigned int densityChunk;       ///< The number of random dots calculated by a worker at a time.
+    static const unsigned int maximumGridPoints;  ///< The maximum number of grid points in each direction for the Surface type.
 };
 
 #endif
@@ -33,6 +33,9 @@ class GLOrbitalView;
 class OrbitalOptionsWidget;
 class OrbitalThread;
 
+///// Xbrabo header files
+#include "orbitalcache.h"
+
 ///// Base class header file
 #include <qdialog.h>
 
@@ -60,6 +63,8 @@ class OrbitalViewerBase : public QDialog
   private:
     // private member functions
     void finishCalculation();           // finished up a calculation
+    bool restoreResult();               // shows a stored result for the options
+    void storeResult();                 // stores the result of the finished calculation
 
     // private member variables
     QHBoxLayout* BigLayout;             ///< All encompassing horizontal layout.
@@ -69,6 +74,10 @@ class OrbitalViewerBase : public QDialog
     ColorButton* ColorButtonNegative;   ///< The pushbutton for choosing the colour of the negative values.
     OrbitalThread* calcThread;          ///< The thread doing the calculation.
     QTimer* timer;                      ///< Handles periodic updating of the view during a calculation.
+    OrbitalCache::Key calcKey;          ///< The parameters of the last calculation.
+
+    // private static member variables
+    static OrbitalCache cache;          ///< Holds the results of previous calculations of all viewers.
 };
 
 #endif
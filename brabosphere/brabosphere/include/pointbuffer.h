@@ -0,0 +1,74 @@
+/***************************************************************************
+                        pointbuffer.h  -  description
+                             -------------------
+    begin                : Sun Oct 18 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/// \file
+/// Contains the declaration of the class PointBuffer.
+
+#ifndef POINTBUFFER_H
+#define POINTBUFFER_H
+
+///// Forward class declarations & header files ///////////////////////////////
+
+// STL includes
+#include <vector>
+
+// Qt header files
+#include <qmutex.h>
+
+// Xbrabo includes
+#include "point3d.h"
+
+///// class PointBuffer ///////////////////////////////////////////////////////
+class PointBuffer
+{
+  public:
+    ///// constructor/destructor
+    PointBuffer();                      // constructor
+    ~PointBuffer();                     // destructor
+
+    ///// public enums
+    enum Phase{PHASE_NEGATIVE = 0, PHASE_POSITIVE, PHASE_LAST}; ///< The phases of the points, corresponding to their IDs
+
+    ///// public member functions for the producers
+    void append(const std::vector<Point3D<float> >& points); // appends points and publishes them
+    void append(const unsigned int phase, const std::vector<float>& coordinates); // appends packed points of a phase and publishes them
+
+    ///// public member functions for the consumer
+    unsigned int size(const unsigned int phase) const;  // returns the number of published points of a phase
+    const float* chunk(const unsigned int phase, const unsigned int index) const; // returns the coordinates of the points of a chunk
+    void clear();                       // removes all points
+
+    ///// public constants (made static for ease)
+    static const unsigned int chunkSize;          ///< The number of points in a chunk.
+
+  private:
+    ///// private member functions
+    PointBuffer(const PointBuffer&);    // not copyable
+    PointBuffer& operator=(const PointBuffer&);   // not assignable
+    static unsigned int fetchAndAdd(volatile unsigned int& value, const unsigned int amount); // atomically adds to a value
+
+    ///// private member data
+    std::vector<float*> chunks[PHASE_LAST];       ///< The chunks of each phase. Their number is fixed so the vectors never reallocate.
+    volatile unsigned int published[PHASE_LAST];  ///< The number of points of each phase visible to the consumer.
+    unsigned int appended[PHASE_LAST];  ///< The number of points of each phase written by the producers.
+    QMutex appendMutex;                 ///< Serializes the producers. Never locked by the consumer.
+
+    ///// private static constants
+    static const unsigned int maximumChunks;      ///< The maximum number of chunks.
+};
+
+#endif
+
@@ -59,6 +59,7 @@ class PreferencesBase : public PreferencesWidget
     GLView::GLBaseParameters getGLBaseParameters() const;   // returns a struct with the OpenGL base parameters
     GLSimpleMoleculeView::GLMoleculeParameters getGLMoleculeParameters() const; // returns a struct with the OpenGL molecule parameters
     GLMoleculeView::GLTextureParameters getGLTextureParameters() const;         // returns a struct with the OpenGL texture parameters
+    GLMoleculeView::GLSurfaceParameters getGLSurfaceParameters() const;         // returns a struct with the isosurface parameters
     QStringList getPVMHosts() const;              // returns a list of PVM hosts
     void setToolbarsInfo(const QString& info, const bool status);     // sets the info needed to restore the toolbars
     void getToolbarsInfo(bool& status, QString& info) const;// returns the toolbars info
@@ -175,6 +176,7 @@ class PreferencesBase : public PreferencesWidget
       unsigned int sliceQuality;        ///< SliderSlices
       bool perspectiveProjection;       ///< ButtonGroupProjection
       bool use3DTextures;               ///< CheckBoxVolumeHQ
+      unsigned int surfaceEngine;       ///< ComboBoxSurfaceEngine
 
       ///// PVM
       QStringList pvmHosts;             ///< ListViewPVMHosts      
@@ -0,0 +1,47 @@
+/***************************************************************************
+                       triangleorder.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/// \file
+/// Contains the declaration of the class TriangleOrder.
+
+#ifndef TRIANGLEORDER_H
+#define TRIANGLEORDER_H
+
+///// Forward class declarations & header files ///////////////////////////////
+
+// STL includes
+#include <vector>
+
+///// class TriangleOrder /////////////////////////////////////////////////////
+class TriangleOrder
+{
+  public:
+    ///// static public member functions
+    static void optimize(const std::vector<unsigned int>& input, const unsigned int numVertices, std::vector<unsigned int>& output); // reorders a list of triangles for vertex cache locality
+    static float missRatio(const std::vector<unsigned int>& indices, const unsigned int vertices);  // returns the average cache miss ratio of a list of triangles
+
+  private:
+    ///// private member functions
+    TriangleOrder();                    // constructor
+    static float vertexScore(const int cachePosition, const unsigned int numTriangles); // returns the score of a vertex
+
+    ///// private static constants
+    static const int cacheSize;         ///< The size of the modelled vertex cache.
+    static const unsigned int simulatedCacheSize; ///< The size of the FIFO cache for determining miss ratios.
+};
+
+#endif
+
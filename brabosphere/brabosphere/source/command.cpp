@@ -38,6 +38,7 @@
                          CommandSelection (abstract)
                            CommandSelectAll
                            CommandSelectNone
+                           CommandSelectNeighbours
                            CommandSelectEntity
                          CommandDisplayMode
                          CommandTranslate (abstract)
@@ -882,6 +883,34 @@ bool CommandSelectNone::initialRun()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+///// Class CommandSelectNeighbours                                       /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// constructor /////////////////////////////////////////////////////////////
+CommandSelectNeighbours::CommandSelectNeighbours(XbraboView* parent, const QString description, const double radius) : CommandSelection(parent, description),
+  selectionRadius(radius)
+/// The default constructor.
+{
+
+}
+
+///// copy constructor ////////////////////////////////////////////////////////
+CommandSelectNeighbours* CommandSelectNeighbours::clone() const
+/// The copy constructor using the 'virtual constructor idiom'
+{
+  return new CommandSelectNeighbours(*this);
+}
+
+///// initalRun /////////////////////////////////////////////////////////////////
+bool CommandSelectNeighbours::initialRun()
+/// Adds the atoms within the given distance of the selected atoms to the selection.
+{
+  view->moleculeView()->selectNeighbours(selectionRadius);
+  return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Class CommandSelectEntity                                           /////
 ///////////////////////////////////////////////////////////////////////////////
@@ -60,6 +60,7 @@
 #include <qwidgetstack.h>
 
 // Xbrabo header files
+#include "atomset.h"
 #include "colorbutton.h"
 #include "densitybase.h"
 #include "densitygrid.h"
@@ -72,12 +73,15 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 ///// Constructor /////////////////////////////////////////////////////////////
-DensityBase::DensityBase(DensityGrid* grid, QWidget* parent, const char* name, bool modal, WFlags fl) : DensityWidget(parent, name, modal, fl),
+DensityBase::DensityBase(DensityGrid* grid, AtomSet* atomSet, const std::list<unsigned int>* selection, QWidget* parent, const char* name, bool modal, WFlags fl) : DensityWidget(parent, name, modal, fl),
   densityGrid(grid),
+  atoms(atomSet),
+  selectedAtoms(selection),
   loadingThread(0),
   columnColourWidth(-1),
   oldVisualizationType(-1)
-/// The defaults constructor.
+/// The defaults constructor. If atomSet and selection are given, the 
+/// calculation of isosurfaces can be limited to the selected atoms.
 {
   assert(densityGrid != NULL);
   // validators
@@ -87,6 +91,7 @@ DensityBase::DensityBase(DensityGrid* grid, QWidget* parent, const char* name, b
   LineEditVolumeNeg->setValidator(v);
   LineEditSlicePos->setValidator(v);
   LineEditSliceNeg->setValidator(v);
+  LineEditMargin->setValidator(new QDoubleValidator(0.0, 100.0, 2, this));
   v = 0;
   // Isosurfaces
   ListViewParameters->setSorting(-1);
@@ -94,6 +99,14 @@ DensityBase::DensityBase(DensityGrid* grid, QWidget* parent, const char* name, b
   ListViewParameters->setColumnWidth(COLUMN_ID,0);
   ListViewParameters->setColumnWidthMode(COLUMN_RGB,QListView::Manual);
   ListViewParameters->setColumnWidth(COLUMN_RGB,0);
+  if(atoms == 0 || selectedAtoms == 0)
+  {
+    CheckBoxRegion->hide();
+    ComboBoxRegion->hide();
+    TextLabelMargin->hide();
+    LineEditMargin->hide();
+  }
+  CheckBoxOrder->setChecked(densityGrid->optimizeTriangleOrder());
   ProgressBarA->hide();
   ProgressBarB->hide();
   // Volume
@@ -351,6 +364,37 @@ void DensityBase::updateAll()
   //qDebug("at the end of updateAll, oldVisualizationType = %d", oldVisualizationType);
 }
 
+///// updateMissRatio /////////////////////////////////////////////////////////
+void DensityBase::updateMissRatio()
+/// Shows the average number of vertex cache misses per triangle of the
+/// currently selected surface before and after reordering its triangles.
+/// Should be called when the triangles of a surface have been reordered.
+{
+  LabelMissRatio->clear();
+  QListViewItem* item = ListViewParameters->selectedItem();
+  if(item == 0)
+    return;
+
+  ///// find the surface in densityGrid. Deleted surfaces are still present until the next update
+  const unsigned int itemID = item->text(COLUMN_ID).toUInt();
+  unsigned int surface = 0;
+  std::vector<SurfaceProperties>::iterator it = surfaceProperties.begin();
+  while(it != surfaceProperties.end() && (*it).ID != itemID)
+  {
+    if(!(*it).isNew)
+      surface++;
+    it++;
+  }
+  if(it == surfaceProperties.end() || (*it).isNew || surface >= densityGrid->numSurfaces())
+    return;
+
+  float original, ordered;
+  if(densityGrid->missRatios(surface, original, ordered))
+    LabelMissRatio->setText(tr("Cache misses per triangle: %1 instead of %2").arg(ordered < original ? ordered : original, 0, 'f', 2).arg(original, 0, 'f', 2));
+  else if(densityGrid->optimizeTriangleOrder())
+    LabelMissRatio->setText(tr("Reordering..."));
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// Protected Member Functions                                          /////
@@ -476,6 +520,7 @@ void DensityBase::updateSettings()
   ComboBoxType->blockSignals(true);
   ComboBoxType->setCurrentText(item->text(COLUMN_TYPE));
   ComboBoxType->blockSignals(false);
+  updateMissRatio();
 }
 
 ///// updateVisibility ////////////////////////////////////////////////////////
@@ -909,6 +954,23 @@ void DensityBase::checkUpdate()
     updateAll();
 }
 
+///// updateRegionWidgets /////////////////////////////////////////////////////
+void DensityBase::updateRegionWidgets()
+/// Only enables the widgets defining the region of interest when it is used.
+{
+  ComboBoxRegion->setEnabled(CheckBoxRegion->isChecked());
+  LineEditMargin->setEnabled(CheckBoxRegion->isChecked());
+}
+
+///// updateTriangleOrder /////////////////////////////////////////////////////
+void DensityBase::updateTriangleOrder()
+/// Switches the reordering of the triangles of surfaces on or off. Existing
+/// surfaces are reordered when it is switched on.
+{
+  densityGrid->setOptimizeTriangleOrder(CheckBoxOrder->isChecked());
+  updateMissRatio();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Private Member Functions                                            /////
 ///////////////////////////////////////////////////////////////////////////////
@@ -942,6 +1004,16 @@ void DensityBase::makeConnections()
   connect(ListViewParameters, SIGNAL(clicked(QListViewItem*)), this, SLOT(updateSettings()));
   connect(ListViewParameters, SIGNAL(clicked(QListViewItem*, const QPoint&, int)), this, SLOT(updateVisibility(QListViewItem*, const QPoint&, int)));
 
+  ///// connections for the region of interest
+  connect(CheckBoxRegion, SIGNAL(toggled(bool)), this, SLOT(updateRegionWidgets()));
+  connect(CheckBoxRegion, SIGNAL(toggled(bool)), this, SLOT(checkUpdate()));
+  connect(ComboBoxRegion, SIGNAL(activated(int)), this, SLOT(checkUpdate()));
+  connect(LineEditMargin, SIGNAL(returnPressed()), this, SLOT(checkUpdate()));
+  connect(LineEditMargin, SIGNAL(lostFocus()), this, SLOT(checkUpdate()));
+
+  ///// connections for the triangle order
+  connect(CheckBoxOrder, SIGNAL(toggled(bool)), this, SLOT(updateTriangleOrder()));
+
   ///// connections for ComboBoxOperation
   connect(ComboBoxOperation, SIGNAL(activated(int)), this, SLOT(updateOperation()));
 
@@ -1407,6 +1479,11 @@ bool DensityBase::updateIsoSurfaces()
 {
   bool somethingChanged = false;
 
+  ///// check whether the region of interest has changed
+  const DensityGrid::Region region = selectionRegion();
+  const bool regionChanged = !(region == surfaceRegion);
+  surfaceRegion = region;
+
   ///// first traverse the surfaces backwards to remove deleted ones
   std::vector<SurfaceProperties>::reverse_iterator rit = surfaceProperties.rbegin();
   unsigned int surfaceIndex = surfaceProperties.size() - 1;
@@ -1446,7 +1523,7 @@ bool DensityBase::updateIsoSurfaces()
       surfaceProperties[i].type = typeToNum(it.current()->text(COLUMN_TYPE));
       surfaceProperties[i].isNew = false;
 
-      densityGrid->addSurface(surfaceProperties[i].level);
+      densityGrid->addSurface(surfaceProperties[i].level, region);
       emit newSurface(densityGrid->numSurfaces() - 1);
       somethingChanged = true;
     }
@@ -1475,9 +1552,9 @@ bool DensityBase::updateIsoSurfaces()
       surfaceProperties[i].opacity = it.current()->text(COLUMN_OPACITY).toUInt();
       surfaceProperties[i].type = typeToNum(it.current()->text(COLUMN_TYPE));
 
-      if(levelChanged)
-        densityGrid->changeSurface(i, surfaceProperties[i].level);
-      if(levelChanged || colorChanged || opacityChanged || typeChanged || mappingChanged)
+      if(levelChanged || regionChanged)
+        densityGrid->changeSurface(i, surfaceProperties[i].level, region);
+      if(levelChanged || regionChanged || colorChanged || opacityChanged || typeChanged || mappingChanged)
       {
         emit updatedSurface(i);
         somethingChanged = true;
@@ -1487,6 +1564,7 @@ bool DensityBase::updateIsoSurfaces()
     }
   }
   mappingChanged = false;
+  updateMissRatio();
   return somethingChanged;
 }
 
@@ -1546,6 +1624,55 @@ bool DensityBase::updateSlice()
   return changed;
 }
 
+///// selectionRegion /////////////////////////////////////////////////////////
+DensityGrid::Region DensityBase::selectionRegion() const
+/// Returns the region of interest for calculating the isosurfaces. This is
+/// either the bounding box of the selected atoms or the sphere around their 
+/// center, extended by the margin. If the region is not used or no atoms are
+/// selected, an empty region is returned (meaning the entire grid).
+{
+  DensityGrid::Region region;
+  if(!CheckBoxRegion->isChecked() || atoms == 0 || selectedAtoms == 0 || selectedAtoms->empty())
+    return region;
+
+  ///// the bounding box of the selected atoms
+  const float margin = LineEditMargin->text().toFloat();
+  std::list<unsigned int>::const_iterator it = selectedAtoms->begin();
+  double minX = atoms->x(*it), minY = atoms->y(*it), minZ = atoms->z(*it);
+  double maxX = minX, maxY = minY, maxZ = minZ;
+  for(it++; it != selectedAtoms->end(); it++)
+  {
+    minX = std::min(minX, atoms->x(*it));
+    minY = std::min(minY, atoms->y(*it));
+    minZ = std::min(minZ, atoms->z(*it));
+    maxX = std::max(maxX, atoms->x(*it));
+    maxY = std::max(maxY, atoms->y(*it));
+    maxZ = std::max(maxZ, atoms->z(*it));
+  }
+
+  if(ComboBoxRegion->currentItem() == 0)
+  {
+    region.type = DensityGrid::REGION_BOX;
+    region.minimum.setValues(minX - margin, minY - margin, minZ - margin);
+    region.maximum.setValues(maxX + margin, maxY + margin, maxZ + margin);
+  }
+  else
+  {
+    region.type = DensityGrid::REGION_SPHERE;
+    region.center.setValues((minX + maxX)/2.0, (minY + maxY)/2.0, (minZ + maxZ)/2.0);
+    double radius2 = 0.0;
+    for(it = selectedAtoms->begin(); it != selectedAtoms->end(); it++)
+    {
+      const double dx = atoms->x(*it) - region.center.x();
+      const double dy = atoms->y(*it) - region.center.y();
+      const double dz = atoms->z(*it) - region.center.z();
+      radius2 = std::max(radius2, dx*dx + dy*dy + dz*dz);
+    }
+    region.radius = sqrt(radius2) + margin;
+  }
+  return region;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// Static Variables                                                    /////
@@ -29,6 +29,31 @@
   points and an unlimited number of isosurfaces generated from them. Individual 
   surfaces can be added, changed and removed. In version 1.0.x this class was 
   called IsoSurface.
+  As an alternative to the classic per-cell algorithm, surfaces can be generated
+  with a 'Flying Edges' style algorithm (Schroeder et al., 2015). It visits each
+  edge only once in a number of independent passes over the rows of grid points
+  along z (the contiguous direction): edge classification, counting, allocation 
+  by prefix sum and generation. Each row writes to its own part of the output,
+  so no searching or locking is needed. For large grids the slices of each
+  pass are divided over a number of threads. Both engines produce identical 
+  vertices and the same set of triangles. Flying edges is used by default.
+  The calculation of a surface can be limited to a box or a sphere (e.g. around
+  the selected atoms). Only the part of the grid covering the region is then
+  processed. For spheres, the triangles outside the sphere are removed 
+  afterwards.
+  The classification of the grid points against the isodensity is done for 
+  complete rows at once using SSE2 or AVX when available. The AVX version is
+  only used when the processor supports it, which is determined at runtime.
+  After loading a density, a pyramid of downsampled grids is calculated in a
+  background thread (see DensityPyramidThread). Each level halves the
+  resolution of the previous one. Slices can be taken from any level and 
+  surfaces are calculated from the finest level not exceeding a given number
+  of points (e.g. the size of the grid on screen). Until the pyramid is ready,
+  only the full resolution level is available.
+  The triangles of a new or changed surface are by default reordered for
+  vertex cache locality (see TriangleOrder). If a receiver is set, this is done
+  on a copy of the triangles in a background thread and the receiver is 
+  notified with an event of type 1003 when the new order can be used.
 */
 /// \file
 /// Contains the implementation of the class DensityGrid
@@ -37,25 +62,288 @@
 // C++ header files
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 
+// SIMD header files
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DENSITYGRID_SSE2
+  #include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+  #define DENSITYGRID_AVX
+  #define DENSITYGRID_TARGET_AVX __attribute__((target("avx")))
+  #include <immintrin.h>
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER) && _MSC_VER >= 1700
+  #define DENSITYGRID_AVX
+  #define DENSITYGRID_TARGET_AVX
+  #include <immintrin.h>
+  #include <intrin.h>
+#endif
+
 // STL header files
 #include <algorithm>
 
 // Qt header files
+#include <qapplication.h>
 #include <qcolor.h>
 #include <qimage.h>
+#include <qmutex.h>
+#include <qthread.h>
 
 // Xbrabo header files
 #include "densitygrid.h"
+#include "densitypyramidthread.h"
+#include "triangleorder.h"
+#include "systeminfo.h"
 #include "vector3d.h"
 
+///////////////////////////////////////////////////////////////////////////////
+///// class DensityGrid::SliceWorker                                      /////
+///////////////////////////////////////////////////////////////////////////////
+
+class DensityGrid::SliceWorker : public QThread
+/// A worker thread running a pass of the flying edges engine over slices of
+/// constant x for a DensityGrid.
+{
+  public:
+    SliceWorker(DensityGrid* master, const unsigned int type, vector<Point3D<float> >* vertices, 
+                vector<unsigned int>* indices, QMutex* mutex, unsigned int* next) : QThread(),
+      owner(master),
+      pass(type),
+      verticesList(vertices),
+      triangleIndices(indices),
+      sliceMutex(mutex),
+      nextSlice(next)
+    /// The default constructor.
+    {
+
+    }
+
+  private:
+    virtual void run()
+    /// Processes the next unhandled slice until all slices are done.
+    {
+      while(true)
+      {
+        unsigned int x;
+        {
+          QMutexLocker locker(sliceMutex);
+          x = (*nextSlice)++;
+        }
+        if(x >= owner->numPoints.x())
+          return;
+        owner->processSlice(pass, x, verticesList, triangleIndices);
+      }
+    }
+
+    DensityGrid* owner;                 ///< The DensityGrid whose surface is calculated.
+    const unsigned int pass;            ///< The pass to run (corresponds to the enum FlyingEdgesPass).
+    vector<Point3D<float> >* verticesList; ///< The vertices of the surface.
+    vector<unsigned int>* triangleIndices; ///< The triangles of the surface.
+    QMutex* sliceMutex;                 ///< Locks the distribution of the slices.
+    unsigned int* nextSlice;            ///< The next slice to be handled.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///// class DensityGrid::OrderWorker                                      /////
+///////////////////////////////////////////////////////////////////////////////
+
+class DensityGrid::OrderWorker : public QThread
+/// A worker thread reordering a copy of the triangles of a surface for vertex
+/// cache locality. If a receiver is given, an event of type 1003 is posted to
+/// it when the worker is done.
+{
+  public:
+    OrderWorker(const vector<unsigned int>& indices, const unsigned int vertices, const unsigned int serial,
+                QObject* receiver) : QThread(),
+      triangleIndices(indices),
+      numVertices(vertices),
+      surfaceSerial(serial),
+      eventReceiver(receiver),
+      originalRatio(-1.0f),
+      orderedRatio(-1.0f),
+      done(false)
+    /// The default constructor.
+    {
+
+    }
+
+    void reorder()
+    /// Reorders the triangles. The new order is only kept if it causes fewer
+    /// cache misses than the original one.
+    {
+      vector<unsigned int> orderedIndices;
+      TriangleOrder::optimize(triangleIndices, numVertices, orderedIndices);
+      originalRatio = TriangleOrder::missRatio(triangleIndices, numVertices);
+      orderedRatio = TriangleOrder::missRatio(orderedIndices, numVertices);
+      if(orderedRatio < originalRatio)
+        triangleIndices.swap(orderedIndices);
+    }
+
+    unsigned int serial() const
+    /// Returns the serial of the surface version being reordered.
+    {
+      return surfaceSerial;
+    }
+
+    bool ready()
+    /// Returns whether the reordering is done. The receiver can already be
+    /// notified before the thread has finished.
+    {
+      QMutexLocker locker(&doneMutex);
+      return done;
+    }
+
+    void result(vector<unsigned int>& indices, float& original, float& ordered)
+    /// Returns the reordered triangles and the cache miss ratios of the 
+    /// original and the new order. The triangles are moved into indices.
+    {
+      indices.swap(triangleIndices);
+      original = originalRatio;
+      ordered = orderedRatio;
+    }
+
+  private:
+    virtual void run()
+    /// Reorders the triangles and notifies the receiver.
+    {
+      reorder();
+      {
+        QMutexLocker locker(&doneMutex);
+        done = true;
+      }
+      if(eventReceiver != 0)
+        QApplication::postEvent(eventReceiver, new QCustomEvent(static_cast<QEvent::Type>(1003)));
+    }
+
+    vector<unsigned int> triangleIndices; ///< The triangles being reordered.
+    const unsigned int numVertices;     ///< The number of vertices of the surface.
+    const unsigned int surfaceSerial;   ///< The serial of the surface version being reordered.
+    QObject* eventReceiver;             ///< The object to notify when done.
+    float originalRatio;                ///< The cache miss ratio of the original order.
+    float orderedRatio;                 ///< The cache miss ratio of the new order.
+    bool done;                          ///< Is set to true when the reordering is done.
+    QMutex doneMutex;                   ///< Locks access to done.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///// Static Functions                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+/// The type of the functions classifying a row of density values.
+typedef unsigned int (*RowClassifier)(const double* values, const unsigned int count, const double isoLevel, const unsigned char bit, unsigned char* states);
+
+///// classifyRowScalar ///////////////////////////////////////////////////////
+static unsigned int classifyRowScalar(const double* values, const unsigned int count, const double isoLevel, const unsigned char bit, unsigned char* states)
+/// Adds the given bit to the states of all values which are below the isolevel.
+/// Returns 1 if any value is below the isolevel and adds 2 if any value is not.
+{
+  unsigned int result = 0;
+  for(unsigned int i = 0; i < count; i++)
+  {
+    if(values[i] < isoLevel)
+    {
+      states[i] |= bit;
+      result |= 1;
+    }
+    else
+      result |= 2;
+  }
+  return result;
+}
+
+#ifdef DENSITYGRID_SSE2
+///// classifyRowSSE2 /////////////////////////////////////////////////////////
+static unsigned int classifyRowSSE2(const double* values, const unsigned int count, const double isoLevel, const unsigned char bit, unsigned char* states)
+/// SSE2 version of classifyRowScalar handling 4 values per iteration.
+{
+  const __m128d iso = _mm_set1_pd(isoLevel);
+  unsigned int anyBelow = 0, allBelow = 15;
+  unsigned int i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    const unsigned int mask = _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(values + i), iso))
+                            | _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(values + i + 2), iso)) << 2;
+    anyBelow |= mask;
+    allBelow &= mask;
+    states[i]     |= (mask & 1) * bit;
+    states[i + 1] |= ((mask >> 1) & 1) * bit;
+    states[i + 2] |= ((mask >> 2) & 1) * bit;
+    states[i + 3] |= ((mask >> 3) & 1) * bit;
+  }
+  const unsigned int result = (anyBelow != 0 ? 1 : 0) | (allBelow != 15 ? 2 : 0);
+  return result | classifyRowScalar(values + i, count - i, isoLevel, bit, states + i);
+}
+#endif
+
+#ifdef DENSITYGRID_AVX
+///// classifyRowAVX //////////////////////////////////////////////////////////
+DENSITYGRID_TARGET_AVX static unsigned int classifyRowAVX(const double* values, const unsigned int count, const double isoLevel, const unsigned char bit, unsigned char* states)
+/// AVX version of classifyRowScalar handling 8 values per iteration.
+{
+  const __m256d iso = _mm256_set1_pd(isoLevel);
+  unsigned int anyBelow = 0, allBelow = 255;
+  unsigned int i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    const unsigned int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i), iso, _CMP_LT_OQ))
+                            | _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i + 4), iso, _CMP_LT_OQ)) << 4;
+    anyBelow |= mask;
+    allBelow &= mask;
+    for(unsigned int j = 0; j < 8; j++)
+      states[i + j] |= ((mask >> j) & 1) * bit;
+  }
+  const unsigned int result = (anyBelow != 0 ? 1 : 0) | (allBelow != 255 ? 2 : 0);
+  return result | classifyRowScalar(values + i, count - i, isoLevel, bit, states + i);
+}
+
+///// supportsAVX /////////////////////////////////////////////////////////////
+static bool supportsAVX()
+/// Returns whether the processor and the operating system support AVX.
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) // OSXSAVE and AVX
+    return false;
+  return (_xgetbv(0) & 6) == 6; // XMM and YMM state saved by the OS
+#else
+  __builtin_cpu_init(); // needed as this can be called before main
+  return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+///// selectRowClassifier /////////////////////////////////////////////////////
+static RowClassifier selectRowClassifier()
+/// Returns the fastest row classifier supported by the processor.
+{
+#ifdef DENSITYGRID_AVX
+  if(supportsAVX())
+    return classifyRowAVX;
+#endif
+#ifdef DENSITYGRID_SSE2
+  return classifyRowSSE2;
+#else
+  return classifyRowScalar;
+#endif
+}
+
+/// The row classifier used for this processor.
+static const RowClassifier rowClassifier = selectRowClassifier();
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Public Member Functions                                             /////
 ///////////////////////////////////////////////////////////////////////////////
 
 ///// constructor /////////////////////////////////////////////////////////////
-DensityGrid::DensityGrid()
+DensityGrid::DensityGrid() : engine(ENGINE_FLYING_EDGES),
+  pyramidThread(0),
+  surfaceResolution(0),
+  optimizeOrder(true),
+  orderReceiver(0),
+  serialCounter(0)
 /// The default constructor.
 {
 
@@ -65,16 +353,19 @@ DensityGrid::DensityGrid()
 DensityGrid::~DensityGrid()
 /// The default destructor.
 {
+  stopPyramid();
+  stopTriangleOrders();
   clearSurfaces();
 }
 
 ///// setParameters ///////////////////////////////////////////////////////////
-void DensityGrid::setParameters(const std::vector<double>* values, const Point3D<unsigned int>& pointDimension, const Point3D<float>& pointDelta, const Point3D<float>& pointOrigin)
+void DensityGrid::setParameters(const std::vector<double>* values, const Point3D<unsigned int>& pointDimension, const Point3D<float>& pointDelta, const Point3D<float>& pointOrigin, const bool calculateLevels)
 /// Sets up the input data needed for the calculation of the surface. 
 /// The values are the density values in 3 dimensions stored as a linear vector.
 /// pointDimension provides the dimensions of the cube while pointOrigin provides
 /// the location of the origin of this cube. pointDelta provides the spacing between 
-/// the points in each dimension.
+/// the points in each dimension. If calculateLevels is false, no downsampled
+/// resolution levels are calculated and all surfaces use the full grid.
 {
   clearParameters();
 
@@ -89,6 +380,13 @@ void DensityGrid::setParameters(const std::vector<double>* values, const Point3D
   maxDensity = *it; 
   it = std::min_element(densityValues.begin(), densityValues.end());
   minDensity = *it;
+
+  if(!calculateLevels)
+    return;
+
+  // calculate the downsampled levels in the background
+  pyramidThread = new DensityPyramidThread(&densityValues[0], numPoints, &pyramidValues, &pyramidPoints);
+  pyramidThread->start(QThread::LowPriority);
 }
 
 ///// setMappingParameters ////////////////////////////////////////////////////
@@ -113,36 +411,141 @@ void DensityGrid::setMappingParameters(const std::vector<double>* values, const
 }
 
 ///// addSurface //////////////////////////////////////////////////////////////
-void DensityGrid::addSurface(const double isoDensity)
+void DensityGrid::addSurface(const double isoDensity, const Region& region)
 /// Calculates the isosurface determined by the given isodensity.
-/// The surface is added to the list of surfaces.
+/// The surface is added to the list of surfaces. If a region is given, the
+/// surface is only calculated inside it.
 {
   isoLevels.push_back(isoDensity);
-  calculateSurface(isoDensity);
+  surfaceRegions.push_back(region);
 
-  // renaming
+  // vertices and triangles
   vector<Point3D<float> >* singleVerticesList = new vector<Point3D<float> >;
   vector<unsigned int>* singleTriangleIndices = new vector<unsigned int>;
-  renameVerticesAndTriangles(singleVerticesList, singleTriangleIndices);
+  surfaceLevels.push_back(extractSurface(isoDensity, singleVerticesList, singleTriangleIndices, region));
   verticesList.push_back(singleVerticesList);
   triangleIndices.push_back(singleTriangleIndices);
 
   // normals
-  vector<float>* singleNormals = new vector<float>;
-  calculateNormals(singleNormals, numSurfaces() - 1);
-  normals.push_back(singleNormals);
+  normals.push_back(new vector<float>);
+  surfaceSerials.push_back(0);
+  originalMissRatios.push_back(-1.0f);
+  orderedMissRatios.push_back(-1.0f);
+  finishSurface(numSurfaces() - 1);
 }
 
 ///// changeSurface ///////////////////////////////////////////////////////////
-void DensityGrid::changeSurface(const unsigned int surface, const double isoDensity)
-/// Recalculates an existing isosurface for a new isodensity.
+void DensityGrid::changeSurface(const unsigned int surface, const double isoDensity, const Region& region)
+/// Recalculates an existing isosurface for a new isodensity and/or region.
 {
   assert(surface < numSurfaces());
 
   isoLevels[surface] = isoDensity;
-  calculateSurface(isoDensity);
-  renameVerticesAndTriangles(verticesList[surface], triangleIndices[surface]);
-  calculateNormals(normals[surface], surface);
+  surfaceRegions[surface] = region;
+  surfaceLevels[surface] = extractSurface(isoDensity, verticesList[surface], triangleIndices[surface], region);
+  finishSurface(surface);
+}
+
+///// recalculateSurface //////////////////////////////////////////////////////
+void DensityGrid::recalculateSurface(const unsigned int surface)
+/// Recalculates an existing isosurface with its isodensity and region (e.g. 
+/// after changing the surface engine).
+{
+  assert(surface < numSurfaces());
+
+  changeSurface(surface, isoLevels[surface], surfaceRegions[surface]);
+}
+
+///// refreshSurface //////////////////////////////////////////////////////////
+bool DensityGrid::refreshSurface(const unsigned int surface)
+/// Recalculates an existing isosurface with its isodensity and region if it 
+/// was calculated at another resolution level than the current surface 
+/// resolution asks for (e.g. after zooming in). Returns whether the surface
+/// was recalculated.
+{
+  assert(surface < numSurfaces());
+
+  if(surfaceLevels[surface] == surfaceLevel())
+    return false;
+  recalculateSurface(surface);
+  return true;
+}
+
+///// setSurfaceEngine ////////////////////////////////////////////////////////
+void DensityGrid::setSurfaceEngine(const unsigned int type)
+/// Sets the algorithm used for calculating new and changed surfaces. 
+/// \param[in] type : corresponds to the enum SurfaceEngine
+{
+  assert(type < ENGINE_LAST);
+
+  engine = type;
+}
+
+///// setSurfaceResolution ////////////////////////////////////////////////////
+void DensityGrid::setSurfaceResolution(const unsigned int size)
+/// Sets the number of points along each direction which is sufficient for
+/// calculating new and changed surfaces. The finest level not exceeding this
+/// number is used. A value of 0 always uses the full resolution.
+{
+  surfaceResolution = size;
+}
+
+///// setOptimizeTriangleOrder ////////////////////////////////////////////////
+void DensityGrid::setOptimizeTriangleOrder(const bool optimize)
+/// Sets whether the triangles of new and changed surfaces are reordered for
+/// better reuse of the vertex cache of the graphics hardware. When switched
+/// on, the existing surfaces which have not been reordered yet are reordered
+/// as well.
+{
+  if(optimize && !optimizeOrder)
+  {
+    for(unsigned int i = 0; i < numSurfaces(); i++)
+    {
+      if(originalMissRatios[i] >= 0.0f)
+        continue;
+      bool pending = false;
+      for(vector<OrderWorker*>::iterator it = orderWorkers.begin(); it != orderWorkers.end() && !pending; it++)
+        pending = (*it)->serial() == surfaceSerials[i];
+      if(!pending)
+        startTriangleOrder(i);
+    }
+  }
+  optimizeOrder = optimize;
+}
+
+///// setOrderReceiver ////////////////////////////////////////////////////////
+void DensityGrid::setOrderReceiver(QObject* receiver)
+/// Sets the object which is notified with an event of type 1003 when triangles
+/// reordered in the background are ready. It should then call 
+/// updateTriangleOrder. If no receiver is set, the triangles are reordered 
+/// right after calculating a surface. Pending reorderings for a previous 
+/// receiver are discarded.
+{
+  stopTriangleOrders();
+  orderReceiver = receiver;
+}
+
+///// updateTriangleOrder /////////////////////////////////////////////////////
+void DensityGrid::updateTriangleOrder(vector<unsigned int>& surfaces)
+/// Uses the triangle orders of all finished background reorderings for the
+/// surfaces they were calculated for. Results for surfaces which have been
+/// changed or removed in the meantime are discarded. 
+/// \param[out] surfaces : the surfaces whose triangles were reordered
+{
+  surfaces.clear();
+  vector<OrderWorker*>::iterator it = orderWorkers.begin();
+  while(it != orderWorkers.end())
+  {
+    if((*it)->ready())
+    {
+      (*it)->wait();
+      applyTriangleOrder(*it, surfaces);
+      delete *it;
+      it = orderWorkers.erase(it);
+    }
+    else
+      it++;
+  }
 }
 
 ///// densityPresent //////////////////////////////////////////////////////////
@@ -159,6 +562,34 @@ bool DensityGrid::hasMapping() const
   return mappingValues.size() != 0;
 }
 
+///// surfaceEngine /////////////////////////////////////////////////////////
+unsigned int DensityGrid::surfaceEngine() const
+/// Returns the algorithm used for calculating surfaces.
+{
+  return engine;
+}
+
+///// optimizeTriangleOrder ///////////////////////////////////////////////////
+bool DensityGrid::optimizeTriangleOrder() const
+/// Returns whether the triangles of new and changed surfaces are reordered for
+/// vertex cache locality.
+{
+  return optimizeOrder;
+}
+
+///// missRatios //////////////////////////////////////////////////////////////
+bool DensityGrid::missRatios(const unsigned int surface, float& original, float& ordered) const
+/// Returns the average number of vertex cache misses per triangle of a surface
+/// in the order the triangles were calculated and after reordering them. 
+/// Returns false if the surface has not been reordered (yet).
+{
+  assert(surface < numSurfaces());
+
+  original = originalMissRatios[surface];
+  ordered = orderedMissRatios[surface];
+  return original >= 0.0f;
+}
+
 ///// numSurfaces /////////////////////////////////////////////////////////////
 unsigned int DensityGrid::numSurfaces() const
 /// Returns the number of calculated surfaces present.
@@ -270,8 +701,13 @@ Point3D<float> DensityGrid::getPoint(const unsigned int surface, const unsigned
 void DensityGrid::clearParameters()
 /// Removes all data and surfaces.
 {
+  stopPyramid();
+  pyramidValues.clear();
+  pyramidPoints.clear();
   clearSurfaces();
   densityValues.clear();
+  pointStates.clear();
+  rowInfo.clear();
 }
 
 ///// clearSurfaces ///////////////////////////////////////////////////////////
@@ -285,6 +721,11 @@ void DensityGrid::clearSurfaces()
     delete normals[i];
   }
   isoLevels.clear();
+  surfaceRegions.clear();
+  surfaceLevels.clear();
+  surfaceSerials.clear();
+  originalMissRatios.clear();
+  orderedMissRatios.clear();
   verticesList.clear();
   triangleIndices.clear();
   normals.clear();
@@ -311,27 +752,72 @@ void DensityGrid::removeSurface(const unsigned int surface)
   vector<double>::iterator iti = isoLevels.begin();
   iti += surface;
   isoLevels.erase(iti);
+  surfaceRegions.erase(surfaceRegions.begin() + surface);
+  surfaceLevels.erase(surfaceLevels.begin() + surface);
+  surfaceSerials.erase(surfaceSerials.begin() + surface);
+  originalMissRatios.erase(originalMissRatios.begin() + surface);
+  orderedMissRatios.erase(orderedMissRatios.begin() + surface);
 }
 
 ///// getOrigin ///////////////////////////////////////////////////////////////
-Point3D<float> DensityGrid::getOrigin() const
-/// Returns the currently set origin.
+Point3D<float> DensityGrid::getOrigin(const unsigned int level) const
+/// Returns the currently set origin. The first point of each downsampled
+/// level lies on the first point of the full grid, so all levels share it.
 {
+  assert(level < numLevels());
+
   return origin;
 }
 
 ///// getDelta ////////////////////////////////////////////////////////////////
-Point3D<float> DensityGrid::getDelta() const
-/// Returns the currently set deltas (spacing between the gridpoints).
+Point3D<float> DensityGrid::getDelta(const unsigned int level) const
+/// Returns the currently set deltas (spacing between the gridpoints) for the
+/// given resolution level.
 {
-  return delta;
+  assert(level < numLevels());
+
+  const float scale = static_cast<float>(1 << level);
+  return Point3D<float>(scale*delta.x(), scale*delta.y(), scale*delta.z());
 }
 
 ///// getNumPoints ////////////////////////////////////////////////////////////
-Point3D<unsigned int> DensityGrid::getNumPoints() const
-/// Returns the currently set number of points in each direction.
+Point3D<unsigned int> DensityGrid::getNumPoints(const unsigned int level) const
+/// Returns the currently set number of points in each direction for the given
+/// resolution level.
+{
+  assert(level < numLevels());
+
+  if(level == 0)
+    return numPoints;
+  return pyramidPoints[level - 1];
+}
+
+///// numLevels ///////////////////////////////////////////////////////////////
+unsigned int DensityGrid::numLevels() const
+/// Returns the number of available resolution levels. Level 0 is the full
+/// resolution grid. The downsampled levels only become available once their
+/// calculation has finished.
 {
-  return numPoints;
+  if(pyramidThread == 0 || !pyramidThread->finished())
+    return 1;
+  return pyramidValues.size() + 1;
+}
+
+///// levelForSize ////////////////////////////////////////////////////////////
+unsigned int DensityGrid::levelForSize(const unsigned int size) const
+/// Returns the finest available resolution level for which the number of 
+/// points in each direction does not exceed the given size. If no such level
+/// is available, the coarsest level is returned.
+{
+  const unsigned int levels = numLevels();
+  unsigned int level = 0;
+  for(; level < levels - 1; level++)
+  {
+    const Point3D<unsigned int> points = getNumPoints(level);
+    if(points.x() <= size && points.y() <= size && points.z() <= size)
+      break;
+  }
+  return level;
 }
 
 ///// getMaximumDensity ///////////////////////////////////////////////////////
@@ -350,13 +836,16 @@ double DensityGrid::getMinimumDensity() const
 
 ///// getSlice ////////////////////////////////////////////////////////////////
 QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index, const QColor& positiveColor, const QColor& negativeColor, 
-                             const double maxPlotValue, const double minPlotValue, const unsigned int map) const
+                             const double maxPlotValue, const double minPlotValue, const unsigned int map, const unsigned int level) const
 /// Returns a slice from the 3D grid oriented according to the given plane with 
 /// the given depth index. The image is produced in OpenGL coordinates, meaning
 /// y will increase from the bottom of the image to the top.
 /// If a color map is specified (different from MAP_LAST), it will be used for
 /// color mapping between the given extrema.
+/// The slice is taken from the given resolution level.
 {
+  const vector<double>& values = levelValues(level);
+  const Point3D<unsigned int> points = getNumPoints(level);
   unsigned int opacity;
   double value;
   // backup the current colormap as it will be overwritten
@@ -367,14 +856,14 @@ QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index,
   {
     case PLANE_XY: // varying z-index
     {
-      assert(index < numPoints.z());
-      QImage image(numPoints.x(), numPoints.y(), 32);
+      assert(index < points.z());
+      QImage image(points.x(), points.y(), 32);
       image.setAlphaBuffer(true);
-      std::vector<double>::const_iterator itPoints = densityValues.begin();
+      std::vector<double>::const_iterator itPoints = values.begin();
       itPoints += index;
-      for(unsigned int x = 0; x < numPoints.x(); x++)
+      for(unsigned int x = 0; x < points.x(); x++)
       {
-        for(unsigned int y = numPoints.y(); y > 0; y--)
+        for(unsigned int y = points.y(); y > 0; y--)
         {
           value = *itPoints;
           if(colorMap == MAP_LAST)
@@ -407,7 +896,7 @@ QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index,
               mapValue = 1.0;
             image.setPixel(x, y-1, mapColor(mapValue).rgb());
           }
-          itPoints += numPoints.z();
+          itPoints += points.z();
         }
       }
       colorMap = currentMap;
@@ -416,21 +905,21 @@ QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index,
 
     case PLANE_XZ: // varying y-index
     {
-      assert(index < numPoints.y());
-      QImage image(numPoints.x(), numPoints.z(), 32);
+      assert(index < points.y());
+      QImage image(points.x(), points.z(), 32);
       image.setAlphaBuffer(true);
-      std::vector<double>::const_iterator itPoints = densityValues.begin();
-      for(unsigned int x = 0; x < numPoints.x(); x++)
+      std::vector<double>::const_iterator itPoints = values.begin();
+      for(unsigned int x = 0; x < points.x(); x++)
       {
-        for(unsigned int y = 0; y < numPoints.y(); y++)
+        for(unsigned int y = 0; y < points.y(); y++)
         {
           if(y != index)
           {
-            itPoints += numPoints.z();
+            itPoints += points.z();
             continue;
           }
           // here y == index
-          for(unsigned int z = numPoints.z(); z > 0; z--)
+          for(unsigned int z = points.z(); z > 0; z--)
           {
             value = *itPoints++;
             if(colorMap == MAP_LAST)
@@ -470,14 +959,14 @@ QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index,
 
     case PLANE_YZ: // varying x-index
     {
-      assert(index < numPoints.x());
-      QImage image(numPoints.y(), numPoints.z(), 32);
+      assert(index < points.x());
+      QImage image(points.y(), points.z(), 32);
       image.setAlphaBuffer(true);
-      std::vector<double>::const_iterator itPoints = densityValues.begin();
-      itPoints += index * numPoints.y() * numPoints.z();
-      for(unsigned int y = 0; y < numPoints.y(); y++)
+      std::vector<double>::const_iterator itPoints = values.begin();
+      itPoints += index * points.y() * points.z();
+      for(unsigned int y = 0; y < points.y(); y++)
       {
-        for(unsigned int z = numPoints.z(); z > 0; z--)
+        for(unsigned int z = points.z(); z > 0; z--)
         {
           value = *itPoints++;
           if(colorMap == MAP_LAST)
@@ -516,21 +1005,21 @@ QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index,
 
     case PLANE_ZX: // varying y-index but rotated
     {
-      assert(index < numPoints.y());
-      QImage image(numPoints.z(), numPoints.x(), 32);
+      assert(index < points.y());
+      QImage image(points.z(), points.x(), 32);
       image.setAlphaBuffer(true);
-      std::vector<double>::const_iterator itPoints = densityValues.begin();
-      for(unsigned int x = numPoints.x(); x > 0; x--)
+      std::vector<double>::const_iterator itPoints = values.begin();
+      for(unsigned int x = points.x(); x > 0; x--)
       {
-        for(unsigned int y = 0; y < numPoints.y(); y++)
+        for(unsigned int y = 0; y < points.y(); y++)
         {
           if(y != index)
           {
-            itPoints += numPoints.z();
+            itPoints += points.z();
             continue;
           }
           // here y == index
-          for(unsigned int z = 0; z < numPoints.z(); z++)
+          for(unsigned int z = 0; z < points.z(); z++)
           {
             value = *itPoints++;
             if(colorMap == MAP_LAST)
@@ -577,6 +1066,196 @@ QImage DensityGrid::getSlice(const unsigned int plane, const unsigned int index,
 ///// Private Member Functions                                            /////
 ///////////////////////////////////////////////////////////////////////////////
 
+///// extractSurface //////////////////////////////////////////////////////////
+unsigned int DensityGrid::extractSurface(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices, const Region& region)
+/// Calculates the vertices and the triangles of an isosurface with the active
+/// engine. If a surface resolution is set, the corresponding downsampled level
+/// is used. If a region is given, only the grid points covering it are used.
+/// Returns the level used.
+{
+  const unsigned int level = surfaceLevel();
+  if(level == 0)
+    extractSurfaceRegion(isoDensity, singleVerticesList, singleTriangleIndices, region);
+  else
+  {
+    ///// temporarily replace the grid by the downsampled level
+    const Point3D<unsigned int> fullPoints = numPoints;
+    const Point3D<float> fullDelta = delta;
+    const Point3D<float> fullOrigin = origin;
+    const Point3D<unsigned int> levelPoints = getNumPoints(level);
+    const Point3D<float> levelDelta = getDelta(level);
+    const Point3D<float> levelOrigin = getOrigin(level);
+    densityValues.swap(pyramidValues[level - 1]);
+    numPoints = levelPoints;
+    delta = levelDelta;
+    origin = levelOrigin;
+    extractSurfaceRegion(isoDensity, singleVerticesList, singleTriangleIndices, region);
+    densityValues.swap(pyramidValues[level - 1]);
+    numPoints = fullPoints;
+    delta = fullDelta;
+    origin = fullOrigin;
+
+    ///// shift the vertices to the origin of the full grid
+    const Point3D<float> shift(levelOrigin.x() - origin.x(), levelOrigin.y() - origin.y(), levelOrigin.z() - origin.z());
+    for(std::vector<Point3D<float> >::iterator it = singleVerticesList->begin(); it != singleVerticesList->end(); it++)
+      it->add(shift);
+  }
+  return level;
+}
+
+///// surfaceLevel ////////////////////////////////////////////////////////////
+unsigned int DensityGrid::surfaceLevel() const
+/// Returns the resolution level at which surfaces are calculated for the 
+/// current surface resolution.
+{
+  return surfaceResolution == 0 ? 0 : levelForSize(surfaceResolution);
+}
+
+///// extractSurfaceRegion ////////////////////////////////////////////////////
+void DensityGrid::extractSurfaceRegion(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices, const Region& region)
+/// Calculates the vertices and the triangles of an isosurface with the active
+/// engine. If a region is given, only the grid points covering it are used.
+{
+  Point3D<unsigned int> firstPoint, lastPoint;
+  if(region.type == REGION_NONE)
+    extractSurfaceEngine(isoDensity, singleVerticesList, singleTriangleIndices);
+  else if(!regionPoints(region, firstPoint, lastPoint))
+  {
+    // the region does not contain any cells
+    singleVerticesList->clear();
+    singleTriangleIndices->clear();
+  }
+  else
+  {
+    ///// temporarily replace the grid by the part covering the region
+    const Point3D<unsigned int> subPoints(lastPoint.x() - firstPoint.x() + 1, lastPoint.y() - firstPoint.y() + 1, lastPoint.z() - firstPoint.z() + 1);
+    vector<double> subValues;
+    subValues.reserve(subPoints.x()*subPoints.y()*subPoints.z());
+    for(unsigned int x = firstPoint.x(); x <= lastPoint.x(); x++)
+    {
+      for(unsigned int y = firstPoint.y(); y <= lastPoint.y(); y++)
+      {
+        std::vector<double>::const_iterator itRow = densityValues.begin() + getArrayIndex(x, y, firstPoint.z());
+        subValues.insert(subValues.end(), itRow, itRow + subPoints.z());
+      }
+    }
+    const Point3D<unsigned int> fullPoints = numPoints;
+    densityValues.swap(subValues);
+    numPoints = subPoints;
+    extractSurfaceEngine(isoDensity, singleVerticesList, singleTriangleIndices);
+    densityValues.swap(subValues);
+    numPoints = fullPoints;
+
+    ///// shift the vertices to the full grid
+    const Point3D<float> shift(firstPoint.x()*delta.x(), firstPoint.y()*delta.y(), firstPoint.z()*delta.z());
+    for(std::vector<Point3D<float> >::iterator it = singleVerticesList->begin(); it != singleVerticesList->end(); it++)
+      it->add(shift);
+    if(region.type == REGION_SPHERE)
+      clipSurface(region, singleVerticesList, singleTriangleIndices);
+  }
+}
+
+///// extractSurfaceEngine ////////////////////////////////////////////////////
+void DensityGrid::extractSurfaceEngine(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices)
+/// Calculates the vertices and the triangles of an isosurface for the whole 
+/// grid with the active engine.
+{
+  if(engine == ENGINE_FLYING_EDGES)
+    calculateSurfaceFlyingEdges(isoDensity, singleVerticesList, singleTriangleIndices);
+  else
+  {
+    calculateSurface(isoDensity);
+    renameVerticesAndTriangles(singleVerticesList, singleTriangleIndices);
+  }
+}
+
+///// regionPoints ////////////////////////////////////////////////////////////
+bool DensityGrid::regionPoints(const Region& region, Point3D<unsigned int>& firstPoint, Point3D<unsigned int>& lastPoint) const
+/// Determines the range of grid points covering the given box or the bounding
+/// box of the given sphere. Returns false if this range does not contain any
+/// cells.
+{
+  assert(region.type == REGION_BOX || region.type == REGION_SPHERE);
+
+  Point3D<float> minimum = region.minimum;
+  Point3D<float> maximum = region.maximum;
+  if(region.type == REGION_SPHERE)
+  {
+    minimum.setValues(region.center.x() - region.radius, region.center.y() - region.radius, region.center.z() - region.radius);
+    maximum.setValues(region.center.x() + region.radius, region.center.y() + region.radius, region.center.z() + region.radius);
+  }
+
+  const double minimumIndex[3] = {floor((minimum.x() - origin.x())/delta.x()), 
+                                  floor((minimum.y() - origin.y())/delta.y()), 
+                                  floor((minimum.z() - origin.z())/delta.z())};
+  const double maximumIndex[3] = {ceil((maximum.x() - origin.x())/delta.x()), 
+                                  ceil((maximum.y() - origin.y())/delta.y()), 
+                                  ceil((maximum.z() - origin.z())/delta.z())};
+  const unsigned int gridPoints[3] = {numPoints.x(), numPoints.y(), numPoints.z()};
+  unsigned int first[3], last[3];
+  for(unsigned int i = 0; i < 3; i++)
+  {
+    if(maximumIndex[i] < 1.0 || minimumIndex[i] > static_cast<double>(gridPoints[i] - 2))
+      return false; // the region lies outside the grid
+    first[i] = minimumIndex[i] < 0.0 ? 0 : static_cast<unsigned int>(minimumIndex[i]);
+    last[i] = maximumIndex[i] > static_cast<double>(gridPoints[i] - 1) ? gridPoints[i] - 1 : static_cast<unsigned int>(maximumIndex[i]);
+    if(first[i] >= last[i])
+      return false;
+  }
+  firstPoint.setValues(first[0], first[1], first[2]);
+  lastPoint.setValues(last[0], last[1], last[2]);
+  return true;
+}
+
+///// clipSurface /////////////////////////////////////////////////////////////
+void DensityGrid::clipSurface(const Region& region, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices) const
+/// Removes the triangles with their center outside a spherical region and the
+/// vertices which are no longer used.
+{
+  const float radius2 = region.radius*region.radius;
+  const float centerX = region.center.x() - origin.x();
+  const float centerY = region.center.y() - origin.y();
+  const float centerZ = region.center.z() - origin.z();
+  const unsigned int unused = static_cast<unsigned int>(-1);
+  vector<unsigned int> newIDs(singleVerticesList->size(), unused);
+
+  ///// keep the triangles inside the sphere and mark their vertices
+  unsigned int numIndices = 0;
+  for(unsigned int i = 0; i < singleTriangleIndices->size(); i += 3)
+  {
+    const Point3D<float>& point1 = (*singleVerticesList)[(*singleTriangleIndices)[i]];
+    const Point3D<float>& point2 = (*singleVerticesList)[(*singleTriangleIndices)[i + 1]];
+    const Point3D<float>& point3 = (*singleVerticesList)[(*singleTriangleIndices)[i + 2]];
+    const float dx = (point1.x() + point2.x() + point3.x())/3.0f - centerX;
+    const float dy = (point1.y() + point2.y() + point3.y())/3.0f - centerY;
+    const float dz = (point1.z() + point2.z() + point3.z())/3.0f - centerZ;
+    if(dx*dx + dy*dy + dz*dz > radius2)
+      continue;
+    for(unsigned int j = 0; j < 3; j++)
+    {
+      const unsigned int id = (*singleTriangleIndices)[i + j];
+      newIDs[id] = 0;
+      (*singleTriangleIndices)[numIndices++] = id;
+    }
+  }
+  singleTriangleIndices->resize(numIndices);
+
+  ///// compact the vertices keeping their order
+  unsigned int numVertices = 0;
+  for(unsigned int i = 0; i < newIDs.size(); i++)
+  {
+    if(newIDs[i] == unused)
+      continue;
+    newIDs[i] = numVertices;
+    (*singleVerticesList)[numVertices] = (*singleVerticesList)[i];
+    (*singleVerticesList)[numVertices].setID(numVertices);
+    numVertices++;
+  }
+  singleVerticesList->resize(numVertices);
+  for(unsigned int i = 0; i < numIndices; i++)
+    (*singleTriangleIndices)[i] = newIDs[(*singleTriangleIndices)[i]];
+}
+
 ///// calculateSurface ///////////////////////////////////////////////////////////
 void DensityGrid::calculateSurface(const double isoDensity)
 /// Does the basic calculation of an isosurface.
@@ -584,29 +1263,18 @@ void DensityGrid::calculateSurface(const double isoDensity)
   currentIsoLevel = isoDensity;
   vertices.clear();
   triangles.clear();
+  cellCases.resize(numPoints.z());
 
-  for(unsigned int z = 0; z < numPoints.z() - 1; z++)
+  for(unsigned int x = 0; x < numPoints.x() - 1; x++)
     for(unsigned int y = 0; y < numPoints.y() -1; y++)
-	    for(unsigned int x = 0; x < numPoints.x() - 1; x++)
+    {
+      ///// determine the table lookup indices of a row of cells from the vertices which are below the isoLevel
+      if(!classifyCells(x, y))
+        continue; // no cell is intersected by the isosurface
+
+	    for(unsigned int z = 0; z < numPoints.z() - 1; z++)
       {
-        ///// determine the table lookup index from the vertices which are below the isoLevel
-        unsigned int tableIndex = 0;
-		    if(densityValues[getArrayIndex(x, y, z)] < currentIsoLevel)
-		      tableIndex |= 1;
-        if(densityValues[getArrayIndex(x, y+1, z)] < currentIsoLevel)
-		      tableIndex |= 2;
-		    if(densityValues[getArrayIndex(x+1, y+1, z)] < currentIsoLevel)
-		      tableIndex |= 4;
-		    if(densityValues[getArrayIndex(x+1, y, z)] < currentIsoLevel)
-		      tableIndex |= 8;
-		    if(densityValues[getArrayIndex(x, y, z+1)] < currentIsoLevel)
-		      tableIndex |= 16;
-		    if(densityValues[getArrayIndex(x, y+1, z+1)] < currentIsoLevel)
-		      tableIndex |= 32;
-		    if(densityValues[getArrayIndex(x+1, y+1, z+1)] < currentIsoLevel)
-		      tableIndex |= 64;
-		    if(densityValues[getArrayIndex(x+1, y, z+1)] < currentIsoLevel)
-		      tableIndex |= 128;
+        const unsigned int tableIndex = cellCases[z];
 
         ///// create a triangulation of the isosurface of this cell
 		    if(edgeTable[tableIndex] != 0)
@@ -713,6 +1381,349 @@ void DensityGrid::calculateSurface(const double isoDensity)
 		      }
 		    }
 	    }
+    }
+}
+
+///// classifyCells ///////////////////////////////////////////////////////////
+bool DensityGrid::classifyCells(const unsigned int x, const unsigned int y)
+/// Determines the table lookup indices of the row of cells along z starting at
+/// grid point (x, y, 0) and stores them in cellCases. Returns false if none of 
+/// the cells is intersected by the isosurface.
+{
+  std::fill(cellCases.begin(), cellCases.end(), 0);
+  unsigned char* states = &cellCases[0];
+  const unsigned int count = numPoints.z();
+  unsigned int summary = rowClassifier(&densityValues[getArrayIndex(x, y, 0)], count, currentIsoLevel, 1, states);
+  summary |= rowClassifier(&densityValues[getArrayIndex(x, y+1, 0)], count, currentIsoLevel, 2, states);
+  summary |= rowClassifier(&densityValues[getArrayIndex(x+1, y+1, 0)], count, currentIsoLevel, 4, states);
+  summary |= rowClassifier(&densityValues[getArrayIndex(x+1, y, 0)], count, currentIsoLevel, 8, states);
+  if(summary != 3)
+    return false; // all grid points lie on the same side of the isosurface
+
+  // combine the states of the grid points at z and z+1
+  for(unsigned int z = 0; z < count - 1; z++)
+    states[z] |= states[z + 1] << 4;
+  return true;
+}
+
+///// calculateSurfaceFlyingEdges ///////////////////////////////////////////////
+void DensityGrid::calculateSurfaceFlyingEdges(const double isoDensity, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices)
+/// Calculates an isosurface using the flying edges algorithm. The vertices are
+/// numbered in the same order as renameVerticesAndTriangles does for the 
+/// marching cubes engine. Each pass only depends on the results of the previous 
+/// ones and each row of a pass writes to its own data, so the rows of a pass 
+/// can be processed in any order and by multiple threads.
+{
+  assert(numPoints.x() > 1 && numPoints.y() > 1 && numPoints.z() > 1);
+
+  currentIsoLevel = isoDensity;
+  const unsigned int numRows = numPoints.x()*numPoints.y();
+  pointStates.resize(densityValues.size());
+  rowInfo.resize(numRows);
+
+  ///// pass 1: classify the grid points and the edges along z
+  runPass(PASS_CLASSIFY, singleVerticesList, singleTriangleIndices);
+
+  ///// pass 2: count the vertices and triangles of each row
+  runPass(PASS_COUNT, singleVerticesList, singleTriangleIndices);
+
+  ///// pass 3: allocate the output and assign the starting positions of each row
+  unsigned int totalVertices = 0, totalTriangles = 0;
+  for(unsigned int row = 0; row < numRows; row++)
+  {
+    rowInfo[row].firstVertex = totalVertices;
+    rowInfo[row].firstTriangle = totalTriangles;
+    totalVertices += rowInfo[row].numVertices;
+    totalTriangles += rowInfo[row].numTriangles;
+  }
+  singleVerticesList->clear();
+  singleVerticesList->resize(totalVertices);
+  singleTriangleIndices->clear();
+  singleTriangleIndices->resize(3*totalTriangles);
+
+  ///// pass 4: generate the vertices and triangles
+  runPass(PASS_GENERATE, singleVerticesList, singleTriangleIndices);
+}
+
+///// runPass /////////////////////////////////////////////////////////////////
+void DensityGrid::runPass(const unsigned int pass, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices)
+/// Runs a pass of the flying edges engine over all slices of constant x. For
+/// large grids the slices are divided over one thread per processor. All
+/// threads are finished on return, as each pass needs the complete results
+/// of the previous one.
+{
+  const unsigned int numThreads = densityValues.size() < parallelPoints ? 1 : std::min(SystemInfo::numProcessors(), numPoints.x());
+  if(numThreads == 1)
+  {
+    for(unsigned int x = 0; x < numPoints.x(); x++)
+      processSlice(pass, x, singleVerticesList, singleTriangleIndices);
+    return;
+  }
+
+  QMutex sliceMutex;
+  unsigned int nextSlice = 0;
+  vector<SliceWorker*> pool;
+  for(unsigned int i = 0; i < numThreads; i++)
+  {
+    pool.push_back(new SliceWorker(this, pass, singleVerticesList, singleTriangleIndices, &sliceMutex, &nextSlice));
+    pool.back()->start();
+  }
+  for(unsigned int i = 0; i < numThreads; i++)
+  {
+    pool[i]->wait();
+    delete pool[i];
+  }
+}
+
+///// processSlice ////////////////////////////////////////////////////////////
+void DensityGrid::processSlice(const unsigned int pass, const unsigned int x, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices)
+/// Runs a pass of the flying edges engine over the rows of the slice x.
+{
+  for(unsigned int y = 0; y < numPoints.y(); y++)
+  {
+    switch(pass)
+    {
+      case PASS_CLASSIFY: classifyRow(x*numPoints.y() + y);
+                          break;
+      case PASS_COUNT:    countRow(x, y);
+                          break;
+      case PASS_GENERATE: generateRow(x, y, singleVerticesList, singleTriangleIndices);
+                          break;
+    }
+  }
+}
+
+///// classifyRow /////////////////////////////////////////////////////////////
+void DensityGrid::classifyRow(const unsigned int row)
+/// Determines for each grid point of a row whether it lies below the isolevel
+/// and finds the first and last intersected edge along z.
+{
+  const unsigned int offset = row*numPoints.z();
+  RowInfo& info = rowInfo[row];
+  info.edgeMin = numPoints.z();
+  info.edgeMax = 0;
+
+  memset(&pointStates[offset], 0, numPoints.z());
+  rowClassifier(&densityValues[offset], numPoints.z(), currentIsoLevel, 1, &pointStates[offset]);
+
+  for(unsigned int z = 0; z < numPoints.z() - 1; z++)
+  {
+    if(pointStates[offset + z] != pointStates[offset + z + 1])
+    {
+      if(info.edgeMin == numPoints.z())
+        info.edgeMin = z;
+      info.edgeMax = z + 1;
+    }
+  }
+}
+
+///// countRow ////////////////////////////////////////////////////////////////
+void DensityGrid::countRow(const unsigned int x, const unsigned int y)
+/// Determines the ranges of grid points and cells that have to be visited for
+/// a row and counts the number of vertices it owns and the number of triangles
+/// it generates.
+{
+  const unsigned int row = x*numPoints.y() + y;
+  RowInfo& info = rowInfo[row];
+  unsigned int rows[4];
+  unsigned int first, last;
+
+  ///// the range of grid points owning intersected edges
+  info.vertexMin = info.edgeMin;
+  info.vertexMax = info.edgeMax;
+  if(x < numPoints.x() - 1)
+  {
+    rows[0] = row;
+    rows[1] = row + numPoints.y();
+    gridRange(rows, 2, first, last);
+    info.vertexMin = std::min(info.vertexMin, first);
+    info.vertexMax = std::max(info.vertexMax, last);
+  }
+  if(y < numPoints.y() - 1)
+  {
+    rows[0] = row;
+    rows[1] = row + 1;
+    gridRange(rows, 2, first, last);
+    info.vertexMin = std::min(info.vertexMin, first);
+    info.vertexMax = std::max(info.vertexMax, last);
+  }
+  info.numVertices = 0;
+  for(unsigned int z = info.vertexMin; z <= info.vertexMax && z < numPoints.z(); z++)
+  {
+    const unsigned int cuts = edgeCuts(x, y, z);
+    info.numVertices += (cuts & 1) + ((cuts >> 1) & 1) + ((cuts >> 2) & 1);
+  }
+
+  ///// the range of cells containing triangles
+  info.cellMin = numPoints.z();
+  info.cellMax = 0;
+  info.numTriangles = 0;
+  if(x == numPoints.x() - 1 || y == numPoints.y() - 1)
+    return;
+  rows[0] = row;
+  rows[1] = row + 1;
+  rows[2] = row + numPoints.y();
+  rows[3] = row + numPoints.y() + 1;
+  gridRange(rows, 4, first, last);
+  if(first > last)
+    return;
+  // a cell contains the grid points z and z+1
+  info.cellMin = first > 0 ? first - 1 : 0;
+  info.cellMax = std::min(last, numPoints.z() - 2);
+  for(unsigned int z = info.cellMin; z <= info.cellMax; z++)
+    info.numTriangles += triangleCountTable[cellCase(x, y, z)];
+}
+
+///// generateRow /////////////////////////////////////////////////////////////
+void DensityGrid::generateRow(const unsigned int x, const unsigned int y, vector<Point3D<float> >* singleVerticesList, vector<unsigned int>* singleTriangleIndices)
+/// Generates the vertices owned by a row and the triangles of the row of cells
+/// starting at that row. The vertex IDs of the edges of a cell are tracked 
+/// with a running counter for each of the 4 rows of grid points surrounding 
+/// the row of cells.
+{
+  const unsigned int row = x*numPoints.y() + y;
+  const RowInfo& info = rowInfo[row];
+
+  ///// the vertices in the order x, y and z for each grid point
+  unsigned int vertexID = info.firstVertex;
+  for(unsigned int z = info.vertexMin; z <= info.vertexMax && z < numPoints.z(); z++)
+  {
+    const unsigned int cuts = edgeCuts(x, y, z);
+    if(cuts & 1)
+    {
+      (*singleVerticesList)[vertexID] = intersection(x, y, z, 3);
+      (*singleVerticesList)[vertexID].setID(vertexID);
+      vertexID++;
+    }
+    if(cuts & 2)
+    {
+      (*singleVerticesList)[vertexID] = intersection(x, y, z, 0);
+      (*singleVerticesList)[vertexID].setID(vertexID);
+      vertexID++;
+    }
+    if(cuts & 4)
+    {
+      (*singleVerticesList)[vertexID] = intersection(x, y, z, 8);
+      (*singleVerticesList)[vertexID].setID(vertexID);
+      vertexID++;
+    }
+  }
+  assert(vertexID == info.firstVertex + info.numVertices);
+
+  ///// the triangles
+  if(info.numTriangles == 0)
+    return;
+  // the rows are ordered as (x, y), (x, y+1), (x+1, y), (x+1, y+1)
+  const unsigned int rowX[4] = {x, x, x + 1, x + 1};
+  const unsigned int rowY[4] = {y, y + 1, y, y + 1};
+  unsigned int baseID[4], cuts[4], nextBaseID[4], nextCuts[4];
+  for(unsigned int i = 0; i < 4; i++)
+  {
+    const RowInfo& neighbour = rowInfo[rowX[i]*numPoints.y() + rowY[i]];
+    baseID[i] = neighbour.firstVertex;
+    for(unsigned int z = neighbour.vertexMin; z < info.cellMin; z++)
+    {
+      const unsigned int pointCuts = edgeCuts(rowX[i], rowY[i], z);
+      baseID[i] += (pointCuts & 1) + ((pointCuts >> 1) & 1) + ((pointCuts >> 2) & 1);
+    }
+    cuts[i] = edgeCuts(rowX[i], rowY[i], info.cellMin);
+  }
+  unsigned int* triangleID = &(*singleTriangleIndices)[3*info.firstTriangle];
+  unsigned int edgeID[12];
+  for(unsigned int z = info.cellMin; z <= info.cellMax; z++)
+  {
+    for(unsigned int i = 0; i < 4; i++)
+    {
+      nextBaseID[i] = baseID[i] + (cuts[i] & 1) + ((cuts[i] >> 1) & 1) + ((cuts[i] >> 2) & 1);
+      nextCuts[i] = edgeCuts(rowX[i], rowY[i], z + 1);
+    }
+    const unsigned int tableIndex = cellCase(x, y, z);
+    if(edgeTable[tableIndex] != 0)
+    {
+      edgeID[0]  = baseID[0] + (cuts[0] & 1);
+      edgeID[1]  = baseID[1];
+      edgeID[2]  = baseID[2] + (cuts[2] & 1);
+      edgeID[3]  = baseID[0];
+      edgeID[4]  = nextBaseID[0] + (nextCuts[0] & 1);
+      edgeID[5]  = nextBaseID[1];
+      edgeID[6]  = nextBaseID[2] + (nextCuts[2] & 1);
+      edgeID[7]  = nextBaseID[0];
+      edgeID[8]  = baseID[0] + (cuts[0] & 1) + ((cuts[0] >> 1) & 1);
+      edgeID[9]  = baseID[1] + (cuts[1] & 1) + ((cuts[1] >> 1) & 1);
+      edgeID[10] = baseID[3] + (cuts[3] & 1) + ((cuts[3] >> 1) & 1);
+      edgeID[11] = baseID[2] + (cuts[2] & 1) + ((cuts[2] >> 1) & 1);
+      for(unsigned int i = 0; triTable[tableIndex][i] != -1; i++)
+        *triangleID++ = edgeID[triTable[tableIndex][i]];
+    }
+    for(unsigned int i = 0; i < 4; i++)
+    {
+      baseID[i] = nextBaseID[i];
+      cuts[i] = nextCuts[i];
+    }
+  }
+  assert(triangleID == &(*singleTriangleIndices)[0] + 3*(info.firstTriangle + info.numTriangles));
+}
+
+///// gridRange ///////////////////////////////////////////////////////////////
+void DensityGrid::gridRange(const unsigned int* rows, const unsigned int count, unsigned int& first, unsigned int& last) const
+/// Returns the range of grid points along z outside of which all edges between
+/// and along the given rows are not intersected. This is the case when all
+/// rows have no intersections along z there and the grid points of all rows
+/// lie on the same side of the isosurface. If there are no intersections at all
+/// first will be larger than last.
+{
+  first = numPoints.z();
+  last = 0;
+  const unsigned char firstState = pointStates[rows[0]*numPoints.z()];
+  const unsigned char lastState = pointStates[rows[0]*numPoints.z() + numPoints.z() - 1];
+  for(unsigned int i = 0; i < count; i++)
+  {
+    const RowInfo& info = rowInfo[rows[i]];
+    if(info.edgeMin <= info.edgeMax)
+    {
+      first = std::min(first, info.edgeMin);
+      last = std::max(last, info.edgeMax);
+    }
+    if(pointStates[rows[i]*numPoints.z()] != firstState)
+      first = 0;
+    if(pointStates[rows[i]*numPoints.z() + numPoints.z() - 1] != lastState)
+      last = numPoints.z() - 1;
+  }
+}
+
+///// edgeCuts ////////////////////////////////////////////////////////////////
+unsigned int DensityGrid::edgeCuts(const unsigned int x, const unsigned int y, const unsigned int z) const
+/// Returns which of the 3 edges starting at the given grid point in the positive
+/// x, y and z direction (bit 1, 2 and 4, respectively) are intersected by the
+/// isosurface.
+{
+  const unsigned int index = getArrayIndex(x, y, z);
+  unsigned int result = 0;
+  if(x < numPoints.x() - 1 && pointStates[index] != pointStates[index + numPoints.y()*numPoints.z()])
+    result |= 1;
+  if(y < numPoints.y() - 1 && pointStates[index] != pointStates[index + numPoints.z()])
+    result |= 2;
+  if(z < numPoints.z() - 1 && pointStates[index] != pointStates[index + 1])
+    result |= 4;
+  return result;
+}
+
+///// cellCase ////////////////////////////////////////////////////////////////
+unsigned int DensityGrid::cellCase(const unsigned int x, const unsigned int y, const unsigned int z) const
+/// Returns the table lookup index of the cell starting at the given grid point
+/// using the classified grid points.
+{
+  const unsigned int index = getArrayIndex(x, y, z);
+  const unsigned int offsetX = numPoints.y()*numPoints.z();
+  const unsigned int offsetY = numPoints.z();
+  return pointStates[index]
+      | pointStates[index + offsetY] << 1
+      | pointStates[index + offsetX + offsetY] << 2
+      | pointStates[index + offsetX] << 3
+      | pointStates[index + 1] << 4
+      | pointStates[index + offsetY + 1] << 5
+      | pointStates[index + offsetX + offsetY + 1] << 6
+      | pointStates[index + offsetX + 1] << 7;
 }
 
 ///// intersection ////////////////////////////////////////////////////////////
@@ -775,7 +1786,7 @@ Point3D<float> DensityGrid::intersection(const unsigned int x, const unsigned in
 			       break;
   }
   Point3D<float> point1(v1x * delta.x(), v1y * delta.y(), v1z * delta.z());
-  Point3D<float> point2(v2x * delta.y(), v2y * delta.y(), v2z * delta.z());
+  Point3D<float> point2(v2x * delta.x(), v2y * delta.y(), v2z * delta.z());
 
   double var1 = densityValues[getArrayIndex(v1x, v1y, v1z)];
   double var2 = densityValues[getArrayIndex(v2x, v2y, v2z)];
@@ -880,9 +1891,9 @@ void DensityGrid::calculateNormals(vector<float>* singleNormals, const unsigned
 /// Calculates the normals on each vertex.
 {
   singleNormals->clear();
-  singleNormals->reserve(triangleIndices[surface]->size());
+  singleNormals->reserve(verticesList[surface]->size()*3);
 
-  for(unsigned int i = 0; i < triangleIndices[surface]->size(); i++)
+  for(unsigned int i = 0; i < verticesList[surface]->size()*3; i++)
     singleNormals->push_back(0.0f);
 
   for(unsigned int i = 0; i < triangleIndices[surface]->size()/3; i++)
@@ -906,6 +1917,73 @@ void DensityGrid::calculateNormals(vector<float>* singleNormals, const unsigned
   }
 }
 
+///// finishSurface ///////////////////////////////////////////////////////////
+void DensityGrid::finishSurface(const unsigned int surface)
+/// Calculates the normals of a surface and gives it a new serial. If 
+/// requested, the triangles are reordered for vertex cache locality.
+{
+  calculateNormals(normals[surface], surface);
+  surfaceSerials[surface] = ++serialCounter;
+  originalMissRatios[surface] = -1.0f;
+  orderedMissRatios[surface] = -1.0f;
+  if(optimizeOrder)
+    startTriangleOrder(surface);
+}
+
+///// startTriangleOrder //////////////////////////////////////////////////////
+void DensityGrid::startTriangleOrder(const unsigned int surface)
+/// Reorders the triangles of a surface for vertex cache locality. If a receiver
+/// is set, a copy of the triangles is reordered in a background thread and the
+/// surface keeps its current order until updateTriangleOrder is called. 
+/// Otherwise the triangles are reordered immediately.
+{
+  OrderWorker* worker = new OrderWorker(*triangleIndices[surface], verticesList[surface]->size(), surfaceSerials[surface], orderReceiver);
+  if(orderReceiver == 0)
+  {
+    worker->reorder();
+    vector<unsigned int> surfaces;
+    applyTriangleOrder(worker, surfaces);
+    delete worker;
+    return;
+  }
+  orderWorkers.push_back(worker);
+  worker->start(QThread::LowPriority);
+}
+
+///// applyTriangleOrder //////////////////////////////////////////////////////
+void DensityGrid::applyTriangleOrder(OrderWorker* worker, vector<unsigned int>& surfaces)
+/// Stores the cache miss ratios calculated by a worker and uses its triangle
+/// order if it is better than the current one. Nothing is done if the surface
+/// has been changed or removed since the worker was started.
+/// \param[in] worker : a worker which has finished reordering
+/// \param[out] surfaces : the index of the surface is appended if it was reordered
+{
+  const vector<unsigned int>::iterator it = std::find(surfaceSerials.begin(), surfaceSerials.end(), worker->serial());
+  if(it == surfaceSerials.end())
+    return;
+  const unsigned int surface = it - surfaceSerials.begin();
+
+  vector<unsigned int> orderedIndices;
+  worker->result(orderedIndices, originalMissRatios[surface], orderedMissRatios[surface]);
+  if(orderedMissRatios[surface] < originalMissRatios[surface])
+  {
+    triangleIndices[surface]->swap(orderedIndices);
+    surfaces.push_back(surface);
+  }
+}
+
+///// stopTriangleOrders //////////////////////////////////////////////////////
+void DensityGrid::stopTriangleOrders()
+/// Waits for all background reorderings to finish and discards their results.
+{
+  for(vector<OrderWorker*>::iterator it = orderWorkers.begin(); it != orderWorkers.end(); it++)
+  {
+    (*it)->wait();
+    delete *it;
+  }
+  orderWorkers.clear();
+}
+
 ///// getArrayIndex ///////////////////////////////////////////////////////////
 unsigned int DensityGrid::getArrayIndex(const unsigned int x, const unsigned int y, const unsigned int z) const
 /// Determines the index into the array of density values.
@@ -913,6 +1991,31 @@ unsigned int DensityGrid::getArrayIndex(const unsigned int x, const unsigned int
   return x*numPoints.y()*numPoints.z() + y*numPoints.z() + z;
 }
 
+///// levelValues /////////////////////////////////////////////////////////////
+const vector<double>& DensityGrid::levelValues(const unsigned int level) const
+/// Returns the density values of the given resolution level.
+{
+  assert(level < numLevels());
+
+  if(level == 0)
+    return densityValues;
+  return pyramidValues[level - 1];
+}
+
+///// stopPyramid /////////////////////////////////////////////////////////////
+void DensityGrid::stopPyramid()
+/// Stops the calculation of the downsampled levels and waits for it to finish.
+/// This is needed before the density values are changed.
+{
+  if(pyramidThread == 0)
+    return;
+
+  pyramidThread->stop();
+  pyramidThread->wait();
+  delete pyramidThread;
+  pyramidThread = 0;
+}
+
 ///// mapColor ////////////////////////////////////////////////////////////////
 QColor DensityGrid::mapColor(const double value) const
 /// Returns the color from the active color map corresponding to the desired
@@ -959,6 +2062,8 @@ QColor DensityGrid::mapColor(const double value) const
 ///// Static Variables                                                    /////
 ///////////////////////////////////////////////////////////////////////////////
 
+const unsigned int DensityGrid::parallelPoints = 1 << 18;
+
 const unsigned int DensityGrid::edgeTable[256] = 
 {
 	0x0  , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
@@ -995,6 +2100,26 @@ const unsigned int DensityGrid::edgeTable[256] =
 	0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x0 
 };
 
+const unsigned int DensityGrid::triangleCountTable[256] =
+{
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 2,
+  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+  2, 3, 3, 2, 3, 4, 4, 3, 3, 4, 4, 3, 4, 5, 5, 2,
+  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
+  2, 3, 3, 4, 3, 4, 2, 3, 3, 4, 4, 5, 4, 5, 3, 2,
+  3, 4, 4, 3, 4, 5, 3, 2, 4, 5, 5, 4, 5, 2, 4, 1,
+  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+  2, 3, 3, 4, 3, 4, 4, 5, 3, 2, 4, 3, 4, 3, 5, 2,
+  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
+  3, 4, 4, 3, 4, 5, 5, 4, 4, 3, 5, 2, 5, 4, 2, 1,
+  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 2, 3, 3, 2,
+  3, 4, 4, 5, 4, 5, 5, 2, 4, 3, 5, 4, 3, 2, 4, 1,
+  3, 4, 4, 5, 4, 5, 3, 4, 4, 5, 5, 2, 3, 4, 2, 1,
+  2, 3, 3, 2, 3, 4, 2, 1, 3, 2, 4, 1, 2, 1, 1, 0
+};
+
 const int DensityGrid::triTable[256][16] =
 {
   {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
@@ -0,0 +1,157 @@
+/***************************************************************************
+                  densitypyramidthread.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+///// Comments ////////////////////////////////////////////////////////////////
+/*!
+  \class DensityPyramidThread
+  \brief This class calculates a pyramid of downsampled density grids.
+
+  Each level halves the number of points of the previous level in every
+  direction. Point i of a level lies on point 2i of the previous one and is
+  the weighted average of points 2i-1, 2i and 2i+1 with weights 1/4, 1/2 and
+  1/4 (a tent filter, applied to each direction in turn). Missing neighbours
+  at the edges are replaced by the edge point itself. As a result all levels
+  share the origin of the full grid. Levels are added until a direction
+  would be left with less than 2 points. The
+  calculated levels are stored in vectors owned by the caller, which should
+  only access them after the thread has finished. The full resolution values
+  should not be deallocated while the thread is running.
+*/
+/// \file
+/// Contains the implementation of the class DensityPyramidThread.
+
+///// Header files ////////////////////////////////////////////////////////////
+
+// C++ header files
+#include <cassert>
+
+// Xbrabo header files
+#include "densitypyramidthread.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///// Public Member Functions                                             /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// Constructor /////////////////////////////////////////////////////////////
+DensityPyramidThread::DensityPyramidThread(const double* densityValues, const Point3D<unsigned int>& points,
+                                           std::vector< std::vector<double> >* levelValues,
+                                           std::vector<Point3D<unsigned int> >* levelPoints) : QThread(),
+  fullValues(densityValues),
+  fullPoints(points),
+  values(levelValues),
+  numPoints(levelPoints),
+  stopRequested(false)
+/// The default constructor.
+/// \param[in] densityValues : the full resolution density values.
+/// \param[in] points : the number of full resolution points in each direction.
+/// \param[out] levelValues : receives the density values of each level, starting with the first downsampled one.
+/// \param[out] levelPoints : receives the number of points in each direction for each level.
+{
+  assert(densityValues != 0);
+  assert(levelValues != 0);
+  assert(levelPoints != 0);
+}
+
+///// Destructor //////////////////////////////////////////////////////////////
+DensityPyramidThread::~DensityPyramidThread()
+/// The default destructor.
+{
+
+}
+
+///// stop ////////////////////////////////////////////////////////////////////
+void DensityPyramidThread::stop()
+/// Requests the thread to stop. The levels calculated up to then are kept.
+{
+  QMutexLocker locker(&stopMutex);
+  stopRequested = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+///// Private Member Functions                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// run /////////////////////////////////////////////////////////////////////
+void DensityPyramidThread::run()
+/// Does the actual calculation. It is run with a call to start().
+{
+  values->clear();
+  numPoints->clear();
+  // reserve all levels beforehand as the previous level is used as the source of the next one
+  unsigned int numLevels = 0;
+  for(Point3D<unsigned int> points = fullPoints; points.x() > 2 && points.y() > 2 && points.z() > 2; numLevels++)
+    points.setValues((points.x() + 1)/2, (points.y() + 1)/2, (points.z() + 1)/2);
+  values->reserve(numLevels);
+  numPoints->reserve(numLevels);
+
+  const double* source = fullValues;
+  Point3D<unsigned int> sourcePoints = fullPoints;
+  while(!isStopRequested() && sourcePoints.x() > 2 && sourcePoints.y() > 2 && sourcePoints.z() > 2)
+  {
+    const Point3D<unsigned int> targetPoints((sourcePoints.x() + 1)/2, (sourcePoints.y() + 1)/2, (sourcePoints.z() + 1)/2);
+    values->push_back(std::vector<double>());
+    numPoints->push_back(targetPoints);
+    downsample(source, sourcePoints, values->back(), targetPoints);
+    source = &(values->back()[0]);
+    sourcePoints = targetPoints;
+  }
+}
+
+///// isStopRequested /////////////////////////////////////////////////////////
+bool DensityPyramidThread::isStopRequested()
+/// Returns whether stop() has been called.
+{
+  QMutexLocker locker(&stopMutex);
+  return stopRequested;
+}
+
+///// downsample //////////////////////////////////////////////////////////////
+void DensityPyramidThread::downsample(const double* source, const Point3D<unsigned int>& sourcePoints, std::vector<double>& target, const Point3D<unsigned int>& targetPoints)
+/// Fills the target grid with the source grid filtered to half the resolution,
+/// one direction at a time (z, y and then x).
+{
+  std::vector<double> filteredZ(sourcePoints.x()*sourcePoints.y()*targetPoints.z());
+  halveAxis(source, sourcePoints.x()*sourcePoints.y(), sourcePoints.z(), 1, &filteredZ[0]);
+  std::vector<double> filteredYZ(sourcePoints.x()*targetPoints.y()*targetPoints.z());
+  halveAxis(&filteredZ[0], sourcePoints.x(), sourcePoints.y(), targetPoints.z(), &filteredYZ[0]);
+  target.resize(targetPoints.x()*targetPoints.y()*targetPoints.z());
+  halveAxis(&filteredYZ[0], 1, sourcePoints.x(), targetPoints.y()*targetPoints.z(), &target[0]);
+}
+
+///// halveAxis ///////////////////////////////////////////////////////////////
+void DensityPyramidThread::halveAxis(const double* source, const unsigned int outer, const unsigned int count, const unsigned int inner, double* target)
+/// Filters the direction of a grid with \a count points to (count + 1)/2
+/// points. The grid consists of \a outer blocks of \a count rows of \a inner
+/// values. Point i of the target lies on point 2i of the source.
+{
+  const unsigned int targetCount = (count + 1)/2;
+  for(unsigned int o = 0; o < outer; o++)
+  {
+    const double* sourceBlock = source + o*count*inner;
+    double* targetBlock = target + o*targetCount*inner;
+    for(unsigned int i = 0; i < targetCount; i++)
+    {
+      // replace the missing neighbours at the edges by the point itself
+      const double* center = sourceBlock + 2*i*inner;
+      const double* previous = i == 0 ? center : center - inner;
+      const double* next = 2*i + 1 < count ? center + inner : center;
+      double* result = targetBlock + i*inner;
+      for(unsigned int j = 0; j < inner; j++)
+        result[j] = 0.25*previous[j] + 0.5*center[j] + 0.25*next[j];
+    }
+  }
+}
+
@@ -80,10 +80,15 @@ GLMoleculeView::GLMoleculeView(AtomSet* atomset, QWidget* parent, const char* na
   numVolumeObjects(0),
   textureID2D(NULL),
   textureID3D(0),
+  volumeLevel(0),
   sliceObject(0) 
 /// The default constructor.
 {
   densityGrid = new DensityGrid();
+  densityGrid->setSurfaceEngine(surfaceParameters.engine);
+  densityGrid->setOrderReceiver(this);
+  resolutionTimer = new QTimer(this);
+  connect(resolutionTimer, SIGNAL(timeout()), this, SLOT(updateSurfaceResolution()));
 }
 
 ///// destructor //////////////////////////////////////////////////////////////
@@ -208,6 +213,8 @@ bool GLMoleculeView::alterInternal()
 /// If one atom is selected, the absolute coordinates can be changed
 /// If multiple atoms are selected, only relative changes can be given
 {
+  const std::vector<unsigned int> definition(selectionList.begin(), selectionList.end());
+  std::vector<double> value;
   switch(getSelectionType())
   {
     case SELECTION_BOND:
@@ -216,9 +223,8 @@ bool GLMoleculeView::alterInternal()
       unsigned int atom1 = *it++;
       unsigned int atom2 = *it;
       ///// get the current bond length
-      // <double> version
-      Vector3D<double> bond(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2), atoms->x(atom1), atoms->y(atom1), atoms->z(atom1));
-      double bondLength = bond.length();
+      atoms->bondValues(definition, value);
+      const double bondLength = value[0];
 
       bool ok;
       double newLength = QInputDialog::getDouble("Xbrabo", tr("Change the distance between atoms ")+QString::number(atom1+1)+" and "+QString::number(atom2+1), bondLength, -1000.0, 1000.0, 4, &ok, this);
@@ -236,9 +242,8 @@ bool GLMoleculeView::alterInternal()
       unsigned int atom2 = *it++;
       unsigned int atom3 = *it;
       ///// get the current angle
-      Vector3D<double> bond1(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2), atoms->x(atom1), atoms->y(atom1), atoms->z(atom1));
-      Vector3D<double> bond2(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2), atoms->x(atom3), atoms->y(atom3), atoms->z(atom3));
-      double angle = bond1.angle(bond2);
+      atoms->angleValues(definition, value);
+      const double angle = value[0];
       bool ok;
       double newAngle = QInputDialog::getDouble("Xbrabo", tr("Change the angle ")+QString::number(atom1+1)+"-"+QString::number(atom2+1)+"-"+QString::number(atom3+1), angle, -1000.0, 1000.0, 2, &ok, this);
       if(ok && fabs(newAngle - angle) > 0.001)
@@ -256,10 +261,8 @@ bool GLMoleculeView::alterInternal()
       unsigned int atom3 = *it++;
       unsigned int atom4 = *it;
       ///// get the current torsion angle
-      Vector3D<double> bond1(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2), atoms->x(atom1), atoms->y(atom1), atoms->z(atom1));
-      Vector3D<double> centralbond(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2), atoms->x(atom3), atoms->y(atom3), atoms->z(atom3));
-      Vector3D<double> bond2(atoms->x(atom3), atoms->y(atom3), atoms->z(atom3), atoms->x(atom4), atoms->y(atom4), atoms->z(atom4));
-      double torsion = bond1.torsion(bond2, centralbond);
+      atoms->torsionValues(definition, value);
+      const double torsion = value[0];
       bool ok;
       double newTorsion = QInputDialog::getDouble("Xbrabo", tr("Change the torsion angle ")+QString::number(atom1+1)+"-"+QString::number(atom2+1)+"-"+QString::number(atom3+1)+"-"+QString::number(atom4+1), torsion, -1000.0, 1000.0, 2, &ok, this);
       if(ok && fabs(newTorsion - torsion) > 0.001)
@@ -283,16 +286,8 @@ bool GLMoleculeView::deleteSelectedAtoms()
   if(selectionList.empty())
     return false;
 
-  ///// delete the atoms from largest to smallest index
-  // make a copy
-  std::vector<unsigned int> sortedList;
-  sortedList.reserve(selectionList.size());
-  sortedList.assign(selectionList.begin(), selectionList.end());
-  // sort it from largest to smallest
-  std::sort(sortedList.begin(), sortedList.end(), std::greater<unsigned int>());
-  // delete the atoms
-  for(unsigned int i = 0; i < sortedList.size(); i++)
-    atoms->removeAtom(sortedList[i]);
+  ///// delete the atoms in one pass
+  atoms->removeAtoms(std::vector<unsigned int>(selectionList.begin(), selectionList.end()));
   // clear the selection
   unselectAll();
   if(newAtomDialog != 0)
@@ -430,6 +425,13 @@ void GLMoleculeView::setParameters(GLTextureParameters params)
   textureParameters = params;
 }
 
+///// setParameters ///////////////////////////////////////////////////////////
+void GLMoleculeView::setParameters(GLSurfaceParameters params)
+/// Updates the isosurface parameters.
+{
+  surfaceParameters = params;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// Public Slots                                                        /////
@@ -478,6 +480,22 @@ void GLMoleculeView::unselectAllCommand()
   view->getCommandHistory()->addCommand(new CommandSelectNone(view, tr("Deselect All Atoms")));
 }
 
+///// selectNeighboursCommand //////////////////////////////////////////////////
+void GLMoleculeView::selectNeighboursCommand()
+/// Asks for a distance and creates a Command to add all atoms within this 
+/// distance of the selected atoms to the selection. This Command will call 
+/// selectNeighbours.
+{
+  if(selectedAtoms() == 0)
+    return;
+  bool ok;
+  const double radius = QInputDialog::getDouble("Xbrabo", tr("Select all atoms within a distance (in Angstrom) of the selected atoms"), 3.0, 0.0, 1000.0, 2, &ok, this);
+  if(!ok)
+    return;
+  XbraboView* view = (XbraboView*)(parentWidget()->parentWidget());
+  view->getCommandHistory()->addCommand(new CommandSelectNeighbours(view, tr("Select Neighbouring Atoms"), radius));
+}
+
 ///// centerViewCommand ///////////////////////////////////////////////////////
 void GLMoleculeView::centerViewCommand()
 /// Creates a Command to center the view. This Command will call centerView.
@@ -517,7 +535,7 @@ void GLMoleculeView::showDensity()
 {
   if(densityDialog == NULL)
   {
-    densityDialog = new DensityBase(densityGrid, this);
+    densityDialog = new DensityBase(densityGrid, atoms, &selectionList, this);
     connect(densityDialog, SIGNAL(newSurface(const unsigned int)), this, SLOT(addGLSurface(const unsigned int)));
     connect(densityDialog, SIGNAL(updatedSurface(const unsigned int)), this, SLOT(updateGLSurface(const unsigned int)));
     connect(densityDialog, SIGNAL(deletedSurface(const unsigned int)), this, SLOT(deleteGLSurface(const unsigned int)));
@@ -525,6 +543,7 @@ void GLMoleculeView::showDensity()
     connect(densityDialog, SIGNAL(updatedSlice()), this, SLOT(updateSlice()));
     connect(densityDialog, SIGNAL(redrawScene()), this, SLOT(updateScene()));
   }
+  updateSurfaceResolution();
   densityDialog->show();
   if(!densityGrid->densityPresent())
     densityDialog->loadDensityA();
@@ -557,6 +576,26 @@ void GLMoleculeView::initializeGL()
   GLSimpleMoleculeView::initializeGL();
 }*/
 
+///// customEvent /////////////////////////////////////////////////////////////
+void GLMoleculeView::customEvent(QCustomEvent* e)
+/// Handles custom events originating from the threads reordering the triangles
+/// of the surfaces of densityGrid. The reordered surfaces are uploaded again.
+{
+  if(e->type() != 1003)
+    return;
+
+  std::vector<unsigned int> surfaces;
+  densityGrid->updateTriangleOrder(surfaces);
+  if(densityDialog == NULL)
+    return;
+  densityDialog->updateMissRatio();
+  if(surfaces.empty())
+    return;
+  for(std::vector<unsigned int>::iterator it = surfaces.begin(); it != surfaces.end(); it++)
+    updateGLSurface(*it);
+  updateGL();
+}
+
 ///// boundingSphereRadius ////////////////////////////////////////////////////
 float GLMoleculeView::boundingSphereRadius()
 /// Calculates the radius of the bounding sphere. If atoms are present, the
@@ -776,6 +815,20 @@ void GLMoleculeView::updateGLSettings()
 {
   GLSimpleMoleculeView::updateGLSettings(); // update the settings of the base class
 
+  // possibly another surface engine
+  if(densityGrid->surfaceEngine() != surfaceParameters.engine)
+  {
+    densityGrid->setSurfaceEngine(surfaceParameters.engine);
+    if(densityDialog != NULL && densityDialog->visualizationType() == DensityBase::ISOSURFACES)
+    {
+      for(unsigned int i = 0; i < densityGrid->numSurfaces(); i++)
+      {
+        densityGrid->recalculateSurface(i);
+        updateGLSurface(i);
+      }
+    }
+  }
+
   // possibly new texture size and 2D/3D texturing switch
   if(densityDialog != NULL && densityDialog->visualizationType() == DensityBase::VOLUME)
     updateVolume();
@@ -840,6 +893,16 @@ void GLMoleculeView::changeSelectedICCommand(const int range)
   view->getCommandHistory()->addCommand(new CommandChangeIC(view, "Change Internal Coordinate", range));
 }
 
+///// zoomChanged /////////////////////////////////////////////////////////////
+void GLMoleculeView::zoomChanged()
+/// Schedules updating the resolution of the isosurfaces. Overridden from
+/// GLView::zoomChanged, so it also happens for undoing and redoing a zoom,
+/// fitting the scene and resizing the window. The surfaces are only
+/// recalculated once zooming has stopped for resolutionWait msec.
+{
+  resolutionTimer->start(resolutionWait, true);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// Private Slots                                                       /////
@@ -986,6 +1049,7 @@ void GLMoleculeView::updateScene()
 /// Does the necessary updating when something changed in DensityBase (like e.g.
 /// the visualization type.
 {
+  updateSurfaceResolution(); // surfaces made visible may have been calculated at another zoom level
   makeCurrent();
   reorderShapes();
 
@@ -1178,6 +1242,49 @@ void GLMoleculeView::updateSlice()
 }
 
 
+///// updateSurfaceResolution /////////////////////////////////////////////////
+void GLMoleculeView::updateSurfaceResolution()
+/// Sets the number of density grid points needed for isosurfaces to the
+/// number of pixels covered by the largest dimension of the grid. This way a
+/// downsampled grid is used when the view is zoomed out. Visible surfaces 
+/// calculated at another resolution level are recalculated.
+{
+  if(!densityGrid->densityPresent())
+    return;
+
+  const Point3D<float> delta = densityGrid->getDelta();
+  const Point3D<unsigned int> numPoints = densityGrid->getNumPoints();
+  float maxExtent = delta.x()*(numPoints.x() - 1);
+  maxExtent = delta.y()*(numPoints.y() - 1) > maxExtent ? delta.y()*(numPoints.y() - 1) : maxExtent;
+  maxExtent = delta.z()*(numPoints.z() - 1) > maxExtent ? delta.z()*(numPoints.z() - 1) : maxExtent;
+
+  // the height of the scene visible at the distance of the rotation center
+  float visibleHeight;
+  if(baseParameters.perspectiveProjection)
+    visibleHeight = 2.0f*zPos*tan(fieldOfView/2.0f*Point3D<float>::DEGTORAD); // the vertical field of view of gluPerspective
+  else
+    visibleHeight = 2.0f*maxRadius*zPos; // the vertical extent of glOrtho in GLView::setPerspective
+  if(visibleHeight <= 0.0f)
+    return;
+
+  const unsigned int pixels = static_cast<unsigned int>(maxExtent/visibleHeight*height());
+  densityGrid->setSurfaceResolution(pixels > 2 ? pixels : 2);
+
+  if(densityDialog == NULL)
+    return;
+  bool refreshed = false;
+  for(unsigned int i = 0; i < densityGrid->numSurfaces(); i++)
+  {
+    if(densityDialog->surfaceVisible(i) && densityGrid->refreshSurface(i))
+    {
+      updateGLSurface(i);
+      refreshed = true;
+    }
+  }
+  if(refreshed)
+    updateGL();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Private Member Functions                                            /////
 ///////////////////////////////////////////////////////////////////////////////
@@ -1241,13 +1348,7 @@ bool GLMoleculeView::translateSelection(const int xRange, const int yRange, cons
   const double dz = z - atoms->z(*it);
 
   // apply this translation vector to all selected atoms
-  while(it != selectionList.end())
-  {
-    atoms->setX(*it, atoms->x(*it) + dx);
-    atoms->setY(*it, atoms->y(*it) + dy);
-    atoms->setZ(*it, atoms->z(*it) + dz);
-    it++;
-  }
+  atoms->translateAtoms(std::vector<unsigned int>(selectionList.begin(), selectionList.end()), dx, dy, dz);
 
   updateAtomSet();
   setModified();
@@ -1299,19 +1400,21 @@ bool GLMoleculeView::rotateSelection(const double angleX, const double angleY, c
   centerOfMass.setValues(centerOfMass.x()/selectionList.size(), centerOfMass.y()/selectionList.size(), centerOfMass.z()/selectionList.size());
   //qDebug("centerOfMass = %f, %f, %f", centerOfMass.x(), centerOfMass.y(), centerOfMass.z());
 
-  ///// rotate the atoms around this center
-  it = selectionList.begin();
-  while(it != selectionList.end())
+  ///// determine the rotation matrix from the rotated unit vectors (its columns)
+  double rotation[9];
+  for(unsigned int column = 0; column < 3; column++)
   {
-    Vector3D<double> v(centerOfMass, atoms->coordinates(*it));
+    Vector3D<double> v(column == 0 ? 1.0 : 0.0, column == 1 ? 1.0 : 0.0, column == 2 ? 1.0 : 0.0);
     v.rotate(backAxis, backAngle);
     v.rotate(axis, angle);
     v.rotate(backAxis, -backAngle);
-    atoms->setX(*it, centerOfMass.x() + v.x());
-    atoms->setY(*it, centerOfMass.y() + v.y());
-    atoms->setZ(*it, centerOfMass.z() + v.z());
-    it++;
-  }
+    rotation[column] = v.x();
+    rotation[3 + column] = v.y();
+    rotation[6 + column] = v.z();
+  }
+
+  ///// rotate the atoms around this center
+  atoms->transformAtoms(std::vector<unsigned int>(selectionList.begin(), selectionList.end()), rotation, centerOfMass);
   ///// TEMP HACK: if all atoms are selected, also rotate the point charges
   if(selectionList.size() == atoms->count())
   {
@@ -1862,10 +1965,11 @@ void GLMoleculeView::drawVolume3D()
 {
   assert(GLEE_VERSION_1_2);
 
-  // data regarding the density grid
-  const Point3D<float> origin = densityGrid->getOrigin();
-  const Point3D<float> delta = densityGrid->getDelta();
-  const Point3D<unsigned int> numPoints = densityGrid->getNumPoints();
+  // data regarding the level of the density grid stored in the texture
+  const unsigned int level = volumeLevel < densityGrid->numLevels() ? volumeLevel : 0;
+  const Point3D<float> origin = densityGrid->getOrigin(level);
+  const Point3D<float> delta = densityGrid->getDelta(level);
+  const Point3D<unsigned int> numPoints = densityGrid->getNumPoints(level);
   const Point3D<float> extent(delta.x()*(numPoints.x() - 1),
                               delta.y()*(numPoints.y() - 1),
                               delta.z()*(numPoints.z() - 1));
@@ -2367,8 +2471,9 @@ void GLMoleculeView::updateVolume3D()
 {
   qDebug("calling updateVolume3D");
 
-  // data regarding the density grid
-  const Point3D<unsigned int> numPoints = densityGrid->getNumPoints();
+  // use the finest level of the density grid fitting the maximum texture size
+  volumeLevel = densityGrid->levelForSize(textureParameters.maximumSize);
+  const Point3D<unsigned int> numPoints = densityGrid->getNumPoints(volumeLevel);
 
   // visualization settings from DensityBase
   const QColor positiveColor = densityDialog->ColorButtonVolumePos->color();
@@ -2380,7 +2485,8 @@ void GLMoleculeView::updateVolume3D()
 
   const Point3D<unsigned int> textureSize3D(textureSize(numPoints.x()), textureSize(numPoints.y()), textureSize(numPoints.z()));
   const unsigned int planeXZ = 4 * textureSize3D.x() * textureSize3D.z(); // size of the data needed to store an XZ plane
-  // the X and Z dimensions are correctly scaled by the getSlice function, but the Y dimension isn't
+  // the X and Z dimensions are correctly scaled by the getSlice function, but the Y dimension isn't.
+  // this only happens when the downsampled levels are not available yet
   unsigned int incValue = 1; // by default don't skip XZ-planes while reading values
   unsigned int numStacksY = numPoints.y(); // the actual number of XZ-planes to read
   while(numStacksY > textureSize3D.y())
@@ -2401,7 +2507,7 @@ void GLMoleculeView::updateVolume3D()
   QImage glImage;
   for(unsigned int y = (textureSize3D.y() - numStacksY)/2; y < (textureSize3D.y() - numStacksY)/2 + numStacksY; ++y)
   {
-    glImage = glSlice(densityGrid->getSlice(DensityGrid::PLANE_ZX, (y - (textureSize3D.y() - numStacksY)/2)*incValue, positiveColor, negativeColor, maxPlotValue, minPlotValue));
+    glImage = glSlice(densityGrid->getSlice(DensityGrid::PLANE_ZX, (y - (textureSize3D.y() - numStacksY)/2)*incValue, positiveColor, negativeColor, maxPlotValue, minPlotValue, DensityGrid::MAP_LAST, volumeLevel));
     memcpy((void*)(gridData + y * planeXZ), glImage.bits(), planeXZ);
   }
   // store again transparent slices for the rest
@@ -2575,4 +2681,6 @@ void GLMoleculeView::clearVolumeTextures()
 ///////////////////////////////////////////////////////////////////////////////
 
 bool GLMoleculeView::manipulateSelection = false;
+const int GLMoleculeView::resolutionWait = 250;
 GLMoleculeView::GLTextureParameters GLMoleculeView::textureParameters = {128, false};
+GLMoleculeView::GLSurfaceParameters GLMoleculeView::surfaceParameters = {DensityGrid::ENGINE_FLYING_EDGES};
@@ -21,7 +21,8 @@
   \brief This class shows an orbital in 3D using OpenGL.
 
   It uses a thread to do the necessary computations and is based on GLView for
-  basic OpenGL functionality.
+  basic OpenGL functionality. Orbitals calculated on a grid are shown as the
+  isosurfaces of both phases, which are extracted with DensityGrid.
 
 */
 /// \file
@@ -33,6 +34,9 @@
 #include <cfloat>
 #include <cmath>
 
+// GLee header files
+#include "GLee.h" // must be included before gl.h (included by qgl.h)
+
 // Qt header files
 #include <qapplication.h>
 #include <qcolor.h>
@@ -44,6 +48,7 @@
 #include <qtimer.h>
 
 // Xbrabo header files
+#include "densitygrid.h"
 #include "glorbitalview.h"
 #include <point3d.h>
 #include <quaternion.h>
@@ -57,17 +62,20 @@ GLOrbitalView::GLOrbitalView(QWidget* parent, const char* name) : GLView(parent,
   colorPositive(QColor(0, 0, 255)),
   colorNegative(QColor(255, 0, 0)),
   maximumRadius(1.0f),
-  scaleFactor(1.0f)
+  scaleFactor(1.0f),
+  surfaceLists(0)
 /// The default constructor.
 {
-
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+    numUploaded[phase] = 0;
 }
 
 ///// destructor //////////////////////////////////////////////////////////////
 GLOrbitalView::~GLOrbitalView()
 /// The default destructor.
 {
-
+  clearSurfaces();
+  clearPoints();
 }
 
 ///// updateColors ////////////////////////////////////////////////////////////
@@ -78,18 +86,27 @@ void GLOrbitalView::updateColors(QColor pos, QColor neg)
   colorNegative = neg;
 }
 
-///// getCoordinates //////////////////////////////////////////////////////////
-std::vector<Point3D<float> >* GLOrbitalView::getCoordinates()
-/// Returns a pointer to the coords vector.
+///// getPoints ///////////////////////////////////////////////////////////////
+PointBuffer* GLOrbitalView::getPoints()
+/// Returns a pointer to the buffer of points. Calculating threads can append
+/// to it while the scene is drawn. It should only be cleared with clearPoints.
 {
-  return &coords;
+  return &points;
 }
 
-///// getMutex ////////////////////////////////////////////////////////////////
-QMutex* GLOrbitalView::getMutex()
-/// Returns a pointer to the mutex used for accessing the coords vector.
+///// clearPoints /////////////////////////////////////////////////////////////
+void GLOrbitalView::clearPoints()
+/// Removes all points. No thread may be appending to the buffer.
 {
-  return &mutex;
+  points.clear();
+  makeCurrent();
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+  {
+    if(!vertexBuffers[phase].empty())
+      glDeleteBuffers(vertexBuffers[phase].size(), &vertexBuffers[phase][0]);
+    vertexBuffers[phase].clear();
+    numUploaded[phase] = 0;
+  }
 }
 
 ///// setMaximumRadius ////////////////////////////////////////////////////////
@@ -105,6 +122,52 @@ void GLOrbitalView::setMaximumRadius(const double radius)
   updateGL();
 }
 
+///// setSurfaces ///////////////////////////////////////////////////////////
+void GLOrbitalView::setSurfaces(const std::vector<double>* values, const Point3D<unsigned int>& points, const Point3D<float>& delta, const Point3D<float>& origin, const double level)
+/// Calculates the isosurfaces at +level and -level of a grid of values of psi
+/// and stores them in display lists. They are drawn in the colors of the 
+/// corresponding phases. The grid itself is not kept.
+{
+  clearSurfaces();
+  DensityGrid grid;
+  grid.setParameters(values, points, delta, origin, false); // the grid is discarded before any levels could be used
+  grid.addSurface(level);
+  grid.addSurface(-level);
+
+  makeCurrent();
+  surfaceLists = glGenLists(2);
+  Point3D<float> point1, point2, point3, normal1, normal2, normal3;
+  for(unsigned int i = 0; i < 2; i++)
+  {
+    glNewList(surfaceLists + i, GL_COMPILE);
+      glBegin(GL_TRIANGLES);
+        for(unsigned int j = 0; j < grid.numTriangles(i); j++)
+        {
+          grid.getTriangle(i, j, point1, point2, point3, normal1, normal2, normal3);
+          glNormal3f(normal1.x(), normal1.y(), normal1.z());
+          glVertex3f(point1.x(), point1.y(), point1.z());
+          glNormal3f(normal2.x(), normal2.y(), normal2.z());
+          glVertex3f(point2.x(), point2.y(), point2.z());
+          glNormal3f(normal3.x(), normal3.y(), normal3.z());
+          glVertex3f(point3.x(), point3.y(), point3.z());
+        }
+      glEnd();
+    glEndList();
+  }
+}
+
+///// clearSurfaces ///////////////////////////////////////////////////////////
+void GLOrbitalView::clearSurfaces()
+/// Removes the isosurfaces.
+{
+  if(surfaceLists == 0)
+    return;
+
+  makeCurrent();
+  glDeleteLists(surfaceLists, 2);
+  surfaceLists = 0;
+}
+
 /*//// updateValues ////////////////////////////////////////////////////////////
 void GLOrbitalView::updateValues(int atom, int n, int l, int m, QColor pos, QColor neg, int type, int resolution, float probability, int dots)
 {
@@ -204,25 +267,25 @@ void GLOrbitalView::drawScene()
   // scale if the boundaries exceed 100.0f (the far z-value)
   glScalef(scaleFactor, scaleFactor, scaleFactor);
 
+  ///// draw the isosurfaces
+  if(surfaceLists != 0)
+  {
+    glEnable(GL_LIGHTING);
+    qglColor(colorPositive);
+    glCallList(surfaceLists);
+    qglColor(colorNegative);
+    glCallList(surfaceLists + 1);
+  }
+
   //*
   ///// draw the precalculated isoprobability points
   glDisable(GL_LIGHTING);
-
-  glBegin(GL_POINTS);
-    mutex.lock();
-    std::vector<Point3D<float> >::iterator it = coords.begin();
-    while(it != coords.end())
-    {
-      if(it->id() == 1)
-        qglColor(colorPositive);
-      else
-        qglColor(colorNegative);
-      glVertex3f(it->x(), it->y(), it->z());
-      it++;
-    }
-    mutex.unlock();
-  glEnd();
-  // no use in making a display list as the coordinates might be updated at any time
+  glEnableClientState(GL_VERTEX_ARRAY);
+  qglColor(colorPositive);
+  drawPoints(PointBuffer::PHASE_POSITIVE);
+  qglColor(colorNegative);
+  drawPoints(PointBuffer::PHASE_NEGATIVE);
+  glDisableClientState(GL_VERTEX_ARRAY);
 
   /*// lines
   glBegin(GL_LINE_LOOP);
@@ -341,3 +404,49 @@ float GLOrbitalView::boundingSphereRadius()
   return static_cast<float>(maximumRadius*scaleFactor);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///// Private Member Functions                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// drawPoints //////////////////////////////////////////////////////////////
+void GLOrbitalView::drawPoints(const unsigned int phase)
+/// Draws the points of a phase that have been published up to now, one chunk
+/// at a time with vertex arrays. If vertex buffer objects are supported, newly
+/// published points are copied to them, so every point is uploaded only once.
+{
+  const unsigned int numPoints = points.size(phase);
+  const bool useBuffers = GLEE_VERSION_1_5;
+  for(unsigned int i = 0; i*PointBuffer::chunkSize < numPoints; i++)
+  {
+    const unsigned int first = i*PointBuffer::chunkSize;
+    const unsigned int count = numPoints - first < PointBuffer::chunkSize ? numPoints - first : PointBuffer::chunkSize;
+    if(useBuffers)
+    {
+      if(i == vertexBuffers[phase].size())
+      {
+        // allocate a buffer for a new chunk
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, 3*PointBuffer::chunkSize*sizeof(float), 0, GL_STATIC_DRAW);
+        vertexBuffers[phase].push_back(buffer);
+      }
+      else
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[phase][i]);
+      if(numUploaded[phase] < first + count)
+      {
+        // the previous chunks are complete, so only this one can contain new points
+        const unsigned int start = numUploaded[phase] - first;
+        glBufferSubData(GL_ARRAY_BUFFER, 3*start*sizeof(float), 3*(count - start)*sizeof(float), points.chunk(phase, i) + 3*start);
+        numUploaded[phase] = first + count;
+      }
+      glVertexPointer(3, GL_FLOAT, 0, 0);
+    }
+    else
+      glVertexPointer(3, GL_FLOAT, 0, points.chunk(phase, i));
+    glDrawArrays(GL_POINTS, 0, count);
+  }
+  if(useBuffers)
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
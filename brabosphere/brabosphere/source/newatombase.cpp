@@ -35,6 +35,7 @@
 #include <qbuttongroup.h>
 #include <qlabel.h>
 #include <qlineedit.h>
+#include <qmessagebox.h>
 #include <qpushbutton.h>
 #include <qradiobutton.h>
 #include <qspinbox.h>
@@ -166,6 +167,7 @@ void NewAtomBase::addAtomCommand()
 {
   XbraboView* view = (XbraboView*)(parentWidget()->parentWidget()->parentWidget()); // as ugly as it can get... NewAtomBase(GLMoleculeView(Splitter(XbraboView)))
   view->getCommandHistory()->addCommand(new CommandAddAtoms(view, "Add Atoms", this));  // calls addAtom
+  checkContacts(atoms->count() - 1);
 }
 
 ///// updateAtomLimits ////////////////////////////////////////////////////////
@@ -300,3 +302,34 @@ void NewAtomBase::checkAdd()
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///// Private Member Functions                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// checkContacts ///////////////////////////////////////////////////////////
+void NewAtomBase::checkContacts(const unsigned int atom)
+/// Warns when the given atom overlaps with other atoms, which usually means
+/// wrong coordinates or reference atoms were entered.
+{
+  if(atom >= atoms->count())
+    return;
+
+  // the atom itself is always among the nearest ones
+  const vector<unsigned int> nearest = atoms->nearestAtoms(Point3D<double>(atoms->x(atom), atoms->y(atom), atoms->z(atom)), 2);
+  for(vector<unsigned int>::const_iterator it = nearest.begin(); it != nearest.end(); it++)
+  {
+    if(*it == atom)
+      continue;
+    const double distance = atoms->bond(atom, *it);
+    if(distance < minimumDistance)
+      QMessageBox::warning(this, tr("Add atoms"), tr("The new atom %1 lies only %2 Angstrom from atom %3.").arg(atom + 1).arg(distance, 0, 'f', 3).arg(*it + 1));
+    return;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Static Variables                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+const double NewAtomBase::minimumDistance = 0.5;
+
@@ -0,0 +1,316 @@
+/***************************************************************************
+                       orbitalcache.cpp  -  description
+                             -------------------
+    begin                : Sun Oct 18 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+///// Comments ////////////////////////////////////////////////////////////////
+/*!
+  \class OrbitalCache
+  \brief This class keeps the results of orbital calculations for reuse.
+
+  A result is identified by a description containing all parameters of the
+  calculation, including the seed for the types that use random numbers. Results are kept in memory up to a total of
+  maximumMemory bytes, discarding the least recently used ones first.
+  Optionally they are also written to a directory on disk, each in a file named
+  after the 64-bit FNV-1a hash of its description. The description itself is
+  stored in the file as well, so a hash collision is detected when loading.
+  Files that cannot be read are ignored and recalculated.
+*/
+/// \file
+/// Contains the implementation of the class OrbitalCache.
+
+///// Header files ////////////////////////////////////////////////////////////
+
+// C++ header files
+#include <cassert>
+
+// Qt header files
+#include <qdatastream.h>
+#include <qdir.h>
+#include <qfile.h>
+
+// Xbrabo header files
+#include "orbitalcache.h"
+#include "orbitalthread.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///// Public Member Functions                                             /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// Constructor /////////////////////////////////////////////////////////////
+OrbitalCache::OrbitalCache() :
+  usedMemory(0)
+/// The default constructor. The disk store is disabled.
+{
+
+}
+
+///// Destructor //////////////////////////////////////////////////////////////
+OrbitalCache::~OrbitalCache()
+/// The default destructor.
+{
+
+}
+
+///// find ////////////////////////////////////////////////////////////////////
+const OrbitalCache::Entry* OrbitalCache::find(const Key& key)
+/// Returns the result stored for the key, or 0 if none is available. A result
+/// found on disk is added to the memory store. The returned pointer is valid
+/// until the next call to find, insert or clear.
+{
+  const QString description = describe(key);
+
+  // check the memory store
+  for(std::list<Item>::iterator it = items.begin(); it != items.end(); it++)
+  {
+    if(it->first == description)
+    {
+      items.splice(items.begin(), items, it); // it is now the most recently used
+      return &items.front().second;
+    }
+  }
+
+  // check the disk store
+  if(directory.isEmpty())
+    return 0;
+  items.push_front(Item(description, Entry()));
+  if(!load(description, items.front().second))
+  {
+    items.pop_front();
+    return 0;
+  }
+  usedMemory += memoryUsage(items.front().second);
+  evict();
+  return &items.front().second;
+}
+
+///// insert //////////////////////////////////////////////////////////////////
+void OrbitalCache::insert(const Key& key, const Entry& entry)
+/// Stores the result for the key in memory and, if enabled, on disk. An
+/// existing result for the key is replaced.
+{
+  assert(entry.gridValues.empty() || entry.gridValues.size() == entry.gridPoints.x()*entry.gridPoints.y()*entry.gridPoints.z());
+
+  const QString description = describe(key);
+  for(std::list<Item>::iterator it = items.begin(); it != items.end(); it++)
+  {
+    if(it->first == description)
+    {
+      usedMemory -= memoryUsage(it->second);
+      items.erase(it);
+      break;
+    }
+  }
+  items.push_front(Item(description, entry));
+  usedMemory += memoryUsage(entry);
+  evict();
+
+  if(!directory.isEmpty())
+    save(description, entry);
+}
+
+///// setDirectory ////////////////////////////////////////////////////////////
+void OrbitalCache::setDirectory(const QString& dir)
+/// Sets the directory of the disk store. It is created when needed. An empty
+/// name disables the disk store.
+{
+  directory = dir;
+}
+
+///// clear ///////////////////////////////////////////////////////////////////
+void OrbitalCache::clear()
+/// Removes all results from memory. The disk store is left untouched.
+{
+  items.clear();
+  usedMemory = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Private Member Functions                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// evict ///////////////////////////////////////////////////////////////////
+void OrbitalCache::evict()
+/// Removes the least recently used results until the memory limit is no longer
+/// exceeded. The most recently used result is always kept.
+{
+  while(usedMemory > maximumMemory && items.size() > 1)
+  {
+    usedMemory -= memoryUsage(items.back().second);
+    items.pop_back();
+  }
+}
+
+///// load ////////////////////////////////////////////////////////////////////
+bool OrbitalCache::load(const QString& description, Entry& entry)
+/// Reads the result with the given description from the disk store. Returns
+/// false if it is not present or could not be read.
+{
+  QFile file(fileName(description));
+  if(!file.exists() || !file.open(IO_ReadOnly))
+    return false;
+
+  QDataStream stream(&file);
+  Q_UINT32 magic, version;
+  stream >> magic >> version;
+  if(magic != magicNumber || version != fileVersion)
+  {
+    qDebug("OrbitalCache::load: %s has an unknown format", file.name().latin1());
+    return false;
+  }
+  QString storedDescription;
+  stream >> storedDescription;
+  if(storedDescription != description)
+    return false; // another result with the same hash
+
+  // the counts are checked against the size of the file before allocating
+  const unsigned int fileSize = file.size();
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+  {
+    Q_UINT32 numValues;
+    stream >> numValues;
+    if(stream.atEnd() || numValues > (fileSize - file.at())/sizeof(float))
+      return false;
+    entry.points[phase].resize(numValues);
+    for(std::vector<float>::iterator it = entry.points[phase].begin(); it != entry.points[phase].end(); it++)
+      stream >> *it;
+  }
+  Q_UINT32 numX, numY, numZ;
+  float deltaX, deltaY, deltaZ, originX, originY, originZ;
+  stream >> numX >> numY >> numZ >> deltaX >> deltaY >> deltaZ >> originX >> originY >> originZ;
+  entry.gridPoints = Point3D<unsigned int>(numX, numY, numZ);
+  entry.gridDelta = Point3D<float>(deltaX, deltaY, deltaZ);
+  entry.gridOrigin = Point3D<float>(originX, originY, originZ);
+  stream >> entry.gridLevel >> entry.radius;
+  Q_UINT32 numValues;
+  stream >> numValues;
+  if(numValues != 0 && numValues != numX*numY*numZ)
+    return false;
+  if(numValues > (fileSize - file.at())/sizeof(double))
+    return false;
+  entry.gridValues.resize(numValues);
+  for(std::vector<double>::iterator it = entry.gridValues.begin(); it != entry.gridValues.end(); it++)
+    stream >> *it;
+
+  if(file.status() != IO_Ok)
+  {
+    qDebug("OrbitalCache::load: error reading %s", file.name().latin1());
+    return false;
+  }
+  return true;
+}
+
+///// save ////////////////////////////////////////////////////////////////////
+void OrbitalCache::save(const QString& description, const Entry& entry)
+/// Writes the result with the given description to the disk store. The file is
+/// written under a temporary name first, so other viewers never read a partial
+/// result.
+{
+  // create the directory if needed
+  QDir dir(directory);
+  if(!dir.exists())
+  {
+    QDir parent(directory);
+    if(!parent.cdUp() || (!parent.exists() && !parent.mkdir(parent.absPath())) || !dir.mkdir(dir.absPath()))
+    {
+      qDebug("OrbitalCache::save: cannot create %s", directory.latin1());
+      return;
+    }
+  }
+
+  const QString name = fileName(description);
+  QFile file(name + ".tmp");
+  if(!file.open(IO_WriteOnly))
+  {
+    qDebug("OrbitalCache::save: cannot write %s", file.name().latin1());
+    return;
+  }
+  QDataStream stream(&file);
+  stream << magicNumber << fileVersion << description;
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+  {
+    stream << static_cast<Q_UINT32>(entry.points[phase].size());
+    for(std::vector<float>::const_iterator it = entry.points[phase].begin(); it != entry.points[phase].end(); it++)
+      stream << *it;
+  }
+  stream << static_cast<Q_UINT32>(entry.gridPoints.x()) << static_cast<Q_UINT32>(entry.gridPoints.y()) << static_cast<Q_UINT32>(entry.gridPoints.z());
+  stream << entry.gridDelta.x() << entry.gridDelta.y() << entry.gridDelta.z();
+  stream << entry.gridOrigin.x() << entry.gridOrigin.y() << entry.gridOrigin.z();
+  stream << entry.gridLevel << entry.radius;
+  stream << static_cast<Q_UINT32>(entry.gridValues.size());
+  for(std::vector<double>::const_iterator it = entry.gridValues.begin(); it != entry.gridValues.end(); it++)
+    stream << *it;
+  file.close();
+
+  if(file.status() != IO_Ok)
+  {
+    qDebug("OrbitalCache::save: error writing %s", file.name().latin1());
+    file.remove();
+    return;
+  }
+  dir.remove(name);
+  if(!dir.rename(file.name(), name))
+    file.remove();
+}
+
+///// fileName ////////////////////////////////////////////////////////////////
+QString OrbitalCache::fileName(const QString& description) const
+/// Returns the name of the file of the disk store for a description.
+{
+  // 64-bit FNV-1a hash
+  Q_UINT64 hash = 14695981039346656037ULL;
+  const QCString bytes = description.utf8();
+  for(unsigned int i = 0; i < bytes.length(); i++)
+  {
+    hash ^= static_cast<unsigned char>(bytes[i]);
+    hash *= 1099511628211ULL;
+  }
+  // QString::number only handles 32-bit values on all platforms
+  const QString high = QString::number(static_cast<Q_UINT32>(hash >> 32), 16).rightJustify(8, '0');
+  const QString low = QString::number(static_cast<Q_UINT32>(hash & 0xFFFFFFFF), 16).rightJustify(8, '0');
+  return directory + QDir::separator() + high + low + ".orb";
+}
+
+///// describe ////////////////////////////////////////////////////////////////
+QString OrbitalCache::describe(const Key& key)
+/// Returns a description of the key which is unique for every combination of
+/// parameters. The floating point values are written with enough digits to
+/// distinguish them. The seed is left out for types that do not depend on it.
+{
+  QString result = QString("type=%1 Z=%2 n=%3 l=%4 m=%5 resolution=%6 probability=%7 dots=%8")
+                   .arg(key.type).arg(key.atom).arg(key.n).arg(key.l).arg(key.m)
+                   .arg(key.resolution, 0, 'g', 9).arg(key.probability, 0, 'g', 9)
+                   .arg(key.dots);
+  if(OrbitalThread::usesRandomNumbers(key.type))
+    result += QString(" seed=%1").arg(key.seed);
+  return result;
+}
+
+///// memoryUsage /////////////////////////////////////////////////////////////
+unsigned int OrbitalCache::memoryUsage(const Entry& entry)
+/// Returns the number of bytes used by the data of a result.
+{
+  unsigned int result = sizeof(Item) + entry.gridValues.size()*sizeof(double);
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+    result += entry.points[phase].size()*sizeof(float);
+  return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Static Variables                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+const unsigned int OrbitalCache::maximumMemory = 256*1024*1024;
+const Q_UINT32 OrbitalCache::magicNumber = 0x4F524243; // "ORBC"
+const Q_UINT32 OrbitalCache::fileVersion = 1;
+
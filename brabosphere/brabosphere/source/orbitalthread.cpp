@@ -19,10 +19,27 @@
   \class OrbitalThread
   \brief This class calculates Hydrogen orbitals for visualisation in 3D in a thread.
 
-  It uses increased precision (double, long double) only when needed. They are, however, not implemented
-  yet so the limit for 'n' (the main quantum number) lies somewhere around 15 
-  depending on the values of the other quantum numbers.
-
+  The calculation is done in float, double or long double, whichever is the
+  lowest precision that keeps the largest intermediate values finite and the
+  cancellation errors in the polynomials below maximumError. Float suffices
+  up to n = 9 (the main quantum number) for all values of the other quantum
+  numbers, double up to about n = 26. Where long double is wider than double
+  (e.g. the 80-bit type of GCC on x86) the limit lies around n = 33.
+
+  The work is distributed over a configurable number of worker threads. For 
+  the types sampling the theta/phi domain, the workers take rows of constant 
+  theta until all rows have been calculated. For random dots they take chunks
+  of dots. Each row or chunk has its own stream of random numbers derived
+  from the seed, so a given seed reproduces the same points regardless of 
+  the number of workers.
+  For the Surface type the workers take slabs of constant x of a regular grid
+  on which psi is calculated. The grid can be passed to a DensityGrid to 
+  obtain the isosurfaces of both phases.
+  The radial part is always calculated by a single worker. Every worker adds
+  its points to the shared PointBuffer in batches, so the order of the points 
+  depends on the timing of the workers. The progress is accumulated over all
+  workers and the receiver is notified with events of type 1001 (progress) 
+  and 1002 (finished) as before.
 */
 /// \file
 /// Contains the implementation of the class OrbitalThread
@@ -30,9 +47,11 @@
 ///// Header files ////////////////////////////////////////////////////////////
 
 // C++ header files
+#include <algorithm>
 #include <cassert>
 #include <cfloat>
 #include <cmath>
+#include <limits>
 
 // Qt header files
 #include <qapplication.h>
@@ -40,19 +59,52 @@
 
 // Xbrabo header files
 #include "orbitalthread.h"
+#include "pointbuffer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///// class OrbitalThread::Worker                                         /////
+///////////////////////////////////////////////////////////////////////////////
+
+class OrbitalThread::Worker : public QThread
+/// A worker thread calculating part of an orbital for an OrbitalThread.
+{
+  public:
+    Worker(OrbitalThread* master, const unsigned int index) : QThread(),
+      owner(master)
+    /// The default constructor.
+    {
+      state.index = index;
+      state.randomState = 0;
+      state.maximumRadius = 0.0f;
+    }
+
+    float maximumRadius() const
+    /// Returns the maximum encountered value of r.
+    {
+      return state.maximumRadius;
+    }
+
+  private:
+    virtual void run()
+    /// Calculates the part of the orbital assigned to this worker.
+    {
+      owner->calculate(state);
+    }
+
+    OrbitalThread* owner;               ///< The thread distributing the work.
+    WorkerState state;                  ///< The data private to this worker.
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// Public Member Functions                                             /////
 ///////////////////////////////////////////////////////////////////////////////
 
 ///// Constructor /////////////////////////////////////////////////////////////
-OrbitalThread::OrbitalThread(QWidget* parentWidget, QMutex* sharedMutex, std::vector<Point3D<float> >* coordinates, 
-                             const unsigned int type, const unsigned int atom, const unsigned int n, 
+OrbitalThread::OrbitalThread(QWidget* parentWidget, PointBuffer* pointBuffer, const unsigned int type, const unsigned int atom, const unsigned int n, 
                              const unsigned int l, const int m, const float res, const float prob, 
-                             const unsigned int dots) : QThread(),
+                             const unsigned int dots, const unsigned int threads, const unsigned int seed) : QThread(),
   receiver(parentWidget),
-  mutex(sharedMutex),
-  coords(coordinates),
+  points(pointBuffer),
   atomNumber(atom),
   qnPrincipal(n),
   qnOrbital(l),
@@ -61,19 +113,32 @@ OrbitalThread::OrbitalThread(QWidget* parentWidget, QMutex* sharedMutex, std::ve
   probability(prob),
   resolution(res),        
   numDots(dots),
-  stopRequested(false)
+  numThreads(threads > 0 ? threads : 1),
+  randomSeed(seed),
+  usedSeed(seed),
+  stopRequested(false),
+  neededPrecision(PRECISION_UNKNOWN),
+  maximumRadius(0.0f),
+  progress(0),
+  progressStep(1),
+  nextTask(0),
+  numTasks(0),
+  radialStep(1.0),
+  thetaStep(1.0),
+  phiStep(1.0)
 /// The default constructor. All needed parameters are passed upon creation of the thread as it is one-shot.
-/// Using multiple threads is easily accomplished by further providing start and end values for the angle Phi.
+/// The calculation is divided over the given number of worker threads. A seed
+/// of 0 draws a new seed for the random number generator on each run. The 
+/// points are appended to the buffer, which should be cleared beforehand.
 {
   assert(parentWidget != 0);
-  assert(sharedMutex != 0);
-  assert(coordinates != 0);
+  assert(pointBuffer != 0);
   assert(atom > 0);
   assert(prob >= 0.0f && prob <= 1.0f);
   assert(res > 1.0f);
   assert(n > l);
   assert(l >= static_cast<unsigned int>(abs(m))); // VC++ warns without the cast
-  assert(type < 3); // < 5 if AccumulatedProbability and RadialPart work as required
+  assert(type < 4); // < 6 if AccumulatedProbability and RadialPart work as required
 
   // get some statistics
   //qDebug("maximum float = %e (%d bits)", FLT_MAX, sizeof(float));
@@ -106,6 +171,74 @@ double OrbitalThread::boundingSphereRadius()
   return static_cast<double>(maximumRadius);
 }
 
+///// completed ///////////////////////////////////////////////////////////////
+bool OrbitalThread::completed() const
+/// Returns whether the last run calculated the complete orbital, i.e. it was
+/// neither stopped nor aborted for lack of precision. Only valid after the
+/// thread has finished.
+{
+  return !stopRequested && neededPrecision != PRECISION_UNKNOWN;
+}
+
+///// surfaceSize /////////////////////////////////////////////////////////////
+unsigned int OrbitalThread::surfaceSize(const float res)
+/// Returns the number of grid points in each direction used by the Surface type
+/// for the given resolution. At least 4 points are needed for a margin of one
+/// grid spacing on both sides.
+{
+  const unsigned int result = static_cast<unsigned int>(ceil(res));
+  if(result < 4)
+    return 4;
+  return result < maximumGridPoints ? result : maximumGridPoints;
+}
+
+///// usesRandomNumbers ///////////////////////////////////////////////////////
+bool OrbitalThread::usesRandomNumbers(const unsigned int type)
+/// Returns whether the result of the given type of calculation depends on the
+/// seed. The Surface and RadialPart types are evaluated on fixed points.
+{
+  return type != Surface && type != RadialPart;
+}
+
+///// surfaceValues ///////////////////////////////////////////////////////////
+const std::vector<double>* OrbitalThread::surfaceValues() const
+/// Returns the values of psi on the grid points calculated by the Surface type.
+/// The index of point (x, y, z) is (x*ny + y)*nz + z as used by DensityGrid. 
+/// The vector is empty for the other types. Only valid after the thread has
+/// finished.
+{
+  return &gridValues;
+}
+
+///// surfacePoints ///////////////////////////////////////////////////////////
+Point3D<unsigned int> OrbitalThread::surfacePoints() const
+/// Returns the number of grid points in each direction.
+{
+  return gridPoints;
+}
+
+///// surfaceDelta ////////////////////////////////////////////////////////////
+Point3D<float> OrbitalThread::surfaceDelta() const
+/// Returns the spacing of the grid points in each direction.
+{
+  return gridDelta;
+}
+
+///// surfaceOrigin ///////////////////////////////////////////////////////////
+Point3D<float> OrbitalThread::surfaceOrigin() const
+/// Returns the position of the first grid point.
+{
+  return gridOrigin;
+}
+
+///// surfaceLevel ////////////////////////////////////////////////////////////
+double OrbitalThread::surfaceLevel() const
+/// Returns the value of psi at the positive isosurface for the requested
+/// probability. The negative isosurface lies at minus this value.
+{
+  return sqrt(static_cast<double>(probability));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Private Member Functions                                            /////
 ///////////////////////////////////////////////////////////////////////////////
@@ -115,236 +248,202 @@ void OrbitalThread::run()
 /// Dispatches the work to the proper calculating
 /// routine. It is run with a call to start().
 {  
-  ////// determine the needed precision (float, double or long double
-  unsigned int neededPrecision = PRECISION_UNKNOWN;
+  ////// determine the needed precision (float, double or long double)
+  // the lowest precision is chosen that can represent the largest intermediate values
+  // and keeps the cancellation errors in the polynomials small enough
+  const long double condition = conditionNumber();
+  neededPrecision = PRECISION_UNKNOWN;
+  if(isSufficient<float>(condition))
+    neededPrecision = PRECISION_FLOAT;
+  else if(isSufficient<double>(condition))
+    neededPrecision = PRECISION_DOUBLE;
+  else if(isSufficient<long double>(condition))
+    neededPrecision = PRECISION_LONG_DOUBLE;
+  qDebug("required precision = %d (condition number %Le)", neededPrecision, condition);
+  if(neededPrecision == PRECISION_UNKNOWN)
+  {
+    // notify the thread has ended
+    QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1002));
+    QApplication::postEvent(receiver, e);
+    qDebug("exceeded long double limits");
+    return;
+  }
+
+  ///// tabulate the radial part
   if(calculationType != AngularPart)
+    tabulateRadialPart();
+  if(calculationType == Density || calculationType == Surface)
+    tabulateAngularPart();
+
+  ///// prepare the distribution of the work
+  usedSeed = randomSeed != 0 ? randomSeed : static_cast<unsigned int>(rand()) + 1;
+  maximumRadius = 0.0f;
+  progress = 0;
+  nextTask = 0;
+  numTasks = static_cast<unsigned int>(ceil(resolution)); // the number of rows of constant theta (and the number of points in each row)
+  unsigned int totalProgress = numTasks*numTasks;
+  if(calculationType == Density)
   {
-    ///// PRECISION CHECKS FOR ALL BUT GETANGULARPART
-    // check whether the largest possible number ((4n)^n) can be represented by a float
-    if(largestResult<float>(qnPrincipal, qnOrbital, qnMomentum, atomNumber) != HUGE_VAL)
-    //if(powf(static_cast<float>(4 * atomNumber * qnPrincipal), qnPrincipal) != HUGE_VALF)
-      neededPrecision = PRECISION_FLOAT;
-    // by a double
-    else if(largestResult<double>(qnPrincipal, qnOrbital, qnMomentum, atomNumber) != HUGE_VAL)
-    //else if(pow(static_cast<double>(4 * atomNumber * qnPrincipal), qnPrincipal) != HUGE_VAL)
-      neededPrecision = PRECISION_DOUBLE;
-    // or by a long double
-    else if(largestResult<long double>(qnPrincipal, qnOrbital, qnMomentum, atomNumber) != HUGE_VAL)
-      neededPrecision = PRECISION_LONG_DOUBLE;
+    numTasks = (numDots + densityChunk - 1)/densityChunk;
+    totalProgress = numDots;
   }
-  else
-  {     
-    ///// PRECISION CHECKS FOR ANGULAR PART
-    // check whether the largest possible number ((2l)!) can be represented by a float
-    if(factorial<float>(2*qnOrbital) != HUGE_VAL)
-      neededPrecision = PRECISION_FLOAT;
-    // by a double
-    else if(factorial<float>(2*qnOrbital) != HUGE_VAL)
-      neededPrecision = PRECISION_DOUBLE;
-    // or by a long double
-    else if(factorial<float>(2*qnOrbital) != HUGE_VAL)
-      neededPrecision = PRECISION_LONG_DOUBLE;
+  else if(calculationType == Surface)
+  {
+    prepareSurface();
+    numTasks = gridPoints.x(); // the number of slabs of constant x
+    totalProgress = numTasks*gridPoints.y()*gridPoints.z();
   }
-  qDebug("required precision = %d", neededPrecision);
-  if(neededPrecision == PRECISION_UNKNOWN)
+  else if(calculationType == RadialPart)
+    totalProgress = static_cast<unsigned int>(10.0f * resolution);
+  progressStep = totalProgress/100 > 0 ? totalProgress/100 : 1;
+
+  ///// run the workers
+  const unsigned int workers = calculationType == RadialPart ? 1 : numThreads;
+  std::vector<Worker*> pool;
+  for(unsigned int i = 0; i < workers; i++)
   {
-  // notify the thread has ended
-  QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1002));
-  QApplication::postEvent(receiver, e);
-    qDebug("exceeded long double limits");
-    return;
+    pool.push_back(new Worker(this, i));
+    pool.back()->start(QThread::LowPriority);
   }
-  if(neededPrecision != PRECISION_FLOAT)
+  for(unsigned int i = 0; i < workers; i++)
   {
+    pool[i]->wait();
+    if(pool[i]->maximumRadius() > maximumRadius) 
+      maximumRadius = pool[i]->maximumRadius();
+    delete pool[i];
+  }
+
   // notify the thread has ended
   QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1002));
   QApplication::postEvent(receiver, e);
-    qDebug("precision higher than float not implemented yet");
-    return;
+}
+
+///// calculate ///////////////////////////////////////////////////////////////
+void OrbitalThread::calculate(WorkerState& state)
+/// Dispatches the work of a worker to the routines with the needed precision.
+{
+  switch(neededPrecision)
+  {
+    case PRECISION_FLOAT:
+            calculate<float>(state);
+            break;
+    case PRECISION_DOUBLE:
+            calculate<double>(state);
+            break;
+    case PRECISION_LONG_DOUBLE:
+            calculate<long double>(state);
+            break;
   }
+}
 
+///// calculate ///////////////////////////////////////////////////////////////
+template <class T> void OrbitalThread::calculate(WorkerState& state)
+/// Dispatches the work of a worker to the proper calculating routine.
+{
   switch(calculationType)
   {
     case IsoProbability: 
-            calcIsoProbability();
+            calcIsoProbability<T>(state);
             break;
     case AccumulatedProbability: 
-            calcAccumulatedProbability();
+            calcAccumulatedProbability<T>(state);
             break;
     case Density: 
-            calcRandomDots();
+            calcRandomDots<T>(state);
             break;
     case RadialPart: 
-            calcRadialPart();
+            calcRadialPart<T>(state);
             break;
     case AngularPart: 
-            calcAngularPart();
+            calcAngularPart<T>(state);
+            break;
+    case Surface: 
+            calcSurface<T>(state);
             break;
   }
-  // notify the thread has ended
-  QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1002));
-  QApplication::postEvent(receiver, e);
 }
 
 ///// calcIsoProbability //////////////////////////////////////////////////////
-void OrbitalThread::calcIsoProbability()
+template <class T> void OrbitalThread::calcIsoProbability(WorkerState& state)
 /// Calculates the points having the given probability
 /// ( |psi|^2 ). (between 0.0 and 1.0 by definition)
 {
-  const int updateFreq = static_cast<int>(resolution*resolution)/100;
-
-  // clear the data
-  mutex->lock();
-  coords->clear();
-  mutex->unlock();
-  maximumRadius = 0.0f;
   std::vector<Point3D<float> > coordsList;
   coordsList.reserve(updateSize);
 
   // a short local form of the quantum numbers
-  const unsigned int n = qnPrincipal;
   const unsigned int l = qnOrbital;
   const int m = qnMomentum;
 
   // values independent of r, theta or phi
-  const float zna = static_cast<float>(atomNumber) / static_cast<float>(n) / abohr; // conversion factor for r->rho
-  const float normR = pow(2.0f*zna, 1.5f) * sqrt(factorial<float>(n-l-1)/2.0f/n/factorial<float>(n+l)); // normalization factor for the radial part
-  const float normTheta = pow(-1.0f, (m + abs(m))/2) * sqrtf( (2*l+1) * factorial<float>(l-abs(m)) / (2.0f * factorial<float>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
-  const float normPhi = 1.0f / sqrtf(Point3D<float>::PI); // normalization factor for the angular part (Phi dependent)
+  const T normTheta = (m > 0 && m % 2 != 0 ? -1 : 1) * std::sqrt((2*l+1) * factorial<T>(l-abs(m)) / (2 * factorial<T>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
+  const T pi = static_cast<T>(Point3D<double>::PI);
+  const T degToRad = static_cast<T>(Point3D<double>::DEGTORAD);
+  const T normPhi = 1 / std::sqrt(pi); // normalization factor for the angular part (Phi dependent)
   const float incTheta = 180.0f/resolution; // increment for theta
   const float incPhi = 360.0f/resolution; // increment for phi
-  const float maxR = 2.0f*static_cast<float>(n*n); // maximum value for r to check
-  const float incR = maxR / (10.0f * resolution); // increment for r
+  std::vector<float> radii; // the radii found for a direction
+  std::vector<bool> positive; // the signs of the radial part at these radii
 
   ///// loop over THETA ///////////////
-  for(float theta = 0.0f; theta < 180.0f; theta += incTheta) // rotation away from z-axis: only 180 degrees
+  unsigned int row;
+  while(nextRow(row)) // rotation away from z-axis: only 180 degrees
   {
+    state.randomState = randomStream(row);
+    const float theta = row*incTheta;
     ///// loop over PHI ///////////////
     for(float phi = 0.0f; phi < 360.0f; phi += incPhi) // rotation around z-axis: full 360 degrees
     {
-      // notify the progress
-      progress = static_cast<int>(theta/incTheta * resolution + phi/incPhi);
-      if(progress % updateFreq == 0)
-      {
-        QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1001),&progress);
-        QApplication::postEvent(receiver, e);
-      }
-                        
+      if(stopRequested)
+        return;
+
       // randomize theta within its square
-      const float randTheta = theta + random(-incTheta/2.0f, incTheta/2.0f);
+      const float randTheta = theta + random(state.randomState, -incTheta/2.0f, incTheta/2.0f);
       // determine whether this point is to be drawn (|sin(theta)| function is maximum near the equator and zero at the poles)
-      if(random(0.0f, 1.0f) > fabs(sinf(randTheta*Point3D<float>::DEGTORAD)))
+      if(random(state.randomState, 0.0f, 1.0f) > std::fabs(std::sin(randTheta*degToRad)))
         continue;
       // randomize phi within its square
-      const float randPhi = phi + random(-incPhi/2.0f, incPhi/2.0f);
+      const float randPhi = phi + random(state.randomState, -incPhi/2.0f, incPhi/2.0f);
         
       // get the result for theta
-      const float partTheta = normTheta * associatedLegendre(cosf(randTheta*Point3D<float>::DEGTORAD), abs(m), l);
+      const T partTheta = normTheta * associatedLegendre<T>(std::cos(randTheta*degToRad), abs(m), l);
       // get the result for phi
-      float partPhi = normPhi;
+      T partPhi = normPhi;
       if(m == 0)
-        partPhi /= sqrtf(2.0f);
+        partPhi /= std::sqrt(static_cast<T>(2));
       else if(m > 0)
-       partPhi *= sinf(m*randPhi*Point3D<float>::DEGTORAD);
+       partPhi *= std::sin(m*randPhi*degToRad);
       else
-       partPhi *= cosf(m*randPhi*Point3D<float>::DEGTORAD);
+       partPhi *= std::cos(m*randPhi*degToRad);
 
       // total angular result
-      const float partY = partTheta * partPhi;
-
-      ///// loop over R ///////////////
-      float r = incR;
-      float newProbability = 0.0f;
-      const unsigned int maxPoints = l == 0 ? 2*n -1 : 2*(n - l); // the maximum number of times a value can be the given probability
-      unsigned int numPoints = 0;
-      // determine a starting oldProbability (for r = 0.0f)
-      float oldProbability = pow(partY * normR * associatedLaguerre(0.0f, 2*l+1, n-l-1) , 2);
-      // start the loop
-      while(r < maxR && numPoints < maxPoints)
-      {
-        if(stopRequested)
-          return;
-        const float rho = 2.0f * zna * r;
-        const float partR = normR * pow(rho, static_cast<int>(l)) * exp(-rho/2.0f) * associatedLaguerre(rho, 2*l+1, n-l-1);
-
-        newProbability = partY * partR * partY * partR;
-        //totalProbability += 4.0f * Point3D<float>::PI * newProbability * r*r / resolution;
-
-        if(r > incR && ((oldProbability <= probability && newProbability >= probability) || (oldProbability >= probability && newProbability <= probability)))
-        {
-            // found a point
-            const float minProb = oldProbability < newProbability ? oldProbability : newProbability;
-            const float maxProb = oldProbability > newProbability ? oldProbability : newProbability;
-            const float interpolatedR = r + incR * (probability - minProb)/(maxProb-minProb);
-
-            //if(theta <= 180.0f/resolution && phi <= 360.0f/resolution)
-            //  qDebug("point found at r = %f, interpolatedR = %f", r, interpolatedR);
-
-            numPoints++;
-            Point3D<float> newCoord;
-            newCoord.setPolar(randTheta, randPhi, interpolatedR);
-            newCoord.setID(partY*partR > 0.0f ? 1 : 0); // misuse Point3D's ID to store the phase (1 = pos, 0 = neg)
-            coordsList.push_back(newCoord);
-            updateList(coordsList);
-            if(r > maximumRadius) maximumRadius = r;
-        }
-        oldProbability = newProbability;
-        r += incR;
-      }
-      
-      if(numPoints < maxPoints && oldProbability > probability)
+      const T partY = partTheta * partPhi;
+      if(partY == 0)
+        continue;
+
+      ///// find the radii ///////////////
+      // the probability is reached where the absolute value of the radial part is sqrt(probability)/|Y|
+      findRadii<T>(std::sqrt(static_cast<T>(probability))/std::fabs(partY), radii, positive);
+      for(unsigned int i = 0; i < radii.size(); i++)
       {
-        //if(theta < 180.0f/resolution && phi < 360.0f/resolution)
-        //  qDebug("trying remaining space");
-
-        // the remaining cloud still has at least one point with the given probability
-        while(true)
-        {
-          if(stopRequested)
-            return;
-          const float rho = 2.0f * zna * r;
-          const float partR = normR * pow(rho, static_cast<int>(l)) * exp(-rho/2.0f) * associatedLaguerre(rho, 2*l+1, n-l-1);
-          newProbability = partY * partR * partY * partR;
-          if(oldProbability >= probability && newProbability <= probability)
-          {
-            const float interpolatedR = r + incR * (probability - newProbability)/(oldProbability-newProbability);
-
-            //if(theta <= 180.0f/resolution && phi <= 360.0f/resolution)
-            //  qDebug("extra point found at r = %f, interpolatedR = %f", r, interpolatedR);
-
-            numPoints++;
-            Point3D<float> newCoord;
-            newCoord.setPolar(randTheta, randPhi, interpolatedR);
-            newCoord.setID(partY*partR > 0.0f ? 1 : 0); 
-            //mutex->lock();
-            //coords->push_back(newCoord);
-            //mutex->unlock();
-            coordsList.push_back(newCoord);
-            updateList(coordsList);
-            if(r > maximumRadius) maximumRadius = r;
-            break;
-          }
-          oldProbability = newProbability;
-          r += incR;
-        }
+        Point3D<float> newCoord;
+        newCoord.setPolar(randTheta, randPhi, radii[i]);
+        newCoord.setID((partY > 0) == positive[i] ? 1 : 0); // misuse Point3D's ID to store the phase (1 = pos, 0 = neg)
+        coordsList.push_back(newCoord);
+        updateList(coordsList);
+        if(radii[i] > state.maximumRadius) state.maximumRadius = radii[i];
       }
     }    
+    addProgress(numTasks);
   }
   updateList(coordsList, true);
 }
 
 ///// calcAccumulatedProbability //////////////////////////////////////////////
-void OrbitalThread::calcAccumulatedProbability()
+template <class T> void OrbitalThread::calcAccumulatedProbability(WorkerState& state)
 /// Calculates the points having the given accumulated probability
 /// ( |psi|^2 ). (between 0.0 and 1.0 by definition);
 {
-  const int updateFreq = static_cast<int>(resolution*resolution)/100;
-
-  // clear the data
-  mutex->lock();
-  coords->clear();
-  mutex->unlock();
-  maximumRadius = 0.0f;
   std::vector<Point3D<float> > coordsList;
   coordsList.reserve(updateSize);
 
@@ -354,75 +453,55 @@ void OrbitalThread::calcAccumulatedProbability()
   const int m = qnMomentum;
   
   // values independent of r, theta or phi
-  const float zna = static_cast<float>(atomNumber) / static_cast<float>(n) / abohr; // conversion factor for r->rho
-  const float normR = pow(2.0f*zna, 1.5f) * sqrt(factorial<float>(n-l-1)/2.0f/n/factorial<float>(n+l)); // normalization factor for the radial part
-  const float normTheta = pow(-1.0f, (m + abs(m))/2) * sqrtf( (2*l+1) * factorial<float>(l-abs(m)) / (2.0f * factorial<float>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
-  const float normPhi = 1.0f / sqrtf(Point3D<float>::PI); // normalization factor for the angular part (Phi dependent)
+  const T normTheta = (m > 0 && m % 2 != 0 ? -1 : 1) * std::sqrt((2*l+1) * factorial<T>(l-abs(m)) / (2 * factorial<T>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
+  const T pi = static_cast<T>(Point3D<double>::PI);
+  const T degToRad = static_cast<T>(Point3D<double>::DEGTORAD);
+  const T normPhi = 1 / std::sqrt(pi); // normalization factor for the angular part (Phi dependent)
   const float incTheta = 180.0f/resolution; // increment for theta
   const float incPhi = 360.0f/resolution; // increment for phi
   const float maxR = 2.0f*static_cast<float>(n*n); // maximum value for r to check
-  const float incR = maxR / (10.0f * resolution); // increment for r
   
   ///// loop over THETA ///////////////
-  for(float theta = 0.0f; theta < 180.0f; theta += incTheta) // rotation away from z-axis: only 180 degrees
+  unsigned int row;
+  while(nextRow(row)) // rotation away from z-axis: only 180 degrees
   {
+    state.randomState = randomStream(row);
+    const float theta = row*incTheta;
 
     ///// loop over PHI ///////////////
     for(float phi = 0.0f; phi < 360.0f; phi += incPhi) // rotation around z-axis: full 360 degrees
     {
-      // notify the progress
-      progress = static_cast<int>(theta/incTheta * resolution + phi/incPhi);
-      if(progress % updateFreq == 0)
-      {
-        QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1001),&progress);
-        QApplication::postEvent(receiver, e);
-      }
+      if(stopRequested)
+        return;
 
       // randomize theta within its square
-      const float randTheta = theta + random(-incTheta/2.0f, incTheta/2.0f);
+      const float randTheta = theta + random(state.randomState, -incTheta/2.0f, incTheta/2.0f);
       // determine whether this point is to be drawn (|sin(theta)| function is maximum near the equator and zero at the poles)
-      if(random(0.0f, 1.0f) > fabs(sinf(randTheta*Point3D<float>::DEGTORAD)))
+      if(random(state.randomState, 0.0f, 1.0f) > std::fabs(std::sin(randTheta*degToRad)))
         continue;
       
       // get the result for theta
-      const float partTheta = normTheta * associatedLegendre(cosf(randTheta*Point3D<float>::DEGTORAD), abs(m), l);
+      const T partTheta = normTheta * associatedLegendre<T>(std::cos(randTheta*degToRad), abs(m), l);
 
       // randomize phi within its square
-      const float randPhi = phi + random(-incPhi/2.0f, incPhi/2.0f);
+      const float randPhi = phi + random(state.randomState, -incPhi/2.0f, incPhi/2.0f);
       // get the result for phi
-      float partPhi = normPhi;
+      T partPhi = normPhi;
       if(m == 0)
-        partPhi /= sqrtf(2.0f);
+        partPhi /= std::sqrt(static_cast<T>(2));
       else if(m > 0)
-       partPhi *= sinf(m*randPhi*Point3D<float>::DEGTORAD);
+       partPhi *= std::sin(m*randPhi*degToRad);
       else
-       partPhi *= cosf(m*randPhi*Point3D<float>::DEGTORAD);
+       partPhi *= std::cos(m*randPhi*degToRad);
 
       // total angular result
-      const float partY = partTheta * partPhi;
-
-      ///// loop over R ///////////////
-      float r = 0.0f;
-      float totalProbability = 0.0f;
-      float amplitude = 0.0f;
-      while (r < maxR)
-      {
-        if(stopRequested)
-          return;
-        const float rho = 2.0f * zna * r;
-        const float partR = normR * pow(rho, static_cast<int>(l)) * exp(-rho/2.0f) * associatedLaguerre(rho, 2*l+1, n-l-1);
+      const T partY = partTheta * partPhi;
 
-        // total amplitude
-        amplitude = partY * partR;
-        totalProbability += 4.0f * Point3D<float>::PI * amplitude*amplitude * r*r * incR;
-
-        //qDebug("r = %f, amplitude = %f, totalProbability = %20.15f", r, amplitude, totalProbability);
-        if(totalProbability >= probability)
-          break;
-
-        r += incR;
-      }
-      //break;
+      ///// find R ///////////////
+      // the accumulated probability up to r is 4*pi*Y^2 times the cumulative radial probability
+      const T angularProbability = 4 * pi * partY * partY;
+      const float r = angularProbability > 0 ? cumulativeRadius(static_cast<double>(probability/angularProbability)) : maxR;
+      const T amplitude = partY * radialPart<T>(r);
       // now r is the required radius
       //qDebug("getAccumProb: phi = %f, theta = %f, distance = %f", theta, phi, partY);
       Point3D<float> newCoord;
@@ -430,155 +509,78 @@ void OrbitalThread::calcAccumulatedProbability()
       newCoord.setID(amplitude > 0.0f ? 1 : 0); 
       coordsList.push_back(newCoord);
       updateList(coordsList);
-      if(r > maximumRadius) maximumRadius = r;
+      if(r > state.maximumRadius) state.maximumRadius = r;
     }
+    addProgress(numTasks);
   }
   updateList(coordsList, true);
 }
 
 ///// calcRandomDots //////////////////////////////////////////////////////////
-void OrbitalThread::calcRandomDots()
-/// Calculates random points according to the probability at a random point.
+template <class T> void OrbitalThread::calcRandomDots(WorkerState& state)
+/// Calculates random points distributed according to the probability density.
+/// As the density is a product of functions of r, theta and phi, each of them
+/// is sampled independently by inverting its tabulated cumulative distribution,
+/// including the volume element r^2 sin(theta). So every point is accepted.
 {
-  const int updateFreq = static_cast<int>(numDots)/100;
-
-  // clear the data
-  mutex->lock();
-  coords->clear();
-  mutex->unlock();
-  maximumRadius = 0.0f;
   std::vector<Point3D<float> > coordsList;
   coordsList.reserve(updateSize);
 
-  // a short local form of the quantum numbers
-  const unsigned int n = qnPrincipal;
-  const unsigned int l = qnOrbital;
-  const int m = qnMomentum;
-
-  // values independent of r, theta or phi
-  const float zna = static_cast<float>(atomNumber) / static_cast<float>(n) / abohr; // conversion factor for r->rho
-  const float normR = pow(2.0f*zna, 1.5f) * sqrt(factorial<float>(n-l-1)/2.0f/n/factorial<float>(n+l)); // normalization factor for the radial part
-  const float normTheta = pow(-1.0f, (m + abs(m))/2) * sqrtf( (2*l+1) * factorial<float>(l-abs(m)) / (2.0f * factorial<float>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
-  const float normPhi = 1.0f / sqrtf(Point3D<float>::PI); // normalization factor for the angular part (Phi dependent)
-  const float maxR = 2.0f * static_cast<float>(n*n); // n*n is maximum radial probability for ns => this is the maximum radius for drawing points
-  float maxRtest = 0.0f; // => this is the maximum radius needed for the maximum probability test (0 if l == 0)
-  if(l == n-1)
-    maxRtest = static_cast<float>(n*l); // correct (= l*(l+1))
-  else if(l != 0)
-    maxRtest = static_cast<float>(l*(l+1)); // maximum (higher n is smaller maxRtest)
-
-  // run for 1/10th of the amount (1000 points max) to get an estimate on the maximum probability
-  float maxProb = 0.0f;
-  float maxProbR = 0.0f;
-  unsigned int testLimit = numDots/10 < 1000 ? numDots/10 : 1000;
-  for(unsigned int i = 0; i < testLimit; i++)
+  ///// loop over the chunks of dots
+  unsigned int chunk;
+  while(nextRow(chunk))
   {
-    if(stopRequested)
-      return;
-    const float theta = random(0.0f, 180.0f);
-    const float phi = random(0.0f, 360.0f);
-    const float r = random(0.0f, maxRtest);
-    // calculate the probability
-    const float partTheta = normTheta * associatedLegendre(cosf(theta*Point3D<float>::DEGTORAD), abs(m), l);
-    float partPhi = normPhi;
-    if(m == 0)
-      partPhi /= sqrtf(2.0f);
-    else if(m > 0)
-     partPhi *= sinf(m*phi*Point3D<float>::DEGTORAD);
-    else
-     partPhi *= cosf(m*phi*Point3D<float>::DEGTORAD);
-    const float rho = 2.0f * zna * r;
-    const float partR = normR * pow(rho, static_cast<int>(l)) * exp(-rho/2.0f) * associatedLaguerre(rho, 2*l+1, n-l-1);
-    const float probability = pow(partTheta * partPhi * partR, 2);
-    if(probability > maxProb)
-    {
-      maxProb = probability;
-      maxProbR = r;
-    }
-  }
-  qDebug("estimated maximum probability = %f", maxProb);
-
-  // do the actual run
-  unsigned int currentDots = 0;
-  while(currentDots < numDots)
-  {
-    if(stopRequested)
-      return;
-
-    // generate a position in spherical coordinates
-    const float theta = random(0.1f, 179.9f);
-    const float phi = random(0.0f, 360.0f);
-    const float r = random(0.0f, maxR);
-
-    // determine whether this point is to be drawn (|sin(theta)| function is maximum near the equator and zero at the poles)
-    if(random(0.0f, 1.0f) > fabs(sinf(theta*Point3D<float>::DEGTORAD)))
-      continue;
-
-    // calculate the probability
-    const float partTheta = normTheta * associatedLegendre(cosf(theta*Point3D<float>::DEGTORAD), abs(m), l);
-    float partPhi = normPhi;
-    if(m == 0)
-      partPhi /= sqrtf(2.0f);
-    else if(m > 0)
-     partPhi *= sinf(m*phi*Point3D<float>::DEGTORAD);
-    else
-     partPhi *= cosf(m*phi*Point3D<float>::DEGTORAD);
-    const float rho = 2.0f * zna * r;
-    const float partR = normR * pow(rho, static_cast<int>(l)) * exp(-rho/2.0f) * associatedLaguerre(rho, 2*l+1, n-l-1);
-    const float probability = pow(partTheta * partPhi * partR, 2);
-    if(probability > maxProb)
+    state.randomState = randomStream(chunk);
+    const unsigned int chunkDots = numDots - chunk*densityChunk < densityChunk ? numDots - chunk*densityChunk : densityChunk;
+    for(unsigned int i = 0; i < chunkDots; i++)
     {
-      maxProb = probability; // adjust while in the loop
-      maxProbR = r;
-    }
-    if(probability > random(0.0f, maxProb))
-    {
-      // add this point
-      Point3D<float> newCoord;
-      newCoord.setPolar(theta, phi, r);
-      newCoord.setID(partTheta*partPhi*partR > 0.0f ? 1 : 0); 
-      coordsList.push_back(newCoord);
-      updateList(coordsList);
-      if(r > maximumRadius) maximumRadius = r;
-      currentDots++;
-      // notify the progress
-      if(currentDots % updateFreq == 0)
-      {
-        progress = currentDots;
-        QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1001),&progress);
-        QApplication::postEvent(receiver, e);
-      }
+      if(stopRequested)
+        return;
+      calcRandomDot<T>(state, coordsList);
     }
+    addProgress(chunkDots);
   }
   updateList(coordsList, true);
-  qDebug("final maximum probability = %f", maxProb);
-  qDebug(" corresponding radius = %f", maxProbR);
+}
+
+///// calcRandomDot ///////////////////////////////////////////////////////////
+template <class T> void OrbitalThread::calcRandomDot(WorkerState& state, std::vector<Point3D<float> >& coordsList)
+/// Calculates a single random point for calcRandomDots.
+{
+  // generate a position in spherical coordinates
+  const float r = cumulativeRadius(random(state.randomState, 0.0f, 1.0f)*radialCumulative.back());
+  const double theta = inverseCumulative(thetaCumulative, thetaStep, random(state.randomState, 0.0f, 1.0f)*thetaCumulative.back());
+  const double phi = inverseCumulative(phiCumulative, phiStep, random(state.randomState, 0.0f, 1.0f)*phiCumulative.back());
+
+  // determine the phase
+  const T partR = radialPart<T>(r);
+  const double partTheta = interpolate(thetaValues, thetaStep, theta);
+  const double partPhi = interpolate(phiValues, phiStep, phi);
+
+  // add this point
+  Point3D<float> newCoord;
+  newCoord.setPolar(static_cast<float>(theta), static_cast<float>(phi), r);
+  newCoord.setID(partR*partTheta*partPhi > 0 ? 1 : 0); 
+  coordsList.push_back(newCoord);
+  updateList(coordsList);
+  if(r > state.maximumRadius) state.maximumRadius = r;
 }
 
 ///// calcRadialPart //////////////////////////////////////////////////////////
-void OrbitalThread::calcRadialPart()
+template <class T> void OrbitalThread::calcRadialPart(WorkerState& state)
 /// Draws the radial part of the orbital.
 {
-  const int updateFreq = static_cast<int>(10.0f * resolution)/100;
-
-  // clear the data
-  mutex->lock();
-  coords->clear();
-  mutex->unlock();
   std::vector<Point3D<float> > coordsList;
   coordsList.reserve(updateSize);
   
   // a short local form of the quantum numbers
   const unsigned int n = qnPrincipal;
-  const unsigned int l = qnOrbital;
 
   // values independent of r
-  const float zna = static_cast<float>(atomNumber) / static_cast<float>(n) / abohr; // conversion factor for r->rho
-  const float normR = pow(2.0f*zna, 1.5f) * sqrt(factorial<float>(n-l-1)/2.0f/n/factorial<float>(n+l)); // normalization factor for the radial part
   const float maxR = 2.0f*static_cast<float>(n*n); // maximum value for r to check
   const float incR = maxR / (10.0f * resolution); // increment for r
 
-  maximumRadius = maxR;
+  state.maximumRadius = maxR;
 
   //float probability = 0.0f;
   //float probabilityRadius = 0.0f;
@@ -590,22 +592,16 @@ void OrbitalThread::calcRadialPart()
       return;
 
     // notify the progress
-    progress = static_cast<unsigned int>(r/incR);
-    if(progress % updateFreq == 0)
-    {
-      QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1001),&progress);
-      QApplication::postEvent(receiver, e);
-    }
+    addProgress(1);
 
     // calculate the value
-    const float rho = 2.0f * zna * r;
-    const float partR = normR * pow(rho, static_cast<int>(l)) * exp(-rho/2.0f) * associatedLaguerre(rho, 2*l+1, n-l-1);
+    const T partR = radialPart<T>(r);
 
     // the radial part => amplitude
-    Point3D<float> newCoord1(r, partR, 0.0f);
+    Point3D<float> newCoord1(r, static_cast<float>(partR), 0.0f);
     newCoord1.setID(1);
     // the radial part => probability = R^2r^2
-    Point3D<float> newCoord2(r, partR*partR*r*r, 0.0f);
+    Point3D<float> newCoord2(r, static_cast<float>(partR*partR*r*r), 0.0f);
     newCoord2.setID(0);
     // add the points
     coordsList.push_back(newCoord1);
@@ -623,16 +619,9 @@ void OrbitalThread::calcRadialPart()
 }
 
 ///// calcAngularPart /////////////////////////////////////////////////////////
-void OrbitalThread::calcAngularPart()
+template <class T> void OrbitalThread::calcAngularPart(WorkerState& state)
 /// Calculates the angular part of the orbital.
 {
-  const int updateFreq = static_cast<int>(resolution * resolution)/100;
-
-  // clear the data
-  mutex->lock();
-  coords->clear();
-  mutex->unlock();
-  maximumRadius = 0.0f;
   std::vector<Point3D<float> > coordsList;
   coordsList.reserve(updateSize);
   
@@ -641,14 +630,19 @@ void OrbitalThread::calcAngularPart()
   const int m = qnMomentum;
 
   // values independent of theta or phi
-  const float normTheta = pow(-1.0f, (m + abs(m))/2) * sqrtf( (2*l+1) * factorial<float>(l-abs(m)) / (2.0f * factorial<float>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
-  const float normPhi = 1.0f / sqrtf(Point3D<float>::PI); // normalization factor for the angular part (Phi dependent)
+  const T normTheta = (m > 0 && m % 2 != 0 ? -1 : 1) * std::sqrt((2*l+1) * factorial<T>(l-abs(m)) / (2 * factorial<T>(l+abs(m)))); // normalization factor for the angular part (Theta dependent)
+  const T pi = static_cast<T>(Point3D<double>::PI);
+  const T degToRad = static_cast<T>(Point3D<double>::DEGTORAD);
+  const T normPhi = 1 / std::sqrt(pi); // normalization factor for the angular part (Phi dependent)
   const float incTheta = 180.0f/resolution; // increment for theta
   const float incPhi = 360.0f/resolution; // increment for phi
 
   ///// loop over THETA ///////////////
-  for(float theta = 0.0f; theta < 180.0f; theta += incTheta) // rotation away from z-axis: only 180 degrees
+  unsigned int row;
+  while(nextRow(row)) // rotation away from z-axis: only 180 degrees
   {
+    state.randomState = randomStream(row);
+    const float theta = row*incTheta;
 
     ///// loop over PHI ///////////////
     for(float phi = 0.0f; phi < 360.0f; phi += incPhi) // rotation around z-axis: full 360 degrees
@@ -656,96 +650,514 @@ void OrbitalThread::calcAngularPart()
       if(stopRequested)
         return;
 
-      // notify the progress
-      progress = static_cast<int>(theta/incTheta * resolution + phi/incPhi);
-      if(progress % updateFreq == 0)
-      {
-        QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1001),&progress);
-        QApplication::postEvent(receiver, e);
-      }
-
       // randomize theta within its square
-      const float randTheta = theta + random(-incTheta/2.0f, incTheta/2.0f);
+      const float randTheta = theta + random(state.randomState, -incTheta/2.0f, incTheta/2.0f);
       // determine whether this point is to be drawn (|sin(theta)| function is maximum near the equator and zero at the poles)
-      if(random(0.0f, 1.0f) > fabs(sinf(randTheta*Point3D<float>::DEGTORAD)))      
+      if(random(state.randomState, 0.0f, 1.0f) > std::fabs(std::sin(randTheta*degToRad)))      
         continue;
       // get the result for theta
-      const float partTheta = normTheta * associatedLegendre(cosf(randTheta*Point3D<float>::DEGTORAD), abs(m), l);
+      const T partTheta = normTheta * associatedLegendre<T>(std::cos(randTheta*degToRad), abs(m), l);
 
       // randomize phi within its square
-      const float randPhi = phi + random(-incPhi/2.0f, incPhi/2.0f);
+      const float randPhi = phi + random(state.randomState, -incPhi/2.0f, incPhi/2.0f);
       // get the result for phi
-      float partPhi = normPhi;
+      T partPhi = normPhi;
       if(m == 0)
-        partPhi /= sqrtf(2.0f);
+        partPhi /= std::sqrt(static_cast<T>(2));
       else if(m > 0)
-       partPhi *= sinf(m*randPhi*Point3D<float>::DEGTORAD);
+       partPhi *= std::sin(m*randPhi*degToRad);
       else
-       partPhi *= cosf(m*randPhi*Point3D<float>::DEGTORAD);
+       partPhi *= std::cos(m*randPhi*degToRad);
 
       // total angular result
-      const float partY = partTheta * partPhi;
+      const T partY = partTheta * partPhi;
 
       // save the data
-      const float r = fabs(partY);
+      const float r = static_cast<float>(std::fabs(partY));
       Point3D<float> newCoord;
       newCoord.setPolar(randTheta, randPhi, r);
       newCoord.setID(partY > 0.0f ? 1 : 0); 
       coordsList.push_back(newCoord);
       updateList(coordsList);
-      if(r > maximumRadius) maximumRadius = r;
+      if(r > state.maximumRadius) state.maximumRadius = r;
     }
+    addProgress(numTasks);
   }
   updateList(coordsList, true);
 }
 
+///// calcSurface ///////////////////////////////////////////////////////////
+template <class T> void OrbitalThread::calcSurface(WorkerState& state)
+/// Calculates psi on the points of the grid set up by prepareSurface. Each 
+/// assigned slab of constant x is written to its own part of gridValues, so 
+/// no locking is needed.
+{
+  // a short local form of the quantum numbers
+  const int m = qnMomentum;
+
+  // values independent of the position
+  const T pi = static_cast<T>(Point3D<double>::PI);
+  const T radToDeg = 180 / pi;
+  const T normPhi = 1 / std::sqrt(m == 0 ? 2*pi : pi); // normalization factor for the angular part (Phi dependent)
+  const unsigned int slabSize = gridPoints.y()*gridPoints.z();
+  state.maximumRadius = maximumRadius; // the isosurfaces lie within the radius found by prepareSurface
+
+  ///// loop over the slabs of constant x
+  unsigned int slab;
+  while(nextRow(slab))
+  {
+    const T x = gridOrigin.x() + slab*gridDelta.x();
+    std::vector<double>::iterator itValue = gridValues.begin() + slab*slabSize;
+    for(unsigned int j = 0; j < gridPoints.y(); j++)
+    {
+      if(stopRequested)
+        return;
+
+      const T y = gridOrigin.y() + j*gridDelta.y();
+      // phi is constant along z
+      T partPhi = normPhi;
+      if(m > 0)
+        partPhi *= std::sin(m*std::atan2(y, x));
+      else if(m < 0)
+        partPhi *= std::cos(m*std::atan2(y, x));
+      for(unsigned int k = 0; k < gridPoints.z(); k++, itValue++)
+      {
+        const T z = gridOrigin.z() + k*gridDelta.z();
+        const T r = std::sqrt(x*x + y*y + z*z);
+        const T theta = r > 0 ? std::acos(z/r)*radToDeg : 0;
+        *itValue = static_cast<double>(radialPart<T>(r) * static_cast<T>(interpolate(thetaValues, thetaStep, theta)) * partPhi);
+      }
+    }
+    addProgress(slabSize);
+  }
+}
+
+///// nextRow /////////////////////////////////////////////////////////////////
+bool OrbitalThread::nextRow(unsigned int& row)
+/// Assigns the next row of constant theta (or chunk of random dots or slab of
+/// grid points) to be calculated. Returns false if all rows have been assigned.
+{
+  QMutexLocker locker(&workMutex);
+  if(nextTask >= numTasks)
+    return false;
+  row = nextTask++;
+  return true;
+}
+
+///// addProgress /////////////////////////////////////////////////////////////
+void OrbitalThread::addProgress(const unsigned int amount)
+/// Increases the progress of the calculation by the given amount. The receiver
+/// is notified each time the progress passes a multiple of progressStep.
+{
+  workMutex.lock();
+  const bool notify = (progress + amount)/progressStep != progress/progressStep;
+  progress += amount;
+  workMutex.unlock();
+  if(notify)
+  {
+    QCustomEvent* e = new QCustomEvent(static_cast<QEvent::Type>(1001),&progress);
+    QApplication::postEvent(receiver, e);
+  }
+}
+
 ///// updateList //////////////////////////////////////////////////////////////
 void OrbitalThread::updateList(std::vector<Point3D<float> >& newCoords, bool final)
-/// Updates the shared coordinate list with a set of newly calculated points.
+/// Publishes a set of newly calculated points to the shared buffer.
 /// If final is true, the update is forces, even if less than updateSize values are present.
 {
   if(newCoords.size() >= updateSize || (final && !newCoords.empty()))
   {
-    mutex->lock();
-    coords->insert(coords->end(), newCoords.begin(), newCoords.end());
-    mutex->unlock();
+    points->append(newCoords);
     newCoords.clear();
     qDebug("Added %d new points", updateSize);
   }
 }
 
+///// tabulateRadialPart /////////////////////////////////////////////////////
+void OrbitalThread::tabulateRadialPart()
+/// Tabulates the radial part of the orbital on a uniform grid of r between 0
+/// and the largest radius used by the calculations. It is evaluated in long 
+/// double precision and interpolated between the grid points by a cubic
+/// spline. Also tabulates the cumulative radial probability (the 
+/// integral of R^2r^2), integrating the spline with Simpson's rule.
+{
+  const unsigned int n = qnPrincipal;
+  const double maxR = 2.0*n*n;
+  const double maxRho = 2.0*atomNumber/n/abohr * maxR;
+  unsigned int intervals = static_cast<unsigned int>(ceil(maxRho/tableStep));
+  if(intervals < minimumIntervals)
+    intervals = minimumIntervals;
+  else if(intervals > maximumIntervals)
+    intervals = maximumIntervals;
+  radialStep = maxR/intervals;
+
+  ///// the values
+  radialValues.resize(intervals + 1);
+  for(unsigned int i = 0; i <= intervals; i++)
+    radialValues[i] = static_cast<double>(radialFunction<long double>(static_cast<long double>(i)*radialStep));
+
+  ///// the second derivatives of the spline (a tridiagonal system for equal steps)
+  // they are stored multiplied by radialStep^2/6 as only these products are needed
+  // the second derivatives at the ends are estimated by finite differences
+  const long double d = radialStep/64.0;
+  const long double lastR = maxR;
+  const double firstCurvature = static_cast<double>((2*radialFunction<long double>(0) - 5*radialFunction<long double>(d) 
+                                + 4*radialFunction<long double>(2*d) - radialFunction<long double>(3*d))/(d*d));
+  const double lastCurvature = static_cast<double>((radialFunction<long double>(lastR - d) - 2*radialFunction<long double>(lastR)
+                                + radialFunction<long double>(lastR + d))/(d*d));
+  std::vector<double> temp(intervals + 1, 0.0);
+  radialCurvatures.assign(intervals + 1, 0.0);
+  temp[0] = firstCurvature;
+  radialCurvatures[intervals] = lastCurvature;
+  for(unsigned int i = 1; i < intervals; i++)
+  {
+    const double p = 0.5*radialCurvatures[i - 1] + 2.0;
+    radialCurvatures[i] = -0.5/p;
+    temp[i] = (3.0*(radialValues[i + 1] - 2.0*radialValues[i] + radialValues[i - 1])/(radialStep*radialStep) - 0.5*temp[i - 1])/p;
+  }
+  for(unsigned int i = intervals - 1; i > 0; i--)
+    radialCurvatures[i] = radialCurvatures[i]*radialCurvatures[i + 1] + temp[i];
+  radialCurvatures[0] = firstCurvature;
+  for(unsigned int i = 0; i <= intervals; i++)
+    radialCurvatures[i] *= radialStep*radialStep/6.0;
+
+  ///// the cumulative probability
+  radialCumulative.resize(intervals + 1);
+  radialCumulative[0] = 0.0;
+  for(unsigned int i = 0; i < intervals; i++)
+  {
+    const double r = i*radialStep;
+    const double middle = 0.5*(radialValues[i] + radialValues[i + 1]) - 0.375*(radialCurvatures[i] + radialCurvatures[i + 1]); // the spline at r + radialStep/2
+    const double f0 = radialValues[i]*r;
+    const double f1 = middle*(r + 0.5*radialStep);
+    const double f2 = radialValues[i + 1]*(r + radialStep);
+    radialCumulative[i + 1] = radialCumulative[i] + radialStep/6.0*(f0*f0 + 4.0*f1*f1 + f2*f2);
+  }
+
+  ///// the lobes
+  // each lobe runs from the last point before a node to the first point after the next node
+  radialLobes.clear();
+  RadialLobe lobe;
+  lobe.first = 0;
+  lobe.peak = 0;
+  for(unsigned int i = 1; i <= intervals; i++)
+  {
+    if(fabs(radialValues[i]) > fabs(radialValues[lobe.peak]))
+      lobe.peak = i;
+    if(i == intervals || radialValues[i]*radialValues[i + 1] < 0.0)
+    {
+      lobe.last = i == intervals ? i : i + 1;
+      lobe.positive = radialValues[lobe.peak] > 0.0;
+      radialLobes.push_back(lobe);
+      lobe.first = i;
+      lobe.peak = i + 1;
+    }
+  }
+}
+
+///// findRadii ///////////////////////////////////////////////////////////////
+template <class T> void OrbitalThread::findRadii(const T value, std::vector<float>& radii, std::vector<bool>& positive)
+/// Finds all radii where the absolute value of the radial part equals value.
+/// Every lobe of the table has at most one such radius on each side of its 
+/// peak. They are bracketed by a bisection over the tabulated values and 
+/// refined by Newton-Raphson steps on the spline. Beyond the table the last 
+/// lobe decreases monotonically and the radius is bracketed by doubling steps
+/// and refined by bisection on the radial function itself. The signs of the
+/// radial part at the radii are returned in positive.
+{
+  radii.clear();
+  positive.clear();
+  if(!(value > 0))
+    return;
+  const double target = static_cast<double>(value);
+
+  for(std::vector<RadialLobe>::const_iterator it = radialLobes.begin(); it != radialLobes.end(); it++)
+  {
+    const double sign = it->positive ? 1.0 : -1.0;
+    if(sign*radialValues[it->peak] <= target)
+      continue;
+
+    // the rising side
+    if(sign*radialValues[it->first] < target)
+    {
+      unsigned int low = it->first;
+      unsigned int high = it->peak;
+      while(high - low > 1)
+      {
+        const unsigned int middle = (low + high)/2;
+        if(sign*radialValues[middle] < target)
+          low = middle;
+        else
+          high = middle;
+      }
+      radii.push_back(splineRoot(low, sign*target));
+      positive.push_back(it->positive);
+    }
+
+    // the falling side
+    if(sign*radialValues[it->last] < target)
+    {
+      unsigned int low = it->peak;
+      unsigned int high = it->last;
+      while(high - low > 1)
+      {
+        const unsigned int middle = (low + high)/2;
+        if(sign*radialValues[middle] < target)
+          high = middle;
+        else
+          low = middle;
+      }
+      radii.push_back(splineRoot(low, sign*target));
+      positive.push_back(it->positive);
+    }
+    else if(it + 1 == radialLobes.end())
+    {
+      // the last lobe extends beyond the table
+      const T tableEnd = static_cast<T>(radialStep*(radialValues.size() - 1));
+      T low = tableEnd;
+      T step = static_cast<T>(radialStep);
+      T high = low + step;
+      while(sign*radialFunction<T>(high) >= value)
+      {
+        low = high;
+        step *= 2;
+        high += step;
+        if(high > maximumExtent*tableEnd)
+          break;
+      }
+      for(unsigned int i = 0; i < maximumIterations && high - low > radialTolerance*high; i++)
+      {
+        const T middle = (low + high)/2;
+        if(sign*radialFunction<T>(middle) >= value)
+          low = middle;
+        else
+          high = middle;
+      }
+      radii.push_back(static_cast<float>((low + high)/2));
+      positive.push_back(it->positive);
+    }
+  }
+}
+
+///// splineRoot //////////////////////////////////////////////////////////////
+float OrbitalThread::splineRoot(const unsigned int interval, const double value)
+/// Returns the radius within the given interval of the radial table where the
+/// spline equals value. The values at the ends of the interval should bracket
+/// it. Uses Newton-Raphson steps, falling back to bisection when a step
+/// leaves the bracket.
+{
+  const double y0 = radialValues[interval];
+  const double y1 = radialValues[interval + 1];
+  const double c0 = radialCurvatures[interval];
+  const double c1 = radialCurvatures[interval + 1];
+  const bool rising = y1 > y0;
+
+  // t runs from 0 to 1 over the interval
+  double low = 0.0;
+  double high = 1.0;
+  double t = (value - y0)/(y1 - y0); // the linear interpolation as the first guess
+  for(unsigned int i = 0; i < maximumIterations; i++)
+  {
+    const double u = 1.0 - t;
+    const double f = u*y0 + t*y1 + (u*u*u - u)*c0 + (t*t*t - t)*c1 - value;
+    if((f < 0.0) == rising)
+      low = t;
+    else
+      high = t;
+    const double derivative = y1 - y0 - (3.0*u*u - 1.0)*c0 + (3.0*t*t - 1.0)*c1;
+    double newT = derivative != 0.0 ? t - f/derivative : -1.0;
+    if(newT <= low || newT >= high)
+      newT = 0.5*(low + high);
+    if(fabs(newT - t) < radialTolerance)
+    {
+      t = newT;
+      break;
+    }
+    t = newT;
+  }
+  return static_cast<float>(radialStep*(interval + t));
+}
+
+///// tabulateAngularPart ////////////////////////////////////////////////////
+void OrbitalThread::tabulateAngularPart()
+/// Tabulates the theta and phi dependent factors of the angular part and 
+/// their cumulative distributions, including the factor sin(theta) of the
+/// volume element. The angles are in degrees.
+{
+  const unsigned int l = qnOrbital;
+  const int m = qnMomentum;
+  const long double degToRad = Point3D<double>::DEGTORAD;
+  const long double normTheta = (m > 0 && m % 2 != 0 ? -1 : 1) * std::sqrt((2*l+1) * factorial<long double>(l-abs(m)) / (2 * factorial<long double>(l+abs(m))));
+
+  ///// theta
+  thetaStep = 180.0/angularIntervals;
+  thetaValues.resize(angularIntervals + 1);
+  for(unsigned int i = 0; i <= angularIntervals; i++)
+    thetaValues[i] = static_cast<double>(normTheta * associatedLegendre<long double>(std::cos(i*thetaStep*degToRad), abs(m), l));
+  tabulateCumulative(thetaValues, thetaStep, true, thetaCumulative);
+
+  ///// phi (the normalization is irrelevant for sampling)
+  phiStep = 360.0/angularIntervals;
+  phiValues.resize(angularIntervals + 1);
+  for(unsigned int i = 0; i <= angularIntervals; i++)
+  {
+    if(m == 0)
+      phiValues[i] = 1.0;
+    else if(m > 0)
+      phiValues[i] = sin(m*i*phiStep*Point3D<double>::DEGTORAD);
+    else
+      phiValues[i] = cos(m*i*phiStep*Point3D<double>::DEGTORAD);
+  }
+  tabulateCumulative(phiValues, phiStep, false, phiCumulative);
+}
+
+///// prepareSurface ////////////////////////////////////////////////////////
+void OrbitalThread::prepareSurface()
+/// Sets up the grid for the Surface type: a cube centered on the nucleus with
+/// surfaceSize(resolution) points in each direction. It extends one grid 
+/// spacing beyond the largest radius where |psi| can reach the surface level,
+/// so the isosurfaces are closed.
+{
+  // the largest absolute value of the angular part
+  double maxTheta = 0.0;
+  for(std::vector<double>::const_iterator it = thetaValues.begin(); it != thetaValues.end(); it++)
+  {
+    if(fabs(*it) > maxTheta)
+      maxTheta = fabs(*it);
+  }
+  const double maxY = maxTheta/sqrt(qnMomentum == 0 ? 2.0*Point3D<double>::PI : Point3D<double>::PI);
+
+  // the radius beyond which |psi| stays below the surface level in all directions
+  float extent = static_cast<float>(radialStep*(radialValues.size() - 1));
+  std::vector<float> radii;
+  std::vector<bool> positive;
+  if(maxY > 0.0)
+    findRadii<double>(surfaceLevel()/maxY, radii, positive);
+  if(!radii.empty())
+    extent = *std::max_element(radii.begin(), radii.end());
+  maximumRadius = extent;
+
+  // the grid
+  const unsigned int size = surfaceSize(resolution);
+  const float delta = 2.0f*extent/(size - 3);
+  gridPoints.setValues(size, size, size);
+  gridDelta.setValues(delta, delta, delta);
+  gridOrigin.setValues(-0.5f*(size - 1)*delta, -0.5f*(size - 1)*delta, -0.5f*(size - 1)*delta);
+  gridValues.assign(size*size*size, 0.0);
+}
+
+///// tabulateCumulative //////////////////////////////////////////////////////
+void OrbitalThread::tabulateCumulative(const std::vector<double>& values, const double step, const bool sinTheta, std::vector<double>& cumulative)
+/// Tabulates the cumulative distribution of the squares of the given values of
+/// an angular factor, multiplied by sin(theta) if requested. It uses the
+/// trapezoidal rule, which is consistent with the linear interpolation of
+/// inverseCumulative.
+{
+  cumulative.resize(values.size());
+  cumulative[0] = 0.0;
+  double previous = values[0]*values[0]*(sinTheta ? 0.0 : 1.0);
+  for(unsigned int i = 1; i < values.size(); i++)
+  {
+    const double current = values[i]*values[i]*(sinTheta ? fabs(sin(i*step*Point3D<double>::DEGTORAD)) : 1.0);
+    cumulative[i] = cumulative[i - 1] + 0.5*step*(previous + current);
+    previous = current;
+  }
+}
+
+///// inverseCumulative ///////////////////////////////////////////////////////
+double OrbitalThread::inverseCumulative(const std::vector<double>& cumulative, const double step, const double value)
+/// Returns the position where the tabulated cumulative distribution reaches 
+/// the given value, interpolating linearly. Returns the end of the table if
+/// it is never reached.
+{
+  if(value >= cumulative.back())
+    return step*(cumulative.size() - 1);
+  const std::vector<double>::const_iterator it = std::upper_bound(cumulative.begin(), cumulative.end(), value);
+  if(it == cumulative.begin())
+    return 0.0;
+  const unsigned int i = it - cumulative.begin();
+  const double fraction = (value - cumulative[i - 1])/(cumulative[i] - cumulative[i - 1]);
+  return step*(i - 1 + fraction);
+}
+
+///// interpolate /////////////////////////////////////////////////////////////
+double OrbitalThread::interpolate(const std::vector<double>& values, const double step, const double x)
+/// Returns the linearly interpolated value of a table at x.
+{
+  const double position = x/step;
+  unsigned int i = static_cast<unsigned int>(position);
+  if(i >= values.size() - 1)
+    return values.back();
+  const double fraction = position - i;
+  return (1.0 - fraction)*values[i] + fraction*values[i + 1];
+}
+
+///// radialPart //////////////////////////////////////////////////////////////
+template <class T> T OrbitalThread::radialPart(const T r)
+/// Returns the radial part of the orbital at r. It is interpolated from the
+/// table within its range and calculated directly beyond it.
+{
+  const T x = r/static_cast<T>(radialStep);
+  const unsigned int i = static_cast<unsigned int>(x);
+  if(r < 0 || i >= radialValues.size() - 1)
+    return radialFunction<T>(r);
+  const T t = x - i;
+  const T u = 1 - t;
+  return static_cast<T>(u*radialValues[i] + t*radialValues[i + 1] + (u*u*u - u)*radialCurvatures[i] + (t*t*t - t)*radialCurvatures[i + 1]);
+}
+
+///// radialFunction //////////////////////////////////////////////////////////
+template <class T> T OrbitalThread::radialFunction(const T r)
+/// Calculates the radial part of the orbital at r.
+{
+  const unsigned int n = qnPrincipal;
+  const unsigned int l = qnOrbital;
+  const T zna = static_cast<T>(atomNumber) / static_cast<T>(n) / abohr; // conversion factor for r->rho
+  const T normR = std::pow(2*zna, static_cast<T>(1.5)) * std::sqrt(factorial<T>(n-l-1)/2/n/factorial<T>(n+l)); // normalization factor for the radial part
+  const T rho = 2 * zna * r;
+  return normR * std::pow(rho, static_cast<int>(l)) * std::exp(-rho/2) * associatedLaguerre<T>(rho, 2*l+1, n-l-1);
+}
+
+///// cumulativeRadius ////////////////////////////////////////////////////////
+float OrbitalThread::cumulativeRadius(const double cumulative)
+/// Returns the radius within which the cumulative radial probability reaches
+/// the given value. Returns the end of the table if it is never reached.
+{
+  return static_cast<float>(inverseCumulative(radialCumulative, radialStep, cumulative));
+}
+
 ///// associatedLegendre //////////////////////////////////////////////////////
-float OrbitalThread::associatedLegendre(const float x, const int m, const unsigned int l)
+template <class T> T OrbitalThread::associatedLegendre(const T x, const int m, const unsigned int l)
 /// Calculates the associated Legendre polynomial P ^m _l (x).
 {
-  float prefactor = pow(1.0f - x*x, static_cast<float>(m)/2.0f) / pow(2.0f, static_cast<int>(l));
+  T prefactor = std::pow(1 - x*x, static_cast<T>(m)/2) / std::pow(static_cast<T>(2), static_cast<int>(l));
   int upperBound = 0;
   if(((l-m) % 2) == 0) // l-m is even
     upperBound = (l-m)/2;
   else // l-m is odd
     upperBound = (l-m-1)/2;
 
-  float result = 0.0f;
+  T result = 0;
   for(int j = 0; j <= upperBound; j++)
   {
-    float tempvar = pow(-1.0f, j)*factorial<float>(2*l-2*j);
-    tempvar /= factorial<float>(j)*factorial<float>(l-j)*factorial<float>(l-abs(m)-2*j);
-    tempvar *= pow(x, static_cast<int>(l-m-2*j));
+    T tempvar = (j % 2 == 0 ? 1 : -1)*factorial<T>(2*l-2*j);
+    tempvar /= factorial<T>(j)*factorial<T>(l-j)*factorial<T>(l-abs(m)-2*j);
+    tempvar *= std::pow(x, static_cast<int>(l-m-2*j));
     result +=  tempvar;
   }
   return prefactor*result;
 }
 
 ///// associatedLaguerre //////////////////////////////////////////////////////
-float OrbitalThread::associatedLaguerre(const float x, const int m, const unsigned int n)
+template <class T> T OrbitalThread::associatedLaguerre(const T x, const int m, const unsigned int n)
 /// Calculates the associated Laguerre polynomial L ^m _n (x).
 {  
   // from MathWorld: Rodrigues representation of the Laguerre polynomial (Arfken & Webers definition)
   if(n == 0)
-    return 1.0f;
-  float result = 0.0f;
+    return 1;
+  T result = 0;
   for(unsigned int j = 0; j <= n; j++)
-    result += pow(-1.0f, static_cast<int>(j)) * factorial<float>(n+m) / factorial<float>(n-j) / factorial<float>(m+j) / factorial<float>(j) * pow(x, static_cast<int>(j));
+    result += (j % 2 == 0 ? 1 : -1) * factorial<T>(n+m) / factorial<T>(n-j) / factorial<T>(m+j) / factorial<T>(j) * std::pow(x, static_cast<int>(j));
   return result;
 }
 
@@ -769,10 +1181,38 @@ template <class T> T OrbitalThread::factorial(const unsigned int number)
 }
 
 ///// random //////////////////////////////////////////////////////////////////
-float OrbitalThread::random(const float min, const float max)
-/// Returns a random floating point number between min and max.
+float OrbitalThread::random(Q_UINT64& state, const float min, const float max)
+/// Returns a random floating point number between min and max and advances the 
+/// state of the generator. It is the PCG32 generator by Melissa O'Neill 
+/// (XSH-RR output of a 64-bit linear congruential generator).
 {  
-  return min + static_cast<float>(rand())/RAND_MAX*(max - min);
+  const Q_UINT64 oldState = state;
+  state = oldState*6364136223846793005ULL + 1442695040888963407ULL;
+  const unsigned int shifted = static_cast<unsigned int>(((oldState >> 18) ^ oldState) >> 27);
+  const unsigned int rotation = static_cast<unsigned int>(oldState >> 59);
+  const unsigned int result = (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+  return min + static_cast<float>(result >> 8)/16777216.0f*(max - min); // 24 random bits fill the mantissa
+}
+
+///// randomStream ////////////////////////////////////////////////////////////
+Q_UINT64 OrbitalThread::randomStream(const unsigned int task) const
+/// Returns the initial state of the random number generator for the given 
+/// task (a row or a chunk). It only depends on the seed and the task, so a 
+/// seed reproduces the same points whichever worker calculates a task. The 
+/// state is scrambled with the SplitMix64 finalizer.
+{
+  Q_UINT64 result = (static_cast<Q_UINT64>(usedSeed) << 32) + task;
+  result = (result ^ (result >> 30))*0xbf58476d1ce4e5b9ULL;
+  result = (result ^ (result >> 27))*0x94d049bb133111ebULL;
+  return result ^ (result >> 31);
+}
+
+///// seed ////////////////////////////////////////////////////////////////////
+unsigned int OrbitalThread::seed() const
+/// Returns the seed of the random number generator used by the last run. It 
+/// differs from the seed passed to the constructor if that was 0.
+{
+  return usedSeed;
 }
 
 ///// largestResult ///////////////////////////////////////////////////////////
@@ -781,16 +1221,113 @@ template <class T> T OrbitalThread::largestResult(const unsigned int n, const un
 /// the given quantum numbers.
 {
   T partPhi = static_cast<T>(0.5641895835); // 1/sqrt(PI) // is partial specialization for local variables possible
-  T partTheta = sqrt(factorial<T>(2*l+1) * factorial<T>(l-abs(m)) / 2.0 / factorial<T>(l+abs(m))) * associatedLegendre(1.0f, abs(m), l);
+  T partTheta = std::sqrt(factorial<T>(2*l+1) * factorial<T>(l-abs(m)) / 2 / factorial<T>(l+abs(m))) * associatedLegendre<T>(1, abs(m), l);
   T rmax = static_cast<T>(3*n*n);
-  T partR = pow(2.0*Z/n/abohr, 1.5) * sqrt(factorial<T>(n-l-1)/2.0/n/factorial<T>(n+l)) * pow(2.0*Z/n/abohr*rmax, static_cast<int>(l)) * associatedLaguerre(2.0*Z/n/abohr*rmax, 2*l+1, n-l-1);
+  T rho = static_cast<T>(2.0*Z/n/abohr)*rmax;
+  T partR = std::pow(static_cast<T>(2.0*Z/n/abohr), static_cast<T>(1.5)) * std::sqrt(factorial<T>(n-l-1)/2/n/factorial<T>(n+l)) * std::pow(rho, static_cast<int>(l)) * associatedLaguerre<T>(rho, 2*l+1, n-l-1);
   return partPhi*partTheta*partR;
 }
 
+///// isSufficient ////////////////////////////////////////////////////////////
+template <class T> bool OrbitalThread::isSufficient(const long double condition)
+/// Returns whether the calculation can be done in the precision of T. The
+/// largest intermediate values should be finite and the loss of accuracy
+/// estimated by the given condition number should stay below maximumError.
+{
+  const unsigned int n = qnPrincipal;
+  const unsigned int l = qnOrbital;
+  if(!isFinite(factorial<T>(2*l+1))) // the largest factorial of the angular part
+    return false;
+  if(calculationType != AngularPart)
+  {
+    if(!isFinite(factorial<T>(n+2*l+1)) || !isFinite(largestResult<T>(n, l, qnMomentum, atomNumber))) // the largest factorial of the radial part
+      return false;
+  }
+  return std::numeric_limits<T>::epsilon()*condition < maximumError;
+}
+
+///// isFinite ////////////////////////////////////////////////////////////////
+template <class T> bool OrbitalThread::isFinite(const T value)
+/// Returns false if value is infinite or not a number.
+{
+  return std::fabs(value) <= std::numeric_limits<T>::max();
+}
+
+///// conditionNumber /////////////////////////////////////////////////////////
+long double OrbitalThread::conditionNumber()
+/// Returns an estimate of the relative error caused by the cancellation in the
+/// alternating sums of associatedLegendre and associatedLaguerre, in units of
+/// the machine epsilon. It is the ratio of the largest weighted sum of the
+/// absolute values of the terms to the largest weighted absolute value of the
+/// polynomial, where the weights are the other factors of the angular and the
+/// radial part. The polynomials are sampled in long double precision.
+{
+  const unsigned int samples = 200;
+  const unsigned int n = qnPrincipal;
+  const unsigned int l = qnOrbital;
+  const int m = abs(qnMomentum);
+  long double result = 1.0L;
+
+  ///// the angular part (symmetric in x)
+  long double maxTerms = 0.0L;
+  long double maxValue = 0.0L;
+  for(unsigned int i = 0; i <= samples; i++)
+  {
+    const long double x = static_cast<long double>(i)/samples;
+    const long double weight = std::pow(1.0L - x*x, static_cast<long double>(m)/2);
+    long double terms = 0.0L;
+    long double value = 0.0L;
+    for(unsigned int j = 0; 2*j + m <= l; j++)
+    {
+      const long double term = factorial<long double>(2*l-2*j) / (factorial<long double>(j)*factorial<long double>(l-j)*factorial<long double>(l-m-2*j)) * std::pow(x, static_cast<int>(l-m-2*j));
+      terms += term;
+      value += j % 2 == 0 ? term : -term;
+    }
+    if(weight*terms > maxTerms)
+      maxTerms = weight*terms;
+    if(weight*std::fabs(value) > maxValue)
+      maxValue = weight*std::fabs(value);
+  }
+  if(maxValue > 0.0L && maxTerms/maxValue > result)
+    result = maxTerms/maxValue;
+  if(calculationType == AngularPart)
+    return result;
+
+  ///// the radial part
+  // the terms of L(-rho) are the absolute values of the terms of L(rho)
+  const long double maxRho = 2.0L*atomNumber/n/abohr * 2.0L*n*n;
+  maxTerms = 0.0L;
+  maxValue = 0.0L;
+  for(unsigned int i = 0; i <= samples; i++)
+  {
+    const long double rho = maxRho*i/samples;
+    const long double weight = std::pow(rho, static_cast<int>(l)) * std::exp(-rho/2);
+    const long double terms = associatedLaguerre<long double>(-rho, 2*l+1, n-l-1);
+    const long double value = std::fabs(associatedLaguerre<long double>(rho, 2*l+1, n-l-1));
+    if(weight*terms > maxTerms)
+      maxTerms = weight*terms;
+    if(weight*value > maxValue)
+      maxValue = weight*value;
+  }
+  if(maxValue > 0.0L && maxTerms/maxValue > result)
+    result = maxTerms/maxValue;
+  return result;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Static Variables                                                    /////
 ///////////////////////////////////////////////////////////////////////////////
 
 const float OrbitalThread::abohr = 1.0f;
 const unsigned int OrbitalThread::updateSize = 1000;
+const long double OrbitalThread::maximumError = 1.0e-4L;
+const double OrbitalThread::tableStep = 0.02;
+const unsigned int OrbitalThread::minimumIntervals = 1024;
+const unsigned int OrbitalThread::maximumIntervals = 1048576;
+const double OrbitalThread::radialTolerance = 1.0e-7;
+const unsigned int OrbitalThread::maximumIterations = 60;
+const double OrbitalThread::maximumExtent = 100.0;
+const unsigned int OrbitalThread::angularIntervals = 4096;
+const unsigned int OrbitalThread::densityChunk = 1000;
+const unsigned int OrbitalThread::maximumGridPoints = 160;
 
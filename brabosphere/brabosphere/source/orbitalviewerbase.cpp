@@ -30,7 +30,9 @@
 ///// Header files ////////////////////////////////////////////////////////////
 
 // Qt header files
+#include <qcheckbox.h>
 #include <qcombobox.h>
+#include <qdir.h>
 #include <qlabel.h>
 #include <qlayout.h>
 #include <qlineedit.h>
@@ -50,6 +52,8 @@
 #include "orbitaloptionswidget.h"
 #include "orbitalthread.h"
 #include "orbitalviewerbase.h"
+#include "pointbuffer.h"
+#include "systeminfo.h"
 #include "version.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -91,6 +95,9 @@ OrbitalViewerBase::OrbitalViewerBase(QWidget* parent, const char* name, bool mod
   // set a validator
   options->LineEditProbability->setValidator(new QDoubleValidator(this));
 
+  // use all processors by default
+  options->SpinBoxThreads->setValue(static_cast<int>(SystemInfo::numProcessors()));
+
   // do some connections
   connect(options->SpinBoxN, SIGNAL(valueChanged(int)), this, SLOT(adjustL(int)));
   connect(options->SpinBoxL, SIGNAL(valueChanged(int)), this, SLOT(adjustM(int)));
@@ -168,11 +175,22 @@ void OrbitalViewerBase::update()
   options->ToolButtonCancel->setEnabled(true);
   // update the view
   updateColors();
+  // read the options of the calculation
+  calcKey.type = static_cast<unsigned int>(options->ComboBoxType->currentItem());
+  calcKey.atom = static_cast<unsigned int>(options->ComboBoxAtom->currentItem() + 1);
+  calcKey.n = static_cast<unsigned int>(options->SpinBoxN->value());
+  calcKey.l = static_cast<unsigned int>(options->SpinBoxL->value());
+  calcKey.m = static_cast<int>(options->SpinBoxM->value());
+  calcKey.resolution = static_cast<float>(options->SliderResolution->value());
+  calcKey.probability = options->LineEditProbability->text().toFloat();
+  calcKey.dots = static_cast<unsigned int>(options->SpinBoxDots->value());
+  calcKey.seed = static_cast<unsigned int>(options->SpinBoxSeed->value());
+  if(!OrbitalThread::usesRandomNumbers(calcKey.type))
+    calcKey.seed = 0; // the result is the same for every seed
   // setup the progressbar
   options->ProgressBar->setProgress(0);
-  const int resolution = options->SliderResolution->value();
-  const int numDots = options->SpinBoxDots->value();
-  switch(options->ComboBoxType->currentItem())
+  const int resolution = static_cast<int>(calcKey.resolution);
+  switch(calcKey.type)
   {
     case OrbitalThread::IsoProbability:
     case OrbitalThread::AccumulatedProbability:
@@ -180,23 +198,33 @@ void OrbitalViewerBase::update()
       options->ProgressBar->setTotalSteps(resolution*resolution);
       break;
     case OrbitalThread::Density: 
-      options->ProgressBar->setTotalSteps(numDots);
+      options->ProgressBar->setTotalSteps(calcKey.dots);
       break;
     case OrbitalThread::RadialPart: 
       options->ProgressBar->setTotalSteps(10*resolution);
       break; 
+    case OrbitalThread::Surface:
+      {
+        const int size = static_cast<int>(OrbitalThread::surfaceSize(calcKey.resolution));
+        options->ProgressBar->setTotalSteps(size*size*size);
+      }
+      break;
   }
+  view->clearSurfaces();
+  view->clearPoints(); // the previous thread has finished
+
+  // show a stored result if the options are reproducible
+  if(options->CheckBoxDiskCache->isChecked())
+    cache.setDirectory(QDir::convertSeparators(QDir::homeDirPath() + "/." + Version::appName.lower() + "/orbitals"));
+  else
+    cache.setDirectory(QString::null);
+  if((calcKey.seed != 0 || !OrbitalThread::usesRandomNumbers(calcKey.type)) && restoreResult())
+    return;
 
   // start a computation thread
-  calcThread = new OrbitalThread(this, view->getMutex(), view->getCoordinates(), 
-                                 static_cast<unsigned int>(options->ComboBoxType->currentItem()),
-                                 static_cast<unsigned int>(options->ComboBoxAtom->currentItem() + 1),
-                                 static_cast<unsigned int>(options->SpinBoxN->value()),
-                                 static_cast<unsigned int>(options->SpinBoxL->value()),
-                                 static_cast<int>(options->SpinBoxM->value()),
-                                 static_cast<float>(options->SliderResolution->value()),
-                                 options->LineEditProbability->text().toFloat(),
-                                 static_cast<unsigned int>(options->SpinBoxDots->value()));
+  calcThread = new OrbitalThread(this, view->getPoints(), calcKey.type, calcKey.atom, calcKey.n, calcKey.l, calcKey.m,
+                                 calcKey.resolution, calcKey.probability, calcKey.dots,
+                                 static_cast<unsigned int>(options->SpinBoxThreads->value()), calcKey.seed);
   calcThread->start(QThread::LowPriority);
 
   // update the scene every 100 ms
@@ -281,6 +309,17 @@ void OrbitalViewerBase::updateTypeOptions(int type)
             options->LabelDots->setEnabled(false);
             options->SliderDots->setEnabled(false);
             options->SpinBoxDots->setEnabled(false);
+            break;
+    case OrbitalThread::Surface:
+            options->LabelResolution->setEnabled(true);
+            options->SliderResolution->setEnabled(true);
+            options->LabelProbability->setEnabled(true);
+            options->LineEditProbability->setEnabled(true);
+            options->LabelDots->setEnabled(false);
+            options->SliderDots->setEnabled(false);
+            options->SpinBoxDots->setEnabled(false);
+            if(options->LineEditProbability->text().toFloat() > 0.1f) 
+              options->LineEditProbability->setText("0.0001");            
   }
 }
 
@@ -309,7 +348,12 @@ void OrbitalViewerBase::finishCalculation()
   if(!calcThread->finished())
     calcThread->wait(); // blocking wait
 
+  if(!calcThread->surfaceValues()->empty())
+    view->setSurfaces(calcThread->surfaceValues(), calcThread->surfacePoints(), calcThread->surfaceDelta(),
+                      calcThread->surfaceOrigin(), calcThread->surfaceLevel());
   view->setMaximumRadius(calcThread->boundingSphereRadius()); // this forces a zoomfit and a redraw
+  if(calcThread->completed())
+    storeResult();
 
   delete calcThread;
   calcThread = 0;
@@ -323,3 +367,61 @@ void OrbitalViewerBase::finishCalculation()
   timer->stop();
 }
 
+///// restoreResult ///////////////////////////////////////////////////////////
+bool OrbitalViewerBase::restoreResult()
+/// Shows the stored result for calcKey if available. Returns false if it has
+/// to be calculated.
+{
+  const OrbitalCache::Entry* entry = cache.find(calcKey);
+  if(entry == 0)
+    return false;
+
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+    view->getPoints()->append(phase, entry->points[phase]);
+  if(!entry->gridValues.empty())
+    view->setSurfaces(&entry->gridValues, entry->gridPoints, entry->gridDelta, entry->gridOrigin, entry->gridLevel);
+  view->setMaximumRadius(entry->radius); // this forces a zoomfit and a redraw
+
+  ///// update the widget
+  options->ToolButtonCancel->setEnabled(false);
+  options->ToolButtonUpdate->setEnabled(true);
+  return true;
+}
+
+///// storeResult /////////////////////////////////////////////////////////////
+void OrbitalViewerBase::storeResult()
+/// Stores the result of calcThread for reuse. As the points only depend on the
+/// seed that was actually used (and not on the number of threads), they are
+/// stored under that seed. Types that do not use random numbers are stored
+/// without a seed.
+{
+  OrbitalCache::Entry entry;
+  const PointBuffer* points = view->getPoints();
+  for(unsigned int phase = 0; phase < PointBuffer::PHASE_LAST; phase++)
+  {
+    const unsigned int numPoints = points->size(phase);
+    entry.points[phase].reserve(3*numPoints);
+    for(unsigned int first = 0; first < numPoints; first += PointBuffer::chunkSize)
+    {
+      const float* chunk = points->chunk(phase, first/PointBuffer::chunkSize);
+      const unsigned int count = numPoints - first < PointBuffer::chunkSize ? numPoints - first : PointBuffer::chunkSize;
+      entry.points[phase].insert(entry.points[phase].end(), chunk, chunk + 3*count);
+    }
+  }
+  entry.gridValues = *calcThread->surfaceValues();
+  entry.gridPoints = calcThread->surfacePoints();
+  entry.gridDelta = calcThread->surfaceDelta();
+  entry.gridOrigin = calcThread->surfaceOrigin();
+  entry.gridLevel = calcThread->surfaceLevel();
+  entry.radius = calcThread->boundingSphereRadius();
+
+  calcKey.seed = OrbitalThread::usesRandomNumbers(calcKey.type) ? calcThread->seed() : 0;
+  cache.insert(calcKey, entry);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Static Variables                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+OrbitalCache OrbitalViewerBase::cache;
+
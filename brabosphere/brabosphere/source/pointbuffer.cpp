@@ -0,0 +1,199 @@
+/***************************************************************************
+                       pointbuffer.cpp  -  description
+                             -------------------
+    begin                : Sun Oct 18 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+///// Comments ////////////////////////////////////////////////////////////////
+/*!
+  \class PointBuffer
+  \brief This class passes points from calculating threads to a drawing thread.
+
+  The points are separated by phase (their ID) and their coordinates are 
+  packed as x, y, z triplets of floats, so each chunk can be drawn directly as
+  a vertex array. The points are stored in chunks of fixed size which are 
+  never moved once allocated. The producers append points beyond the published ones and then
+  publish them by increasing the count atomically with a full memory barrier.
+  The consumer reads the count in the same way and can then access all
+  published points without locking, while new points are being appended.
+  The producers only wait for each other, never for the consumer.
+  Only the consumer may clear the buffer and only while no producer is
+  active. Points exceeding the capacity of maximumChunks chunks are dropped.
+*/
+/// \file
+/// Contains the implementation of the class PointBuffer.
+
+///// Header files ////////////////////////////////////////////////////////////
+
+// C++ header files
+#include <algorithm>
+#include <cassert>
+
+// Xbrabo header files
+#include "pointbuffer.h" // includes qmutex.h which defines Q_OS_WIN32
+
+// Platform dependent header files
+#ifdef Q_OS_WIN32
+  #define NOMINMAX // keeps std::min usable
+  #include <windows.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+///// Public Member Functions                                             /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// Constructor /////////////////////////////////////////////////////////////
+PointBuffer::PointBuffer()
+/// The default constructor.
+{
+  for(unsigned int phase = 0; phase < PHASE_LAST; phase++)
+  {
+    chunks[phase].assign(maximumChunks, static_cast<float*>(0));
+    published[phase] = 0;
+    appended[phase] = 0;
+  }
+}
+
+///// Destructor //////////////////////////////////////////////////////////////
+PointBuffer::~PointBuffer()
+/// The default destructor.
+{
+  clear();
+}
+
+///// append //////////////////////////////////////////////////////////////////
+void PointBuffer::append(const std::vector<Point3D<float> >& points)
+/// Appends the points and makes them visible to the consumer. Points with an
+/// ID of 0 have a negative phase, all others a positive one. Can be called by
+/// several producers at the same time.
+{
+  QMutexLocker locker(&appendMutex);
+  unsigned int previous[PHASE_LAST];
+  for(unsigned int phase = 0; phase < PHASE_LAST; phase++)
+    previous[phase] = appended[phase];
+  unsigned int dropped = 0;
+  for(std::vector<Point3D<float> >::const_iterator it = points.begin(); it != points.end(); it++)
+  {
+    const unsigned int phase = it->id() == 0 ? PHASE_NEGATIVE : PHASE_POSITIVE;
+    const unsigned int index = appended[phase]/chunkSize;
+    if(index >= maximumChunks)
+    {
+      dropped++;
+      continue;
+    }
+    if(chunks[phase][index] == 0)
+      chunks[phase][index] = new float[3*chunkSize];
+    float* point = chunks[phase][index] + 3*(appended[phase] % chunkSize);
+    point[0] = it->x();
+    point[1] = it->y();
+    point[2] = it->z();
+    appended[phase]++;
+  }
+  if(dropped > 0)
+    qDebug("PointBuffer::append: capacity exceeded, %d points dropped", dropped);
+  // the points and chunks are written before they are published
+  for(unsigned int phase = 0; phase < PHASE_LAST; phase++)
+    fetchAndAdd(published[phase], appended[phase] - previous[phase]);
+}
+
+///// append //////////////////////////////////////////////////////////////////
+void PointBuffer::append(const unsigned int phase, const std::vector<float>& coordinates)
+/// Appends points of the given phase from their packed coordinates (x, y, z)
+/// and makes them visible to the consumer. Can be called by several producers
+/// at the same time.
+{
+  assert(phase < PHASE_LAST);
+  assert(coordinates.size() % 3 == 0);
+
+  QMutexLocker locker(&appendMutex);
+  const unsigned int previous = appended[phase];
+  std::vector<float>::const_iterator it = coordinates.begin();
+  while(it != coordinates.end())
+  {
+    const unsigned int index = appended[phase]/chunkSize;
+    if(index >= maximumChunks)
+    {
+      qDebug("PointBuffer::append: capacity exceeded, %d points dropped", static_cast<int>(coordinates.end() - it)/3);
+      break;
+    }
+    if(chunks[phase][index] == 0)
+      chunks[phase][index] = new float[3*chunkSize];
+    // copy as many points as fit in the chunk
+    const unsigned int offset = appended[phase] % chunkSize;
+    const unsigned int count = std::min(chunkSize - offset, static_cast<unsigned int>(coordinates.end() - it)/3);
+    std::copy(it, it + 3*count, chunks[phase][index] + 3*offset);
+    it += 3*count;
+    appended[phase] += count;
+  }
+  // the points and chunks are written before they are published
+  fetchAndAdd(published[phase], appended[phase] - previous);
+}
+
+///// size ////////////////////////////////////////////////////////////////////
+unsigned int PointBuffer::size(const unsigned int phase) const
+/// Returns the number of points of a phase that can be accessed by the consumer.
+{
+  assert(phase < PHASE_LAST);
+  // the points are read after the count
+  return fetchAndAdd(const_cast<volatile unsigned int&>(published[phase]), 0);
+}
+
+///// chunk ///////////////////////////////////////////////////////////////////
+const float* PointBuffer::chunk(const unsigned int phase, const unsigned int index) const
+/// Returns the coordinates of the points of a chunk of a phase. Only the first
+/// size(phase) points of all chunks of the phase together are valid.
+{
+  assert(phase < PHASE_LAST);
+  assert(index < maximumChunks);
+  return chunks[phase][index];
+}
+
+///// clear ///////////////////////////////////////////////////////////////////
+void PointBuffer::clear()
+/// Removes all points. No producer may be active.
+{
+  for(unsigned int phase = 0; phase < PHASE_LAST; phase++)
+  {
+    published[phase] = 0;
+    appended[phase] = 0;
+    for(std::vector<float*>::iterator it = chunks[phase].begin(); it != chunks[phase].end() && *it != 0; it++)
+    {
+      delete[] *it;
+      *it = 0;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Private Member Functions                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// fetchAndAdd /////////////////////////////////////////////////////////////
+unsigned int PointBuffer::fetchAndAdd(volatile unsigned int& value, const unsigned int amount)
+/// Atomically adds the amount to the value and returns the original value.
+/// Memory accesses are not reordered across the call by either the compiler
+/// or the processor.
+{
+#ifdef Q_OS_WIN32
+  return static_cast<unsigned int>(InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(&value), static_cast<LONG>(amount)));
+#else
+  return __sync_fetch_and_add(&value, amount);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Static Variables                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+const unsigned int PointBuffer::chunkSize = 4096;
+const unsigned int PointBuffer::maximumChunks = 4096;
+
@@ -228,6 +228,16 @@ GLMoleculeView::GLTextureParameters PreferencesBase::getGLTextureParameters() co
   return result;
 }
 
+///// getGLSurfaceParameters //////////////////////////////////////////////////
+GLMoleculeView::GLSurfaceParameters PreferencesBase::getGLSurfaceParameters() const
+/// Returns a struct containing all parameters used for the calculation of
+/// isosurfaces in GLMoleculeView.
+{
+  GLMoleculeView::GLSurfaceParameters result;
+  result.engine = data.surfaceEngine;
+  return result;
+}
+
 ///// getPVMHosts /////////////////////////////////////////////////////////////
 QStringList PreferencesBase::getPVMHosts() const
 /// Returns the list of available PVM hosts.
@@ -268,6 +278,7 @@ void PreferencesBase::applyChanges()
   GLView::setParameters(getGLBaseParameters());
   GLSimpleMoleculeView::setParameters(getGLMoleculeParameters());
   GLMoleculeView::setParameters(getGLTextureParameters());
+  GLMoleculeView::setParameters(getGLSurfaceParameters());
   ///// Other visuals
   updateVisuals();
   ///// Undo/Redo options
@@ -386,6 +397,7 @@ void PreferencesBase::loadSettings()
   data.sliceQuality      = settings.readNumEntry(prefix + "slice_quality", 7); // 128x128 textures
   data.perspectiveProjection = settings.readBoolEntry(prefix + "perspective_projection", true);
   data.use3DTextures     = CheckBoxVolumeHQ->isEnabled() ? settings.readBoolEntry(prefix + "high_quality_volumes", true) : false;
+  data.surfaceEngine     = settings.readNumEntry(prefix + "surface_engine", 1); // flying edges
 
   ///// PVM
   data.pvmHosts          = settings.readListEntry(prefix + "pvm_hosts");
@@ -472,6 +484,7 @@ void PreferencesBase::saveSettings()
   settings.writeEntry(prefix + "slice_quality", static_cast<int>(data.sliceQuality));
   settings.writeEntry(prefix + "perspective_projection", data.perspectiveProjection);
   settings.writeEntry(prefix + "high_quality_volumes", data.use3DTextures);
+  settings.writeEntry(prefix + "surface_engine", static_cast<int>(data.surfaceEngine));
   ///// PVM
   settings.writeEntry(prefix + "pvm_hosts", data.pvmHosts);
 
@@ -921,6 +934,7 @@ void PreferencesBase::makeConnections()
   connect(CheckBoxSmooth, SIGNAL(clicked()), this, SLOT(changed()));
   connect(CheckBoxDepthCue, SIGNAL(clicked()), this, SLOT(changed()));
   connect(CheckBoxVolumeHQ, SIGNAL(clicked()), this, SLOT(changed()));
+  connect(ComboBoxSurfaceEngine, SIGNAL(activated(int)), this, SLOT(changed()));
   connect(ButtonGroupLightPosition, SIGNAL(clicked(int)), this, SLOT(changed()));
   connect(ColorButtonLight, SIGNAL(newColor(QColor*)), this, SLOT(changed()));
   connect(SliderSpecular, SIGNAL(valueChanged(int)), this, SLOT(changed()));
@@ -1148,6 +1162,7 @@ void PreferencesBase::saveWidgets()
   data.materialShininess = SliderShininess->value();
   data.perspectiveProjection = RadioButtonPerspective->isChecked();
   data.use3DTextures = CheckBoxVolumeHQ->isChecked();
+  data.surfaceEngine = ComboBoxSurfaceEngine->currentItem();
 
   ///// PVM
   data.pvmHosts.clear();
@@ -1227,6 +1242,7 @@ void PreferencesBase::restoreWidgets()
   if(CheckBoxVolumeHQ->isEnabled())
     CheckBoxVolumeHQ->setChecked(data.use3DTextures);
   updateSliderSlices();
+  ComboBoxSurfaceEngine->setCurrentItem(data.surfaceEngine);
 
   ///// PVM
   ListViewPVMHosts->clear();
@@ -3002,27 +3002,10 @@ QStringList RelaxBase::generateBmatInput()
   unsigned int a,b,c,d, numba, numbb, numbc, numbd;
   for(unsigned int i = 0; i < atoms->count(); i++)
   {
-    ///// determine the neighbours
+    ///// determine the neighbours (in order of increasing index, so the input only depends on the geometry)
     vector<unsigned int> neighbours;
-    for(unsigned int bond = 0; bond < first->size(); bond++)
-    {
-      const unsigned int atom1 = first->operator[](bond);
-      const unsigned int atom2 = second->operator[](bond);
-      if(atom1 == i)
-        neighbours.push_back(atom2);
-      else if(atom2 == i)
-        neighbours.push_back(atom1);
-    }
-    if(neighbours.size() != atoms->numberOfBonds(i))
-    {
-      qDebug("Number of neighbours is not equal to number of bonds");
-      qDebug("neighbours.size() = %d", static_cast<int>(neighbours.size()));
-      qDebug("numberOfBonds() = %d", atoms->numberOfBonds(i));
-      qDebug("first.size() = %d", static_cast<int>(first->size()));
-      for(unsigned int bond = 0; bond < first->size(); bond++)
-        qDebug("bond found between atoms %d and %d", first->operator[](bond), second->operator[](bond));
-      qFatal("atom = %d",i);
-    }
+    for(unsigned int bond = 0; bond < atoms->numberOfBonds(i); bond++)
+      neighbours.push_back(atoms->bondedAtom(i, bond));
 
     ///// determine the environment
     ///// unsupported cases are: 10. 4-ring                  (C1234)
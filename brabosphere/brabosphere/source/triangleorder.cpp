@@ -0,0 +1,218 @@
+/***************************************************************************
+                      triangleorder.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+///// Comments ////////////////////////////////////////////////////////////////
+/*!
+  \class TriangleOrder
+  \brief This class reorders the triangles of a mesh for vertex cache locality.
+
+  It implements the linear-speed vertex cache optimisation by Tom Forsyth.
+  Each vertex gets a score depending on its position in a modelled LRU cache
+  and on the number of triangles still using it. The triangle with the highest
+  sum of vertex scores among those using the cached vertices is added next.
+  The vertices within a triangle keep their order, so the orientation of the
+  triangles is unchanged.
+  The quality of an order is expressed as the average cache miss ratio (ACMR),
+  the number of vertex cache misses per triangle for a FIFO cache. It lies
+  between about 0.5 (optimal) and 3.0 (no reuse at all).
+*/
+/// \file
+/// Contains the implementation of the class TriangleOrder.
+
+///// Header files ////////////////////////////////////////////////////////////
+
+// C++ header files
+#include <cassert>
+#include <cmath>
+
+// Xbrabo header files
+#include "triangleorder.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///// Public Member Functions                                             /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// optimize ////////////////////////////////////////////////////////////////
+void TriangleOrder::optimize(const std::vector<unsigned int>& input, const unsigned int numVertices, std::vector<unsigned int>& output)
+/// Reorders the triangles given by the vertex indices in \a input (3 per
+/// triangle) for vertex cache locality. The result is stored in \a output.
+/// \a numVertices is the number of vertices used by the triangles.
+{
+  assert(&input != &output);
+  assert(input.size() % 3 == 0);
+
+  const unsigned int numTriangles = input.size()/3;
+  output.clear();
+  output.reserve(input.size());
+
+  ///// list the triangles using each vertex
+  // the active triangles of vertex v are vertexTriangles[firstTriangle[v] ... firstTriangle[v] + remaining[v] - 1]
+  std::vector<unsigned int> firstTriangle(numVertices + 1, 0);
+  for(unsigned int i = 0; i < input.size(); i++)
+    firstTriangle[input[i] + 1]++;
+  std::vector<unsigned int> remaining(numVertices);
+  for(unsigned int v = 0; v < numVertices; v++)
+  {
+    remaining[v] = firstTriangle[v + 1];
+    firstTriangle[v + 1] += firstTriangle[v];
+  }
+  std::vector<unsigned int> vertexTriangles(input.size());
+  std::vector<unsigned int> fillPosition(firstTriangle.begin(), firstTriangle.end() - 1);
+  for(unsigned int i = 0; i < input.size(); i++)
+    vertexTriangles[fillPosition[input[i]]++] = i/3;
+
+  ///// initial scores
+  std::vector<int> cachePosition(numVertices, -1);
+  std::vector<float> score(numVertices);
+  for(unsigned int v = 0; v < numVertices; v++)
+    score[v] = vertexScore(-1, remaining[v]);
+  std::vector<float> triangleScore(numTriangles);
+  std::vector<bool> added(numTriangles, false);
+  int bestTriangle = -1;
+  float bestScore = -1.0f;
+  for(unsigned int t = 0; t < numTriangles; t++)
+  {
+    triangleScore[t] = score[input[3*t]] + score[input[3*t + 1]] + score[input[3*t + 2]];
+    if(triangleScore[t] > bestScore)
+    {
+      bestScore = triangleScore[t];
+      bestTriangle = t;
+    }
+  }
+
+  ///// add the triangles one by one
+  std::vector<unsigned int> cache, newCache;
+  cache.reserve(cacheSize + 3);
+  newCache.reserve(cacheSize + 3);
+  unsigned int scanPosition = 0;
+  for(unsigned int n = 0; n < numTriangles; n++)
+  {
+    if(bestTriangle < 0)
+    {
+      // none of the cached vertices is used by a remaining triangle
+      while(added[scanPosition])
+        scanPosition++;
+      bestTriangle = scanPosition;
+    }
+
+    // add the triangle and remove it from the lists of its vertices
+    const unsigned int* triangle = &input[3*bestTriangle];
+    added[bestTriangle] = true;
+    newCache.clear();
+    for(unsigned int i = 0; i < 3; i++)
+    {
+      const unsigned int v = triangle[i];
+      output.push_back(v);
+      unsigned int* first = &vertexTriangles[firstTriangle[v]];
+      unsigned int j = 0;
+      while(first[j] != static_cast<unsigned int>(bestTriangle))
+        j++;
+      first[j] = first[--remaining[v]];
+      first[remaining[v]] = bestTriangle;
+      newCache.push_back(v);
+    }
+
+    // the vertices of the triangle move to the front of the LRU cache
+    for(std::vector<unsigned int>::const_iterator it = cache.begin(); it != cache.end(); it++)
+    {
+      if(*it != triangle[0] && *it != triangle[1] && *it != triangle[2])
+        newCache.push_back(*it);
+    }
+    cache.swap(newCache);
+    for(unsigned int i = 0; i < cache.size(); i++)
+    {
+      const int position = i < static_cast<unsigned int>(cacheSize) ? static_cast<int>(i) : -1;
+      cachePosition[cache[i]] = position;
+      score[cache[i]] = vertexScore(position, remaining[cache[i]]);
+    }
+
+    // update the scores of the triangles using the cached and evicted vertices and select the best one
+    bestTriangle = -1;
+    bestScore = -1.0f;
+    for(std::vector<unsigned int>::const_iterator it = cache.begin(); it != cache.end(); it++)
+    {
+      for(unsigned int i = firstTriangle[*it]; i < firstTriangle[*it] + remaining[*it]; i++)
+      {
+        const unsigned int t = vertexTriangles[i];
+        triangleScore[t] = score[input[3*t]] + score[input[3*t + 1]] + score[input[3*t + 2]];
+        if(triangleScore[t] > bestScore)
+        {
+          bestScore = triangleScore[t];
+          bestTriangle = t;
+        }
+      }
+    }
+    if(cache.size() > static_cast<unsigned int>(cacheSize))
+      cache.resize(cacheSize);
+  }
+}
+
+///// missRatio ///////////////////////////////////////////////////////////////
+float TriangleOrder::missRatio(const std::vector<unsigned int>& indices, const unsigned int vertices)
+/// Returns the average number of vertex cache misses per triangle when drawing
+/// the given triangles with a FIFO cache of size simulatedCacheSize.
+{
+  if(indices.empty())
+    return 0.0f;
+
+  // a vertex is present if less than simulatedCacheSize misses occurred after it was loaded
+  std::vector<unsigned int> loadTime(vertices, 0); // 0 means never loaded
+  unsigned int misses = 0;
+  for(std::vector<unsigned int>::const_iterator it = indices.begin(); it != indices.end(); it++)
+  {
+    assert(*it < vertices);
+    if(loadTime[*it] == 0 || misses - loadTime[*it] >= simulatedCacheSize)
+      loadTime[*it] = ++misses;
+  }
+  return static_cast<float>(misses)/(indices.size()/3);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Private Member Functions                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// Constructor /////////////////////////////////////////////////////////////
+TriangleOrder::TriangleOrder()
+/// The default constructor. Made private to inhibit instantations.
+{
+}
+
+///// vertexScore /////////////////////////////////////////////////////////////
+float TriangleOrder::vertexScore(const int cachePosition, const unsigned int numTriangles)
+/// Returns the score of a vertex at the given position in the modelled cache
+/// (-1 if not present) and used by the given number of remaining triangles.
+{
+  if(numTriangles == 0)
+    return -1.0f; // no triangles left
+
+  float result = 0.0f;
+  if(cachePosition >= 0)
+  {
+    if(cachePosition < 3)
+      result = 0.75f; // used by the last triangle, a fixed score discourages strips
+    else
+      result = pow(1.0f - static_cast<float>(cachePosition - 3)/(cacheSize - 3), 1.5f);
+  }
+  // boost vertices with few remaining triangles to get rid of lone triangles
+  return result + 2.0f/sqrt(static_cast<float>(numTriangles));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Static Variables                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+const int TriangleOrder::cacheSize = 32;
+const unsigned int TriangleOrder::simulatedCacheSize = 16;
+
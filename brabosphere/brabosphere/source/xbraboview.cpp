@@ -960,6 +960,7 @@ void XbraboView::popup()
   popup->insertSeparator();
   popup->insertItem(tr("Select all"), MoleculeView, SLOT(selectAllCommand()));
   popup->insertItem(tr("Select none"), MoleculeView, SLOT(unselectAllCommand()));
+  const int ID_SELECT_NEIGHBOURS = popup->insertItem(tr("Select within distance..."), MoleculeView, SLOT(selectNeighboursCommand()));
   popup->insertSeparator();
   popup->insertItem(IconSets::getIconSet(IconSets::SetupGlobal), tr("Setup global"),this, SLOT(setupGlobalCommand()));
   popup->insertItem(IconSets::getIconSet(IconSets::SetupBrabo), tr("Setup energy && Forces"),this, SLOT(setupBraboCommand()));
@@ -1022,6 +1023,8 @@ void XbraboView::popup()
     popup->setItemEnabled(ID_ALTER_CARTESIAN, false);
     popup->setItemEnabled(ID_MOLECULE_DELETE, false);
   }
+  if(MoleculeView->selectedAtoms() == 0)
+    popup->setItemEnabled(ID_SELECT_NEIGHBOURS, false);
   if(MoleculeView->selectedAtoms() < 2 || MoleculeView->selectedAtoms() > 4)
     popup->setItemEnabled(ID_ALTER_INTERNAL, false);
 
@@ -24,6 +24,7 @@
 ///// Forward class declarations & header files ///////////////////////////////
 
 // STL header files
+#include <map>
 #include <vector>
 using std::vector;
 
@@ -56,7 +57,10 @@ class AtomSet
     void addAtom(const Point3D<double>& location, const unsigned int atomicNumber, const int index = -1);         // adds an atom at position index
     void addAtom(const double x, const double y, const double z, const unsigned int atomicNumber, const QColor color, const int index = -1);    // adds an atom at position index with a special color
     void addAtom(const double x, const double y, const double z, const unsigned int atomicNumber, const int index = -1);    // adds an atom at position index
+    void addAtoms(const vector<Point3D<double> >& locations, const vector<QColor>& atomColors, const int index = -1); // adds a block of atoms at position index with special colors
+    void addAtoms(const vector<Point3D<double> >& locations, const int index = -1); // adds a block of atoms at position index
     void removeAtom(const unsigned int index);    // removes an atom
+    void removeAtoms(const vector<unsigned int>& indices);  // removes a set of atoms
     void addPointCharge(const double x, const double y, const double z, const double charge, const unsigned int atomicNumber = 0);          // adds a point charge
     void removePointCharges();          // removes all point charges
 
@@ -71,6 +75,9 @@ class AtomSet
     void changeBond(const double amount, const unsigned int movingAtom, const unsigned int secondAtom, const bool includeNeighbours = false);         // changes a bond length
     void changeAngle(const double amount, const unsigned int movingAtom, const unsigned int centralAtom, const unsigned int lastAtom, const bool includeNeighbours = false);        // changes a valence angle
     void changeTorsion(const double amount, const unsigned int movingAtom, const unsigned int secondAtom, const unsigned int thirdAtom, const unsigned int fourthAtom, const bool includeNeighbours = false);     // changes a torsion angle
+    void translateAtoms(const vector<unsigned int>& indices, const double dx, const double dy, const double dz); // translates a set of atoms
+    void displaceAtoms(const vector<unsigned int>& indices, const vector<Point3D<double> >& displacements); // displaces each atom of a set by its own amount
+    void transformAtoms(const vector<unsigned int>& indices, const double* rotation, const Point3D<double>& center); // rotates a set of atoms around a center
     void transferCoordinates(const AtomSet* source);        // copies the coordinates from another AtomSet
 
     ///// public member functions for retrieving data
@@ -80,25 +87,42 @@ class AtomSet
     double y(const unsigned int index) const;     // returns the y-coordinate for atom index
     double z(const unsigned int index) const;     // returns the z-coordinate for atom index
     unsigned int atomicNumber(const unsigned int index) const;  // returns the atomic number for atom index
+    const double* xCoordinates() const; // returns the x-coordinates of all atoms
+    const double* yCoordinates() const; // returns the y-coordinates of all atoms
+    const double* zCoordinates() const; // returns the z-coordinates of all atoms
+    const unsigned char* atomicNumbers() const;   // returns the atomic numbers of all atoms
     QColor color(const unsigned int index) const; // returns the color of the specified atom
+    const unsigned short* paletteEntries() const; // returns the palette entries of the colors of all atoms
+    unsigned int paletteSize() const;   // returns the number of colors in the palette
+    QColor paletteColor(const unsigned int entry) const;    // returns a color of the palette
     vector<unsigned int> usedAtomicNumbers() const;   // returns a sorted list of all the used atomic numbers
     void bonds(vector<unsigned int>*& first, vector<unsigned int>*& second);    // returns a list of bonds between the atoms
     unsigned int numberOfBonds(const unsigned int index) const; // returns the number of bonds for an atom
+    unsigned int bondedAtom(const unsigned int index, const unsigned int bond) const; // returns an atom bonded to an atom
     bool isLinear() const;              // returns true if the atoms form a linear molecule
     bool isChanged() const;             // returns true if the AtomSet has changed
+    unsigned int geometryVersion() const;         // returns a number that changes each time the geometry changes
     double dx(const unsigned int index) const;    // returns the x-component of the force on atom index
     double dy(const unsigned int index) const;    // returns the y-component of the force on atom index
     double dz(const unsigned int index) const;    // returns the z-component of the force on atom index
     double bond(const unsigned int atom1, const unsigned int atom2) const;      // returns the distance 1-2
     double angle(const unsigned int atom1, const unsigned int atom2, const unsigned int atom3) const;         // returns the angle 1-2-3
     double torsion(const unsigned int atom1, const unsigned int atom2, const unsigned int atom3, const unsigned int atom4) const; // returns the torsion angle 1-2-3-4
+    void bondValues(const vector<unsigned int>& definitions, vector<double>& values) const;     // calculates the distances of a list of atom pairs
+    void angleValues(const vector<unsigned int>& definitions, vector<double>& values) const;    // calculates the valence angles of a list of atom triplets
+    void torsionValues(const vector<unsigned int>& definitions, vector<double>& values) const;  // calculates the torsion angles of a list of atom quadruplets
+    void outOfPlaneValues(const vector<unsigned int>& definitions, vector<double>& values) const; // calculates the out-of-plane angles of a list of atom quadruplets
     double charge(const ChargeType type, const unsigned int index) const;// the charge on atom index
     bool hasCharges(const ChargeType type) const; // returns true if charges of the specified type are present
     QString chargesSCF(const ChargeType type) const;        // Returns the type of calculation used for the determination of the charges
     QString chargesDensity(const ChargeType type) const;    // Returns the density from which the charges were determined
     bool hasForces() const;             // returns if forces are present
     Point3D<float> rotationCenter() const;        // returns the center around which the molecule can best be rotated
-    bool needsExtendedFormat();         // returns true if the coordinates need to be written in BRABO's extended format in order to prevent clipping
+    double boundingSphereRadius() const;          // returns the radius of the sphere around the rotation center containing all atoms
+    bool needsExtendedFormat() const;   // returns true if the coordinates need to be written in BRABO's extended format in order to prevent clipping
+    vector<unsigned int> atomsInSphere(const Point3D<double>& center, const double radius) const; // returns the atoms within a distance of a point
+    vector<unsigned int> nearestAtoms(const Point3D<double>& point, const unsigned int number) const;  // returns the atoms closest to a point
+    vector<unsigned int> atomsAlongRay(const Point3D<double>& origin, const Point3D<double>& direction, const double radius) const; // returns the atoms within a distance of a ray
     unsigned int ramSize() const;       // returns the size of the class in bytes
     unsigned int countPointCharges() const;       // returns the number of point charges
     Point3D<double> pointChargeCoordinates(const unsigned int index) const;     // returns the coordinates for point charge index
@@ -119,23 +143,107 @@ class AtomSet
     static QColor stdColor(const unsigned int atom);        // returns the standard color for atomic number atom
 
   private:
+    // private enums
+    enum ICType{IC_BOND, IC_ANGLE, IC_TORSION, IC_OUTOFPLANE};  ///< The types of internal coordinates that can be calculated in a batch
+
+    // private structs
+    struct BondCells
+    /// The atoms divided over cubic cells for finding the bonds and for the
+    /// spatial queries.
+    {
+      unsigned int numX;                ///< the number of cells in the x-direction
+      unsigned int numY;                ///< the number of cells in the y-direction
+      unsigned int numZ;                ///< the number of cells in the z-direction
+      double minX;                      ///< the x-coordinate of the corner of the first cell
+      double minY;                      ///< the y-coordinate of the corner of the first cell
+      double minZ;                      ///< the z-coordinate of the corner of the first cell
+      vector< vector<unsigned int> > atoms; ///< the indices of the atoms in each cell
+      vector<unsigned int> cellOfAtom;  ///< the cell of each atom (noCell for atoms without bonds)
+    };
+
+    struct GeometryCache
+    /// Results derived from the geometry. Each one is valid as long as its
+    /// version is equal to the current geometry version.
+    {
+      unsigned int boxVersion;          ///< the version of boxMin and boxMax
+      unsigned int spatialCellsVersion; ///< the version of spatialCells
+      unsigned int radiusVersion;       ///< the version of radius
+      double radius;                    ///< the radius of the bounding sphere
+      unsigned int usedElementsVersion; ///< the version of usedElements
+      vector<unsigned int> usedElements;///< the sorted atomic numbers present
+      unsigned int linearVersion;       ///< the version of linear
+      bool linear;                      ///< whether the atoms are on a line
+    };
+
+    // private classes
+    class BondWorker;
+    friend class BondWorker;
+    class ICWorker;
+    friend class ICWorker;
+
     // private member functions
     void setChanged(const bool state = true);     // sets the 'changed' property
     void setGeometryChanged();          // indicates the geometry has changed
-    bool addBondList(const unsigned int callingAtom, const unsigned int startAtom, const unsigned int endAtom1, const unsigned int endAtom2, std::vector<unsigned int>* result);     // returns a list of all atoms bonded to startAtom
+    void setAtomMoved(const unsigned int index);  // indicates the bonds of an atom have to be recalculated
+    void setBondsChanged();             // indicates all bonds have to be recalculated
+    void insertBondAtoms(const unsigned int index, const unsigned int number);  // updates the bonds for atoms inserted at position index
+    void removeBondAtoms(const vector<bool>& removed);  // updates the bonds for the removal of a set of atoms
+    void shiftBondIndices(const unsigned int first, const int amount);  // changes the atom indices used by the bonds
+    void updateNeighbours() const;      // updates the bonded atoms of each atom
+    void buildNeighbours() const;       // rebuilds the bonded atoms of each atom from the bonds
+    void addBond(const unsigned int atom1, const unsigned int atom2) const; // adds a bond to the bonded atoms of both atoms
+    void expandNeighbours() const;      // gives the list of bonded atoms of each atom free positions again
+    void insertNeighbour(const unsigned int atom, const unsigned int neighbour) const; // adds an atom to the sorted list of bonded atoms of an atom
+    void removeNeighbour(const unsigned int atom, const unsigned int neighbour) const; // removes an atom from the sorted list of bonded atoms of an atom
+    void updateBondList();              // updates the bonds from the bonded atoms of each atom
+    bool addBondList(const unsigned int startAtom, const unsigned int endAtom1, const unsigned int endAtom2, std::vector<unsigned int>* result);     // returns a list of all atoms bonded to startAtom
     void clearProperties();             // clears the properties
-    void updateBoxDimensions();         // updates the smallest box surrounding the atoms
-    void addBonds(const vector<unsigned int>* atomList1, const vector<unsigned int>* atomList2);    // calculates all bonds between the atoms in the 2 list
+    void updateBoxDimensions() const;   // updates the smallest box surrounding the atoms
+    void addBonds(const vector<unsigned int>* atomList1, const vector<unsigned int>* atomList2, vector<unsigned int>& first, vector<unsigned int>& second) const;    // calculates all bonds between the atoms in the 2 lists
+    void addPlaneBonds(const BondCells& cells, const unsigned int cellZ, vector<unsigned int>& first, vector<unsigned int>& second) const; // calculates all bonds of the atoms in a plane of cells
+    void findAllBonds() const;          // recalculates all bonds
+    void updateBonds() const;           // recalculates the bonds of the moved atoms
+    void setupCells(BondCells& cells) const; // divides the box surrounding the atoms into empty cells
+    unsigned int bondCell(const unsigned int index) const;  // returns the cell containing an atom
+    void updateSpatialCells() const;    // divides all atoms over the cells for the spatial queries
+    void resetPalette();                // removes all custom colors from the palette
+    unsigned short findPaletteEntry(const QColor& color, const unsigned int atomicNumber); // returns the palette entry for a color, adding it if needed
+    void compactPalette();              // removes the unused custom colors from the palette
+    static unsigned int cellIndex(const BondCells& cells, const double x, const double y, const double z); // returns the cell containing a point
+    static unsigned int cellCoordinate(const double value, const double minValue, const unsigned int numCells); // returns the cell containing a coordinate along one axis
+    bool isBonded(const unsigned int atom1, const unsigned int atom2) const;  // returns whether two atoms are bonded
+    double bondValue(const unsigned int* atoms) const;      // returns the distance between 2 atoms
+    double angleValue(const unsigned int* atoms) const;     // returns the valence angle of 3 atoms
+    double torsionValue(const unsigned int* atoms) const;   // returns the torsion angle of 4 atoms
+    double outOfPlaneValue(const unsigned int* atoms) const;  // returns the out-of-plane angle of 4 atoms
+    void icValues(const unsigned int type, const vector<unsigned int>& definitions, vector<double>& values) const; // calculates a list of internal coordinates, in parallel for long lists
+    void icValueRange(const unsigned int type, const vector<unsigned int>& definitions, vector<double>& values, const unsigned int first, const unsigned int last) const; // calculates a range of a list of internal coordinates
+    static unsigned int icSize(const unsigned int type);    // returns the number of atoms defining an internal coordinate
 
     // private member data
     unsigned int numAtoms;              ///< the number of atoms
     bool changed;                       ///< = true if anything changed
 
-    vector<Point3D<double> > coords;    ///< Cartesian coordinates of the atoms with the atomic numbers as the ID's
-    vector<QColor> colors;              ///< Colors of the atoms
+    vector<double> coordsX;             ///< The x-coordinates of the atoms
+    vector<double> coordsY;             ///< The y-coordinates of the atoms
+    vector<double> coordsZ;             ///< The z-coordinates of the atoms
+    vector<unsigned char> elements;     ///< The atomic numbers of the atoms (0 for unknown atoms)
+    vector<unsigned short> colorEntries; ///< The palette entries of the colors of the atoms
+    vector<QColor> palette;             ///< The standard colors of the elements followed by the custom colors
+    std::map<unsigned int, unsigned short> customColors; ///< The palette entries of the custom colors by RGB value
     vector<Point3D<double> >* forces;   ///< Forces on the atoms
-    vector<unsigned int> bonds1;        ///< The first part of the bonds array
-    vector<unsigned int> bonds2;        ///< The second part of the bonds array
+    mutable vector<unsigned int> bonds1; ///< The first part of the bonds array
+    mutable vector<unsigned int> bonds2; ///< The second part of the bonds array
+    mutable bool dirtyBonds;            ///< If true all bonds need to be recalculated
+    mutable BondCells bondCells;        ///< The atoms divided over cells when the bonds were last calculated
+    mutable vector<unsigned int> movedAtoms; ///< The atoms whose bonds need to be recalculated
+    mutable vector<bool> isMovedAtom;   ///< Whether the bonds of each atom need to be recalculated
+    mutable vector<unsigned int> neighbourOffsets; ///< The position of the first bonded atom of each atom in neighbourList (numAtoms + 1 entries)
+    mutable vector<unsigned int> neighbourCounts; ///< The number of bonded atoms of each atom
+    mutable vector<unsigned int> neighbourList; ///< The atoms bonded to each atom, stored consecutively
+    mutable bool dirtyNeighbours;       ///< If true the bonded atoms need to be recalculated from the bonds
+    mutable bool dirtyBondList;         ///< If true the bonds need to be recalculated from the bonded atoms
+    mutable vector<unsigned int> changedBondAtoms; ///< The atoms whose bonds to atoms with a higher index changed since the bonds were last updated
     vector<double>* chargesMulliken;    ///< Contains the Mulliken charges if present
     vector<double>* chargesStockholder; ///< Contains the stockholder charges if present
     QString chargesMullikenSCF;         ///< The type of SCF method used for calculating the Mulliken charges (e.g. RHF/6-31G)
@@ -144,9 +252,22 @@ class AtomSet
     QString chargesStockholderDensity;  ///< The density used to calculate the stockholder charges
     Point3D<double>* boxMax;            ///< The first point of the smallest box surrounding the atoms (have to use pointers because point3d.h cannot be included)
     Point3D<double>* boxMin;            ///< The second point of the smallest box surrounding the atoms
-    bool dirtyBox;                      ///< If true the box needs to be recalculated
+    mutable BondCells spatialCells;     ///< All atoms divided over cells for the spatial queries
+    unsigned int version;               ///< The geometry version, incremented each time the geometry changes
+    mutable GeometryCache cache;        ///< Results derived from the geometry
     vector<Point3D<double> > coordsPC;  ///< Cartesian coordinates of the point charges
     vector<double> chargesPC;           ///< Contains the charges of the point charges
+
+    // private static constants
+    static const unsigned int parallelBondAtoms;  ///< The minimum number of atoms for finding the bonds with multiple threads
+    static const unsigned int parallelICValues;   ///< The minimum number of internal coordinates for calculating them with multiple threads
+    static const unsigned int movedAtomsRatio;    ///< All bonds are recalculated if more than 1 in this many atoms moved
+    static const unsigned int noCell;   ///< The cell of atoms that cannot have bonds
+    static const unsigned int neighbourSlack; ///< The number of extra positions in the neighbour list of each atom
+    static const double cellSize;       ///< The size of the cells for finding the bonds
+
+    // private static variables
+    static unsigned int lastVersion;    ///< The last geometry version given to any AtomSet, so equal versions mean equal geometries
 };
 
 #endif
@@ -32,6 +32,7 @@ class QDomElement;
 
 // Xbrabo forward class declarations
 class AtomSet;
+template <class T> class Point3D;
 
 // Xbrabo header files
 #include "glview.h"
@@ -101,6 +102,7 @@ class GLSimpleMoleculeView : public GLView
     void updateAtomSet(const bool reset = false); // updates the view when the atomset has changed
     void selectAll(const bool update = true);     // select all atoms
     void unselectAll(const bool update = true);   // unselect all atoms
+    void selectNeighbours(const double radius, const bool update = true); // adds the atoms near the selected atoms to the selection
 
   protected slots:
     void reorderShapes();               // orders the shapes based on opacity
@@ -159,12 +161,14 @@ class GLSimpleMoleculeView : public GLView
     void makeObjects();                 // generates the atom and bond shapes
     void changeObjects(const GLuint startList, const int numSlices);  // changes the atom and bond shapes
     void selectEntity(const QPoint position);     // selects the entity at the position
+    int pickAtom(const Point3D<double>& origin, const Point3D<double>& direction); // returns the first atom hit by a ray
     void centerMolecule();              // calculates the translations needed to have the molecule centered
     void updateMolecule();              // updates the display list for rendering atoms, bonds and forces
     void drawScene();                   // does the actual repainting of the OpenGL scene
     void drawMolecule();                // draws the atoms, bonds and forces in the OpenGL scene
     void drawAtoms(const unsigned int style, const bool useColors = true);      // does the actual drawing of the atoms
     void drawBonds(const unsigned int style, const bool useColors = true);      // does the actual drawing of the bonds
+    void makeColorTable(const bool grayscale, std::vector<GLubyte>& table) const; // converts the colors of the atoms for use by OpenGL
     void drawForces(const unsigned int style, const bool useColors = true);     // does the actual drawing of the forces
     void drawLabels();                  // draws the element names&numbers and possibly charges
     void drawICValue();                 // draws the value of the currently selected internal coordinate
@@ -184,6 +188,9 @@ class GLSimpleMoleculeView : public GLView
     GLfloat selectionLineWidth;         ///< The linewidth for drawing selected bonds.
     GLfloat selectionPointSize;         ///< The pointsize for drawing selected atoms.
     float scaleFactor;                  ///< scalefactor for scenes exceeding 50A in radius
+    float sphereRadius;                 ///< The radius of the bounding sphere of the atoms, as returned by boundingSphereRadius
+    unsigned int radiusVersion;         ///< The geometry version of the atoms for which sphereRadius and scaleFactor were calculated
+    unsigned int centerVersion;         ///< The geometry version of the atoms for which centerX|Y|Z were calculated
     QFont labelFont;                    ///< The font used to render labels and other values
 
     // private constants (made static for ease)
@@ -113,11 +113,13 @@ class GLView : public QGLWidget
     void resetOrientation(const bool update = true);        // resets the orientation
     void zoomFit(const bool update = true);       // zooms the scene so it fits the window
     void resetView(const bool update = true);     // resets translation/orientation/zoom
+    virtual void zoomChanged();         // is called when the scale of the scene on screen changes
     
     ///// protected member data
     GLfloat xPos;                       ///< Amount of translation on the x-axis.
     GLfloat yPos;                       ///< Amount of translation on the y-axis.
     GLfloat zPos;                       ///< Zoomfactor = distance camera from center.
+    float maxRadius;                    ///< A copy of the result of boundingSphereRadius for use in translateZ and the orthographic projection
     Quaternion<float>* orientationQuaternion;     ///< Orientation of the molecule in 4D.
     QPoint mousePosition;               ///< Position of the mouse.
 
@@ -137,7 +139,6 @@ class GLView : public QGLWidget
     int updateIndex;                    ///< Holds the index of the latest local update.
     bool viewModified;                  ///< Holds the 'modified' status of the scene.
     bool startingClick;                 ///< Keeps track of click vs. move events.
-    float maxRadius;                    ///< A copy of the result of boundingSphereRadius for use in translateZ
     bool currentPerspectiveProjection;  ///< Is true if the current projection is perspective
 
     ///// static private member data
@@ -0,0 +1,34 @@
+/***************************************************************************
+                        systeminfo.h  -  description
+                             -------------------
+    begin                : Sun Oct 18 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/// \file
+/// Contains the declaration of the class SystemInfo.
+
+#ifndef SYSTEMINFO_H
+#define SYSTEMINFO_H
+
+///// class SystemInfo ////////////////////////////////////////////////////////
+class SystemInfo
+{
+  public:
+    static unsigned int numProcessors(); // returns the number of available processors
+
+  private:
+    SystemInfo();                       // constructor
+};
+
+#endif
+
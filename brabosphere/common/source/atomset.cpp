@@ -45,7 +45,9 @@
 
 // C++ header files
 #include <cassert>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
 
 // STL header files
 #include <algorithm>
@@ -53,16 +55,102 @@
 // Qt header files
 #include <qcolor.h>
 #include <qdom.h>
+#include <qmutex.h>
 #include <qstring.h>
 #include <qstringlist.h>
+#include <qthread.h>
 
 #include <qdatetime.h>
 
 // Xbrabo header files
 #include "atomset.h"
 #include "domutils.h"
+#include "systeminfo.h"
 #include "vector3d.h" // includes the Point3D header file
 
+///////////////////////////////////////////////////////////////////////////////
+///// class AtomSet::BondWorker                                           /////
+///////////////////////////////////////////////////////////////////////////////
+
+class AtomSet::BondWorker : public QThread
+/// A worker thread finding the bonds of planes of cells for an AtomSet.
+{
+  public:
+    BondWorker(const AtomSet* master, const BondCells* bondCells, vector< vector<unsigned int> >* first,
+               vector< vector<unsigned int> >* second, QMutex* mutex, unsigned int* next) : QThread(),
+      owner(master),
+      cells(bondCells),
+      planeBonds1(first),
+      planeBonds2(second),
+      planeMutex(mutex),
+      nextPlane(next)
+    /// The default constructor.
+    {
+
+    }
+
+  private:
+    virtual void run()
+    /// Finds the bonds of the next unhandled plane until all planes are done.
+    {
+      while(true)
+      {
+        unsigned int plane;
+        {
+          QMutexLocker locker(planeMutex);
+          plane = (*nextPlane)++;
+        }
+        if(plane >= cells->numZ)
+          return;
+        owner->addPlaneBonds(*cells, plane, (*planeBonds1)[plane], (*planeBonds2)[plane]);
+      }
+    }
+
+    const AtomSet* owner;               ///< The AtomSet whose bonds are found.
+    const BondCells* cells;             ///< The atoms divided over the cells.
+    vector< vector<unsigned int> >* planeBonds1; ///< The first atoms of the bonds of each plane.
+    vector< vector<unsigned int> >* planeBonds2; ///< The second atoms of the bonds of each plane.
+    QMutex* planeMutex;                 ///< Locks the distribution of the planes.
+    unsigned int* nextPlane;            ///< The next plane to be handled.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///// class AtomSet::ICWorker                                             /////
+///////////////////////////////////////////////////////////////////////////////
+
+class AtomSet::ICWorker : public QThread
+/// A worker thread calculating a range of a list of internal coordinates for
+/// an AtomSet.
+{
+  public:
+    ICWorker(const AtomSet* master, const unsigned int icType, const vector<unsigned int>* icDefinitions,
+             vector<double>* icValues, const unsigned int firstValue, const unsigned int lastValue) : QThread(),
+      owner(master),
+      type(icType),
+      definitions(icDefinitions),
+      values(icValues),
+      first(firstValue),
+      last(lastValue)
+    /// The default constructor.
+    {
+
+    }
+
+  private:
+    virtual void run()
+    /// Calculates the internal coordinates from first up to last.
+    {
+      owner->icValueRange(type, *definitions, *values, first, last);
+    }
+
+    const AtomSet* owner;               ///< The AtomSet containing the atoms.
+    const unsigned int type;            ///< The type of the internal coordinates (corresponds to AtomSet::ICType).
+    const vector<unsigned int>* definitions; ///< The atoms of the internal coordinates.
+    vector<double>* values;             ///< The calculated values.
+    const unsigned int first;           ///< The first internal coordinate to be calculated.
+    const unsigned int last;            ///< One past the last internal coordinate to be calculated.
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Public Member Functions                                             /////
 ///////////////////////////////////////////////////////////////////////////////
@@ -71,14 +159,24 @@
 AtomSet::AtomSet() :
   numAtoms(0),
   forces(NULL),
+  dirtyBonds(true),
+  dirtyNeighbours(true),
+  dirtyBondList(false),
   chargesMulliken(NULL),
   chargesStockholder(NULL),
   boxMax(new Point3D<double>()),
   boxMin(new Point3D<double>()),
-  dirtyBox(true)
+  version(++lastVersion)
 /// The default constructor.
 {
-
+  cache.boxVersion = 0; // 0 is never a valid version
+  cache.spatialCellsVersion = 0;
+  cache.radiusVersion = 0;
+  cache.usedElementsVersion = 0;
+  cache.linearVersion = 0;
+  cache.radius = 0.0;
+  cache.linear = false;
+  resetPalette();
 }
 
 ///// Destructor //////////////////////////////////////////////////////////////
@@ -103,10 +201,13 @@ AtomSet::AtomSet(const AtomSet* atoms)
   clear();
   numAtoms = atoms->numAtoms;
   changed = atoms->changed;
-  coords.reserve(numAtoms);
-  coords.assign(atoms->coords.begin(), atoms->coords.end());
-  colors.reserve(numAtoms);
-  colors.assign(atoms->colors.begin(), atoms->colors.end());
+  coordsX.assign(atoms->coordsX.begin(), atoms->coordsX.end());
+  coordsY.assign(atoms->coordsY.begin(), atoms->coordsY.end());
+  coordsZ.assign(atoms->coordsZ.begin(), atoms->coordsZ.end());
+  elements.assign(atoms->elements.begin(), atoms->elements.end());
+  colorEntries.assign(atoms->colorEntries.begin(), atoms->colorEntries.end());
+  palette = atoms->palette;
+  customColors = atoms->customColors;
   if(atoms->forces != NULL)
   {
     forces = new vector<Point3D<double> >();
@@ -117,6 +218,16 @@ AtomSet::AtomSet(const AtomSet* atoms)
   bonds1.assign(atoms->bonds1.begin(), atoms->bonds1.end());
   bonds2.reserve(atoms->bonds2.size());
   bonds2.assign(atoms->bonds2.begin(), atoms->bonds2.end());
+  dirtyBonds = atoms->dirtyBonds;
+  bondCells = atoms->bondCells;
+  movedAtoms = atoms->movedAtoms;
+  isMovedAtom = atoms->isMovedAtom;
+  neighbourOffsets = atoms->neighbourOffsets;
+  neighbourCounts = atoms->neighbourCounts;
+  neighbourList = atoms->neighbourList;
+  dirtyNeighbours = atoms->dirtyNeighbours;
+  dirtyBondList = atoms->dirtyBondList;
+  changedBondAtoms = atoms->changedBondAtoms;
   if(atoms->chargesMulliken != NULL)
   {
     chargesMulliken = new vector<double >();
@@ -135,19 +246,25 @@ AtomSet::AtomSet(const AtomSet* atoms)
   chargesStockholderDensity = atoms->chargesStockholderDensity;
   boxMax = new Point3D<double>(*(atoms->boxMax)); // using the auto-generated copy constructor
   boxMin = new Point3D<double>(*(atoms->boxMin));
-  dirtyBox = atoms->dirtyBox;
+  version = atoms->version;
+  cache = atoms->cache;
+  cache.spatialCellsVersion = 0; // the cells are rebuilt when needed
 }
 
 ///// clear ///////////////////////////////////////////////////////////////////
 void AtomSet::clear()
 /// Removes all atoms.
 {
-  coords.clear();
-  colors.clear();
+  coordsX.clear();
+  coordsY.clear();
+  coordsZ.clear();
+  elements.clear();
+  colorEntries.clear();
+  resetPalette();
   clearProperties();
-  bonds1.clear();
-  bonds2.clear();
   numAtoms = 0;
+  setBondsChanged();
+  version = ++lastVersion;
   coordsPC.clear();
   chargesPC.clear();
   setChanged(false);
@@ -157,11 +274,14 @@ void AtomSet::clear()
 void AtomSet::reserve(const unsigned int size)
 /// Resizes all the vectors to accomodate the requested number of atoms.
 {
-  if(size <= coords.size())
+  if(size <= coordsX.size())
     return;
 
-  coords.reserve(size);
-  colors.reserve(size);
+  coordsX.reserve(size);
+  coordsY.reserve(size);
+  coordsZ.reserve(size);
+  elements.reserve(size);
+  colorEntries.reserve(size);
   if(forces != NULL)
     forces->reserve(size);
   if(chargesMulliken != NULL)
@@ -178,7 +298,7 @@ void AtomSet::addAtom(const Point3D<double>& location, const unsigned int atomic
 /// \warning Implies resetting all properties (forces, charges, etc.)
 {
   ///// return if the limit is reached (unlikely)
-  if(numAtoms == coords.max_size())
+  if(numAtoms == coordsX.max_size())
   {
     qDebug("AtomSet::addAtom: the maximum number of atoms has been reached.");
     return;
@@ -188,32 +308,32 @@ void AtomSet::addAtom(const Point3D<double>& location, const unsigned int atomic
   unsigned int atomNum = atomicNumber;
   if(atomNum > maxElements)
     atomNum = 0; // the unknown element
-  ///// make a local copy with the atomic number added
-  Point3D<double> newAtom(location);
-  newAtom.setID(atomNum);
 
   ///// add the atom
-  if(index < 0 || static_cast<unsigned int>(index) > numAtoms)
+  const unsigned short colorEntry = findPaletteEntry(color, atomNum);
+  unsigned int position = numAtoms;
+  if(index < 0 || static_cast<unsigned int>(index) >= numAtoms)
   {
     ///// add the atom at the end
-    coords.push_back(newAtom);
-    colors.push_back(color);
+    coordsX.push_back(location.x());
+    coordsY.push_back(location.y());
+    coordsZ.push_back(location.z());
+    elements.push_back(static_cast<unsigned char>(atomNum));
+    colorEntries.push_back(colorEntry);
   }
   else
   {
-    if(static_cast<unsigned int>(index) < numAtoms - 1)
-    {
-      ///// add the atom at position index
-      vector<Point3D<double> >::iterator it = coords.begin();
-      it += index;
-      coords.insert(it, newAtom);
-      vector<QColor>::iterator it2 = colors.begin();
-      it2 += index;
-      colors.insert(it2, color);
-    }
+    ///// add the atom at position index
+    position = static_cast<unsigned int>(index);
+    coordsX.insert(coordsX.begin() + position, location.x());
+    coordsY.insert(coordsY.begin() + position, location.y());
+    coordsZ.insert(coordsZ.begin() + position, location.z());
+    elements.insert(elements.begin() + position, static_cast<unsigned char>(atomNum));
+    colorEntries.insert(colorEntries.begin() + position, colorEntry);
   }
   numAtoms++;
 
+  insertBondAtoms(position, 1);
   setGeometryChanged(); // also calls setChanged and clearProperties
 }
 
@@ -238,6 +358,63 @@ void AtomSet::addAtom(const double x, const double y, const double z, const unsi
   addAtom(Point3D<double>(x, y, z), atomicNumber, stdColor(atomicNumber), index);
 }
 
+///// addAtoms ////////////////////////////////////////////////////////////////
+void AtomSet::addAtoms(const vector<Point3D<double> >& locations, const vector<QColor>& atomColors, const int index)
+/// Adds a block of atoms with coordinates \a locations and colors
+/// \a atomColors at position \a index. The atomic numbers are taken from the
+/// ID's of the locations. If \a index is negative (the default) the atoms are
+/// added at the end. The following atoms are moved only once.
+/// \warning Implies resetting all properties (forces, charges, etc.)
+{
+  assert(locations.size() == atomColors.size());
+  if(locations.empty())
+    return;
+
+  ///// return if the limit is reached (unlikely)
+  const unsigned int numNew = locations.size();
+  if(numNew > coordsX.max_size() - numAtoms)
+  {
+    qDebug("AtomSet::addAtoms: the maximum number of atoms has been reached.");
+    return;
+  }
+
+  ///// make room for the atoms
+  unsigned int position = numAtoms;
+  if(index >= 0 && static_cast<unsigned int>(index) < numAtoms)
+    position = static_cast<unsigned int>(index);
+  coordsX.insert(coordsX.begin() + position, numNew, 0.0);
+  coordsY.insert(coordsY.begin() + position, numNew, 0.0);
+  coordsZ.insert(coordsZ.begin() + position, numNew, 0.0);
+  elements.insert(elements.begin() + position, numNew, 0);
+  colorEntries.insert(colorEntries.begin() + position, numNew, 0);
+  numAtoms += numNew;
+
+  ///// fill in the atoms with the atomic numbers fixed if needed
+  for(unsigned int i = 0; i < numNew; i++)
+  {
+    coordsX[position + i] = locations[i].x();
+    coordsY[position + i] = locations[i].y();
+    coordsZ[position + i] = locations[i].z();
+    if(locations[i].id() <= maxElements)
+      elements[position + i] = static_cast<unsigned char>(locations[i].id()); // otherwise the unknown element
+    colorEntries[position + i] = findPaletteEntry(atomColors[i], elements[position + i]);
+  }
+
+  insertBondAtoms(position, numNew);
+  setGeometryChanged(); // also calls setChanged and clearProperties
+}
+
+///// addAtoms (overloaded) ///////////////////////////////////////////////////
+void AtomSet::addAtoms(const vector<Point3D<double> >& locations, const int index)
+/// Adds a block of atoms with their standard colors. \overload
+{
+  vector<QColor> atomColors;
+  atomColors.reserve(locations.size());
+  for(vector<Point3D<double> >::const_iterator it = locations.begin(); it != locations.end(); it++)
+    atomColors.push_back(stdColor(it->id()));
+  addAtoms(locations, atomColors, index);
+}
+
 ///// removeAtom //////////////////////////////////////////////////////////////
 void AtomSet::removeAtom(const unsigned int index)
 /// Removes the atom at position index.
@@ -245,21 +422,46 @@ void AtomSet::removeAtom(const unsigned int index)
 {
   assert(numAtoms > 0 && index < numAtoms);
 
-  if(index == numAtoms - 1)
+  removeAtoms(vector<unsigned int>(1, index));
+}
+
+///// removeAtoms /////////////////////////////////////////////////////////////
+void AtomSet::removeAtoms(const vector<unsigned int>& indices)
+/// Removes the atoms at the positions in \a indices, which may be given in
+/// any order. The remaining atoms are moved only once.
+/// \warning Implies resetting all properties (forces, charges, etc.)
+{
+  if(indices.empty())
+    return;
+
+  vector<bool> removed(numAtoms, false);
+  for(vector<unsigned int>::const_iterator it = indices.begin(); it != indices.end(); it++)
   {
-    coords.pop_back();
-    colors.pop_back();
+    assert(*it < numAtoms);
+    removed[*it] = true;
   }
-  else
+
+  ///// keep the remaining atoms in order
+  unsigned int numKept = 0;
+  for(unsigned int i = 0; i < numAtoms; i++)
   {
-    vector<Point3D<double> >::iterator it = coords.begin();
-    it += index;
-    coords.erase(it);
-    vector<QColor>::iterator it2 = colors.begin();
-    it2 += index;
-    colors.erase(it2);
+    if(!removed[i])
+    {
+      coordsX[numKept] = coordsX[i];
+      coordsY[numKept] = coordsY[i];
+      coordsZ[numKept] = coordsZ[i];
+      elements[numKept] = elements[i];
+      colorEntries[numKept++] = colorEntries[i];
+    }
   }
-  numAtoms--;
+  coordsX.resize(numKept);
+  coordsY.resize(numKept);
+  coordsZ.resize(numKept);
+  elements.resize(numKept);
+  colorEntries.resize(numKept);
+  numAtoms = numKept;
+
+  removeBondAtoms(removed);
   setGeometryChanged();
 }
 ///// addPointCharge //////////////////////////////////////////////////////////
@@ -269,7 +471,7 @@ void AtomSet::addPointCharge(const double x, const double y, const double z, con
 /// with the appropriate color.
 {
   ///// return if the limit is reached (unlikely)
-  if(coordsPC.size() == coords.max_size())
+  if(coordsPC.size() == coordsPC.max_size())
   {
     qDebug("AtomSet::addPointCharge: the maximum number of atoms has been reached.");
     return;
@@ -309,7 +511,8 @@ void AtomSet::setX(const unsigned int index, const double x)
 {
   assert(index < numAtoms);
 
-  coords[index].setValues(x, coords[index].y(), coords[index].z());
+  coordsX[index] = x;
+  setAtomMoved(index);
   setGeometryChanged();
 }
 
@@ -320,7 +523,8 @@ void AtomSet::setY(const unsigned int index, const double y)
 {
   assert(index < numAtoms);
 
-  coords[index].setValues(coords[index].x(), y, coords[index].z());
+  coordsY[index] = y;
+  setAtomMoved(index);
   setGeometryChanged();
 }
 
@@ -331,7 +535,8 @@ void AtomSet::setZ(const unsigned int index, const double z)
 {
   assert(index < numAtoms);
 
-  coords[index].setValues(coords[index].x(), coords[index].y(), z);
+  coordsZ[index] = z;
+  setAtomMoved(index);
   setGeometryChanged();
 }
 
@@ -341,7 +546,7 @@ void AtomSet::setColor(const unsigned int index, const QColor color)
 {
   assert(index < numAtoms);
 
-  colors[index] = color;
+  colorEntries[index] = findPaletteEntry(color, elements[index]);
   setChanged();
 }
 
@@ -435,30 +640,32 @@ void AtomSet::changeBond(const double amount, const unsigned int movingAtom, con
   vector<unsigned int> moveableAtoms;
   if(includeNeighbours)
   {
-    ///// call the bonds routine to be sure the bond list gets updated
-    {
-      vector<unsigned int>* tempBonds1, * tempBonds2;
-      bonds(tempBonds1, tempBonds2);
-    }
     ///// fill the atom list
-    if(!addBondList(movingAtom, movingAtom, secondAtom, secondAtom, &moveableAtoms))
+    if(!addBondList(movingAtom, secondAtom, secondAtom, &moveableAtoms))
       moveableAtoms.clear();
   }
   moveableAtoms.push_back(movingAtom);
 
   ///// determine the amount of displacement
-  const Vector3D<double> oldPosition(coords[secondAtom], coords[movingAtom]);
+  const Vector3D<double> oldPosition(coordinates(secondAtom), coordinates(movingAtom));
   Vector3D<double> newPosition = oldPosition;
   if((oldPosition.length() + amount) < 0.1)
     newPosition.setLength(0.1); // the bond would get too small or even flip over
   else
     newPosition.changeLength(amount); // normal displacement
-  const Point3D<double> delta(newPosition.x() - oldPosition.x(), newPosition.y() - oldPosition.y(), newPosition.z() - oldPosition.z());
+  const double deltaX = newPosition.x() - oldPosition.x();
+  const double deltaY = newPosition.y() - oldPosition.y();
+  const double deltaZ = newPosition.z() - oldPosition.z();
 
   ///// move all atoms
   vector<unsigned int>::iterator it = moveableAtoms.begin();
   while(it != moveableAtoms.end())
-    coords[*it++].add(delta);
+  {
+    coordsX[*it] += deltaX;
+    coordsY[*it] += deltaY;
+    coordsZ[*it] += deltaZ;
+    setAtomMoved(*it++);
+  }
 
   setGeometryChanged();
 }
@@ -480,33 +687,29 @@ void AtomSet::changeAngle(const double amount, const unsigned int movingAtom, co
   vector<unsigned int> moveableAtoms;
   if(includeNeighbours)
   {
-    ///// call the bonds routine to be sure the bond list gets updated
-    {
-      vector<unsigned int>* tempBonds1, * tempBonds2;
-      bonds(tempBonds1, tempBonds2);
-    }
     ///// fill the atom list
-    if(!addBondList(movingAtom, movingAtom, centralAtom, lastAtom, &moveableAtoms))
+    if(!addBondList(movingAtom, centralAtom, lastAtom, &moveableAtoms))
       moveableAtoms.clear();
   }
   moveableAtoms.push_back(movingAtom);
 
   ///// determine the vector to rotate around => cross product of vectors along bonds
-  Vector3D<double> bond1(coords[centralAtom], coords[movingAtom]);
-  Vector3D<double> bond2(coords[centralAtom], coords[lastAtom]);
+  const Point3D<double> center = coordinates(centralAtom);
+  Vector3D<double> bond1(center, coordinates(movingAtom));
+  Vector3D<double> bond2(center, coordinates(lastAtom));
   Vector3D<double> axis = bond1.cross(bond2);
 
   ///// rotate all atoms
   std::vector<unsigned int>::iterator it = moveableAtoms.begin();
   while(it != moveableAtoms.end())
   {
-    Vector3D<double> rotatebond(coords[centralAtom], coords[*it]);
+    Vector3D<double> rotatebond(center, coordinates(*it));
     axis = rotatebond.cross(bond2);
     rotatebond.rotate(axis, amount);
-    coords[*it].setValues(coords[centralAtom].x() + rotatebond.x(),
-                          coords[centralAtom].y() + rotatebond.y(),
-                          coords[centralAtom].z() + rotatebond.z());
-    it++;
+    coordsX[*it] = center.x() + rotatebond.x();
+    coordsY[*it] = center.y() + rotatebond.y();
+    coordsZ[*it] = center.z() + rotatebond.z();
+    setAtomMoved(*it++);
   }
   setGeometryChanged();
 }
@@ -529,13 +732,8 @@ void AtomSet::changeTorsion(const double amount, const unsigned int movingAtom,
   vector<unsigned int> moveableAtoms;
   if(includeNeighbours)
   {
-    ///// call the bonds routine to be sure the bond list gets updated
-    {
-      vector<unsigned int>* tempBonds1, * tempBonds2;
-      bonds(tempBonds1, tempBonds2);
-    }
     ///// fill the atom list
-    if(!addBondList(secondAtom, secondAtom, thirdAtom, thirdAtom, &moveableAtoms))
+    if(!addBondList(secondAtom, thirdAtom, thirdAtom, &moveableAtoms))
     {
       moveableAtoms.clear();
       moveableAtoms.push_back(movingAtom);
@@ -552,18 +750,84 @@ void AtomSet::changeTorsion(const double amount, const unsigned int movingAtom,
     moveableAtoms.push_back(movingAtom);
 
   ///// determine the vector to rotate around => central bond
-  Vector3D<double> centralbond(coords[secondAtom], coords[thirdAtom]);
+  const Point3D<double> center = coordinates(secondAtom);
+  Vector3D<double> centralbond(center, coordinates(thirdAtom));
 
   ///// rotate all atoms
   std::vector<unsigned int>::iterator it = moveableAtoms.begin();
   while(it != moveableAtoms.end())
   {
-    Vector3D<double> rotatebond(coords[secondAtom], coords[*it]);
+    Vector3D<double> rotatebond(center, coordinates(*it));
     rotatebond.rotate(centralbond, -amount);
-    coords[*it].setValues(coords[secondAtom].x() + rotatebond.x(),
-                          coords[secondAtom].y() + rotatebond.y(),
-                          coords[secondAtom].z() + rotatebond.z());
-    it++;
+    coordsX[*it] = center.x() + rotatebond.x();
+    coordsY[*it] = center.y() + rotatebond.y();
+    coordsZ[*it] = center.z() + rotatebond.z();
+    setAtomMoved(*it++);
+  }
+  setGeometryChanged();
+}
+
+///// translateAtoms //////////////////////////////////////////////////////////
+void AtomSet::translateAtoms(const vector<unsigned int>& indices, const double dx, const double dy, const double dz)
+/// Translates the atoms at the positions in \a indices by (dx, dy, dz). Each
+/// atom should be present only once.
+/// \warning Implies resetting all properties (forces, charges, etc.)
+{
+  if(indices.empty())
+    return;
+
+  for(vector<unsigned int>::const_iterator it = indices.begin(); it != indices.end(); it++)
+  {
+    assert(*it < numAtoms);
+    coordsX[*it] += dx;
+    coordsY[*it] += dy;
+    coordsZ[*it] += dz;
+    setAtomMoved(*it);
+  }
+  setGeometryChanged();
+}
+
+///// displaceAtoms ///////////////////////////////////////////////////////////
+void AtomSet::displaceAtoms(const vector<unsigned int>& indices, const vector<Point3D<double> >& displacements)
+/// Moves the atom at position indices[i] by displacements[i]. Each atom should
+/// be present only once.
+/// \warning Implies resetting all properties (forces, charges, etc.)
+{
+  assert(indices.size() == displacements.size());
+  if(indices.empty())
+    return;
+
+  for(unsigned int i = 0; i < indices.size(); i++)
+  {
+    assert(indices[i] < numAtoms);
+    coordsX[indices[i]] += displacements[i].x();
+    coordsY[indices[i]] += displacements[i].y();
+    coordsZ[indices[i]] += displacements[i].z();
+    setAtomMoved(indices[i]);
+  }
+  setGeometryChanged();
+}
+
+///// transformAtoms //////////////////////////////////////////////////////////
+void AtomSet::transformAtoms(const vector<unsigned int>& indices, const double* rotation, const Point3D<double>& center)
+/// Rotates the atoms at the positions in \a indices around \a center. The
+/// rotation is given as a 3x3 matrix with the rows stored one after another.
+/// Each atom should be present only once.
+/// \warning Implies resetting all properties (forces, charges, etc.)
+{
+  if(indices.empty())
+    return;
+
+  for(vector<unsigned int>::const_iterator it = indices.begin(); it != indices.end(); it++)
+  {
+    assert(*it < numAtoms);
+    const double x = coordsX[*it] - center.x();
+    const double y = coordsY[*it] - center.y();
+    const double z = coordsZ[*it] - center.z();
+    coordsX[*it] = center.x() + rotation[0]*x + rotation[1]*y + rotation[2]*z;
+    coordsY[*it] = center.y() + rotation[3]*x + rotation[4]*y + rotation[5]*z;
+    coordsZ[*it] = center.z() + rotation[6]*x + rotation[7]*y + rotation[8]*z;
+    setAtomMoved(*it);
   }
   setGeometryChanged();
 }
@@ -579,8 +843,12 @@ void AtomSet::transferCoordinates(const AtomSet* source)
   assert(count() == source->count());
 
   ///// copy the coordsX, Y and Z vectors
-  coords.assign(source->coords.begin(), source->coords.end());
+  coordsX.assign(source->coordsX.begin(), source->coordsX.end());
+  coordsY.assign(source->coordsY.begin(), source->coordsY.end());
+  coordsZ.assign(source->coordsZ.begin(), source->coordsZ.end());
+  elements.assign(source->elements.begin(), source->elements.end());
 
+  setBondsChanged();
   setGeometryChanged();
 }
 
@@ -597,7 +865,9 @@ Point3D<double> AtomSet::coordinates(const unsigned int index) const
 {
   assert(index < numAtoms);
 
-  return coords[index];
+  Point3D<double> result(coordsX[index], coordsY[index], coordsZ[index]);
+  result.setID(elements[index]);
+  return result;
 }
 
 ///// x ///////////////////////////////////////////////////////////////////////
@@ -606,7 +876,7 @@ double AtomSet::x(const unsigned int index) const
 {
   assert(index < numAtoms);
 
-  return coords[index].x();
+  return coordsX[index];
 }
 
 ///// y ///////////////////////////////////////////////////////////////////////
@@ -615,7 +885,7 @@ double AtomSet::y(const unsigned int index) const
 {
   assert(index < numAtoms);
 
-  return coords[index].y();
+  return coordsY[index];
 }
 
 ///// z ///////////////////////////////////////////////////////////////////////
@@ -624,7 +894,7 @@ double AtomSet::z(const unsigned int index) const
 {
   assert(index < numAtoms);
   
-  return coords[index].z();
+  return coordsZ[index];
 }
 
 ///// atomicNumber ////////////////////////////////////////////////////////////
@@ -633,7 +903,39 @@ unsigned int AtomSet::atomicNumber(const unsigned int index) const
 {
   assert(index < numAtoms);
 
-  return coords[index].id();
+  return elements[index];
+}
+
+///// xCoordinates ////////////////////////////////////////////////////////////
+const double* AtomSet::xCoordinates() const
+/// Returns the x-coordinates of all atoms as a contiguous array of count()
+/// values, or 0 if there are no atoms. The array is valid until atoms are
+/// added or removed.
+{
+  return numAtoms == 0 ? 0 : &coordsX[0];
+}
+
+///// yCoordinates ////////////////////////////////////////////////////////////
+const double* AtomSet::yCoordinates() const
+/// Returns the y-coordinates of all atoms. \see xCoordinates
+{
+  return numAtoms == 0 ? 0 : &coordsY[0];
+}
+
+///// zCoordinates ////////////////////////////////////////////////////////////
+const double* AtomSet::zCoordinates() const
+/// Returns the z-coordinates of all atoms. \see xCoordinates
+{
+  return numAtoms == 0 ? 0 : &coordsZ[0];
+}
+
+///// atomicNumbers ///////////////////////////////////////////////////////////
+const unsigned char* AtomSet::atomicNumbers() const
+/// Returns the atomic numbers of all atoms as a contiguous array of count()
+/// values, or 0 if there are no atoms. Unknown atoms have atomic number 0.
+/// The array is valid until atoms are added or removed.
+{
+  return numAtoms == 0 ? 0 : &elements[0];
 }
 
 ///// color ///////////////////////////////////////////////////////////////////
@@ -642,233 +944,116 @@ QColor AtomSet::color(const unsigned int index) const
 {
   assert(index < numAtoms);
 
-  return colors[index];
+  return palette[colorEntries[index]];
+}
+
+///// paletteEntries //////////////////////////////////////////////////////////
+const unsigned short* AtomSet::paletteEntries() const
+/// Returns the entries of the palette holding the colors of all atoms as a
+/// contiguous array of count() values, or 0 if there are no atoms. This allows
+/// converting each color of the palette only once. The array is valid until
+/// atoms are added or removed or colors are changed.
+{
+  return numAtoms == 0 ? 0 : &colorEntries[0];
+}
+
+///// paletteSize /////////////////////////////////////////////////////////////
+unsigned int AtomSet::paletteSize() const
+/// Returns the number of colors in the palette. The first maxElements + 1
+/// colors are the standard colors of the elements, the others are custom
+/// colors.
+{
+  return palette.size();
+}
+
+///// paletteColor ////////////////////////////////////////////////////////////
+QColor AtomSet::paletteColor(const unsigned int entry) const
+/// Returns the color at position entry of the palette.
+{
+  assert(entry < palette.size());
+
+  return palette[entry];
 }
 
 ///// usedAtomicNumbers ///////////////////////////////////////////////////////
 vector<unsigned int> AtomSet::usedAtomicNumbers() const
 /// Returns a vector containing a sorted list of
 /// the atomic numbers present in the set. Only the known atoms are returned.
+/// The list is determined once for each version of the geometry.
 {
-  vector<unsigned int> result;
-  for(unsigned int i = 1; i <= maxElements; i++)
+  if(cache.usedElementsVersion != version)
   {
-    ///// check if this atomic number appears in the list atomicNumbers
-    //if(std::find(atomicNumbers.begin(), atomicNumbers.end(), i) != atomicNumbers.end())
-    //  result.push_back(i); // found an occurence
-    for(unsigned int j = 0; j < numAtoms; j++)
+    cache.usedElementsVersion = version;
+    vector<bool> present(maxElements + 1, false);
+    for(unsigned int i = 0; i < numAtoms; i++)
+      present[elements[i]] = true;
+    cache.usedElements.clear();
+    for(unsigned int i = 1; i <= maxElements; i++)
     {
-      if(coords[j].id() == i)
-      {
-        result.push_back(i);
-        break;
-      }
+      if(present[i])
+        cache.usedElements.push_back(i);
     }
   }
-  return result;
+  return cache.usedElements;
 }
 
 ///// bonds ///////////////////////////////////////////////////////////////////
 void AtomSet::bonds(vector<unsigned int>*& first, vector<unsigned int>*& second)
 /// Returns a list of the bonds between the atoms. Unknown atoms can never have
-/// bonds. This routine puts atoms in boxes of 4x4x4 Angstrom and only looks for
-/// bonds between neighbouring boxes.
+/// bonds. Once all bonds have been calculated, only the bonds of atoms that 
+/// were moved, added or removed since are recalculated. Each bond is listed
+/// once with the lowest atom index in first, sorted on the first and then the
+/// second atom, so the list only depends on the geometry.
 {
-  QTime timer;
-  timer.start();
-  if(bonds1.empty() && numAtoms != 0) // only recalculate when necessary
-  {
-    // reserve some space (guesstimate of the number of bonds to be generated, normally between 0.67x and 1x the number of atoms)
-    bonds1.reserve(numAtoms);
-    bonds2.reserve(numAtoms);
-    // update the dimensions of the box
-    updateBoxDimensions();
-    // divide it into cells of 4x4x4 Angstrom
-    // (4.0A because largest VdW radius = 3.0A => largest distance = 1.25*(3.0 + 3.0) = 7.5A < 2 * 4.0A)
-    const double cellSize = 4.0;
-    Point3D<unsigned int> numCells(static_cast<unsigned int>((boxMax->x() - boxMin->x())/cellSize) + 1,
-                                   static_cast<unsigned int>((boxMax->y() - boxMin->y())/cellSize) + 1,
-                                   static_cast<unsigned int>((boxMax->z() - boxMin->z())/cellSize) + 1);
-    unsigned int cellsXY = numCells.x() * numCells.y();
-    unsigned int totalCells = cellsXY * numCells.z();
-
-    // assign all atoms to their cells
-    vector< vector<unsigned int> > atomCell(totalCells); // each cell contains a vector of all assigned atom indices
-    for(unsigned int i = 0; i < numAtoms; i++)
-    {
-      if(coords[i].id() != 0) // check for point charges, because they never have bonds
-      {
-        unsigned int planeX = static_cast<unsigned int>((coords[i].x() - boxMin->x())/cellSize);
-        unsigned int planeY = static_cast<unsigned int>((coords[i].y() - boxMin->y())/cellSize);
-        unsigned int planeZ = static_cast<unsigned int>((coords[i].z() - boxMin->z())/cellSize);
-        // the atom belongs to the cell at the crossing of planeX, planeY and planeZ
-        atomCell[planeX + numCells.x()*planeY + cellsXY*planeZ].push_back(i);
-      }
-    }
-    /*qDebug("atoms in each cell:");
-    for(unsigned int i = 0; i < totalCells; i++)
-    {
-      qDebug("cell %d: %d atoms", i, atomCell[i].size());
-      for(unsigned int j = 0; j < atomCell[i].size(); j++)
-        qDebug("contains atom %d", atomCell[i][j]+1);
-    }*/
-
-    // loop over combinations of all cells and calculate bonds only if the cells
-    // are connected and cell2 has a larger index than cell1 in each direction
-    unsigned int cellIndex = 0;
-    vector<unsigned int>* atomList;
-    // loop over the first set of cells
-    for(unsigned int cellZ = 0; cellZ < numCells.z(); cellZ++)
-    {
-      for(unsigned int cellY = 0; cellY < numCells.y(); cellY++)
-      {
-        for(unsigned int cellX = 0; cellX < numCells.x(); cellX++)
-        {
-          atomList = &atomCell[cellIndex++];
-          if(atomList->size() == 0)
-            continue; // an empty cell can be skipped
-          ///// find all surrounding cells (X/Y/Z, X+1/Y/Z, X/Y+1/Z, X/Y/Z+1, X+1/Y+1/Z, X+1/Y/Z+1, X/Y+1/Z+1, X+1/Y+1/Z+1,
-          /////                             X-1/Y/Z+1, X+1/Y+1/Z-1, X/Y+1/Z-1, X-1/Y+1/Z-1, X-1/Y+1/Z, X-1/Y+1/Z+1)
-          ///// other neighbouring cells (remaining of 13 total of 26) will already have been combined with this cell before
-          ///// (no double counting)
-          // X/Y/Z -> intra-cell bonds
-          addBonds(atomList, atomList);
-          // X+1/Y/Z
-          if(cellX != (numCells.x() - 1))
-            addBonds(atomList, &atomCell[cellX+1 + numCells.x()*cellY + cellsXY*cellZ]);
-          // X/Y+1/Z
-          if(cellY != (numCells.y() - 1))
-           addBonds(atomList, &atomCell[cellX + numCells.x()*(cellY+1) + cellsXY*cellZ]);
-          // X/Y/Z+1
-          if(cellZ != (numCells.z() - 1))
-            addBonds(atomList, &atomCell[cellX + numCells.x()*cellY + cellsXY*(cellZ+1)]);
-          // X+1/Y+1/Z
-          if(cellX != (numCells.x() - 1) && cellY != (numCells.y() - 1))
-            addBonds(atomList, &atomCell[(cellX+1) + numCells.x()*(cellY+1) + cellsXY*cellZ]);
-          // X+1/Y/Z+1
-          if(cellX != (numCells.x() - 1) && cellZ != (numCells.z() - 1))
-            addBonds(atomList, &atomCell[(cellX+1) + numCells.x()*cellY + cellsXY*(cellZ+1)]);
-          // X/Y+1/Z+1
-          if(cellY != (numCells.y() - 1) && cellZ != (numCells.z() - 1))
-            addBonds(atomList, &atomCell[cellX + numCells.x()*(cellY+1) + cellsXY*(cellZ+1)]);
-          // X+1/Y+1/Z+1
-          if(cellX != (numCells.x() - 1) && cellY != (numCells.y() - 1) && cellZ != (numCells.z() - 1))
-            addBonds(atomList, &atomCell[(cellX+1) + numCells.x()*(cellY+1) + cellsXY*(cellZ+1)]);
-          // X-1/Y/Z+1
-          if(cellX != 0 && cellZ != (numCells.z() - 1))
-            addBonds(atomList, &atomCell[(cellX-1) + numCells.x()*cellY + cellsXY*(cellZ+1)]);
-          // X+1/Y+1/Z-1
-          if(cellX != (numCells.x() - 1) && cellY != (numCells.y() - 1) && cellZ != 0)
-            addBonds(atomList, &atomCell[(cellX+1) + numCells.x()*(cellY+1) + cellsXY*(cellZ-1)]);
-          // X/Y+1/Z-1
-          if(cellY != (numCells.y() - 1) && cellZ != 0)
-            addBonds(atomList, &atomCell[cellX + numCells.x()*(cellY+1) + cellsXY*(cellZ-1)]);
-          // X-1/Y+1/Z-1
-          if(cellX != 0 && cellY != (numCells.y() - 1) && cellZ != 0)
-            addBonds(atomList, &atomCell[(cellX-1) + numCells.x()*(cellY+1) + cellsXY*(cellZ-1)]);
-          // X-1/Y+1/Z
-          if(cellX != 0 && cellY != (numCells.y() - 1))
-            addBonds(atomList, &atomCell[(cellX-1) + numCells.x()*(cellY+1) + cellsXY*cellZ]);
-          // X-1/Y+1/Z+1
-          if(cellX != 0 && cellY != (numCells.y() - 1) && cellZ != (numCells.z() - 1))
-            addBonds(atomList, &atomCell[(cellX-1) + numCells.x()*(cellY+1) + cellsXY*(cellZ+1)]);
-        }
-      }
-    }
-    qDebug("bonds generation took %f seconds", timer.restart()/1000.0f);
-  }
-  // old unoptimized code (44 times slower for 8870 atoms of acetone cluster, 25 times slower for GFP)
-  /*if(bonds1.empty() && numAtoms != 0) // only recalculate when necessary
-  {
-    float distance2, refdistance, dx, dy, dz;
-    unsigned int numBonds = 0;
-    unsigned int atomNumI, atomNumJ;
-
-    ///// do a double loop over all atoms and check whether the sum of their
-    ///// Van der Waals radii is less than the distance between them
-    ///// use the squared distances for speed
-    for(unsigned int i = 0; i < numAtoms; i++)
-    {
-      atomNumI = atomicNumbers[i];
-      if(atomNumI == 0)
-        continue;
-      for(unsigned int j = 0; j < i; j++)
-      {
-        atomNumJ = atomicNumbers[j];
-        if(atomNumJ == 0)
-          continue;
-        dx = static_cast<float>(coords[i].x() - coords[j].x());
-        dy = static_cast<float>(coords[i].y() - coords[j].y());
-        dz = static_cast<float>(coords[i].z() - coords[j].z());
-        distance2 = dx*dx + dy*dy +dz*dz;
-        refdistance = 1.25f*(vanderWaals(atomNumI) + vanderWaals(atomNumJ));
-        if(distance2 <= refdistance*refdistance)
-        {
-          numBonds++;
-          if(numBonds == bonds1.max_size())
-          {
-            qDebug("AtomSet::bonds: the maximum number of bonds has been reached.");
-            first = &bonds1;
-            second = &bonds2;
-            return;
-          }
-          bonds1.push_back(i);
-          bonds2.push_back(j);
-        }
-      }
-    }
-    qDebug("old bonds generation took %f seconds", timer.restart()/1000.0f);
-  }
-  */
+  updateNeighbours();
+  updateBondList();
 
   first = &bonds1;
   second = &bonds2;
 }
 
 ///// numberOfBonds ///////////////////////////////////////////////////////////
-unsigned int AtomSet::numberOfBonds(unsigned int index) const
+unsigned int AtomSet::numberOfBonds(const unsigned int index) const
 /// Returns the number of bonds an atom has.
 {
   assert(index < numAtoms);
 
-  if(atomicNumber(index) == 0)
-    return 0;
-
-  unsigned int result = 0;
-  float distance2, refdistance, dx, dy, dz;
-
-  ///// similar to bonds-code
-  for(unsigned int i = 0; i < numAtoms; i++)
-  {
-    if(i == index || atomicNumber(i) == 0)
-      continue;
-
-    dx = static_cast<float>(coords[i].x() - coords[index].x());
-    dy = static_cast<float>(coords[i].y() - coords[index].y());
-    dz = static_cast<float>(coords[i].z() - coords[index].z());
+  updateNeighbours();
+  return neighbourCounts[index];
+}
 
-    distance2 = dx*dx + dy*dy + dz*dz;
-    refdistance = 1.25f*(vanderWaals(atomicNumber(i)) + vanderWaals(atomicNumber(index)));
+///// bondedAtom //////////////////////////////////////////////////////////////
+unsigned int AtomSet::bondedAtom(const unsigned int index, const unsigned int bond) const
+/// Returns the atom bonded to atom index by its bond with number bond. The
+/// bonds of an atom are numbered from 0 to numberOfBonds(index) - 1 in the
+/// order of increasing index of the bonded atom.
+{
+  assert(index < numAtoms);
 
-    if(distance2 <= refdistance*refdistance)
-      result++;
-  }
-  return result;
+  updateNeighbours();
+  assert(bond < neighbourCounts[index]);
+  return neighbourList[neighbourOffsets[index] + bond];
 }
 
 ///// isLinear ////////////////////////////////////////////////////////////////
 bool AtomSet::isLinear() const
-/// Returns true if the atoms form a linear molecule.
+/// Returns true if the atoms form a linear molecule. The result is calculated
+/// once for each version of the geometry.
 {
+  if(cache.linearVersion == version)
+    return cache.linear;
+  cache.linearVersion = version;
+  cache.linear = false;
+
   if(numAtoms < 3)
-    return true; // 2 atoms or less are always on a line
+    return cache.linear = true; // 2 atoms or less are always on a line
 
   ///// check whether each point (3-numAtoms) is collinear with the points 1 and 2
   ///// => (x2-x1)/(x3-x1) = (y2-y1)/(y3-y1) = (z2-z1)/(z3-z1) (from mathforum.org FAQ)
   ///// => (x2-x1)(y3-y1) == (y2-y1)(x3-x1) && (y2-y1)(z3-z1) == (z2-z1)(y3-y1)
-  double dx10 = coords[1].x() - coords[0].x();
-  double dy10 = coords[1].y() - coords[0].y();
-  double dz10 = coords[1].z() - coords[0].z();
+  double dx10 = coordsX[1] - coordsX[0];
+  double dy10 = coordsY[1] - coordsY[0];
+  double dz10 = coordsZ[1] - coordsZ[0];
 
   for(unsigned int i = 2; i < numAtoms; i++)
   {
@@ -876,15 +1061,15 @@ bool AtomSet::isLinear() const
     //double test2 = (y(1) - y(0)) * (x(i) - x(0));
     //double test3 = (y(1) - y(0)) * (z(i) - z(0));
     //double test4 = (z(1) - z(0)) * (y(i) - y(0));
-    double test1 = dx10 * (coords[i].y() - coords[0].y());
-    double test2 = dy10 * (coords[i].x() - coords[0].x());
-    double test3 = dy10 * (coords[i].z() - coords[0].z());
-    double test4 = dz10 * (coords[i].y() - coords[0].y());
+    double test1 = dx10 * (coordsY[i] - coordsY[0]);
+    double test2 = dy10 * (coordsX[i] - coordsX[0]);
+    double test3 = dy10 * (coordsZ[i] - coordsZ[0]);
+    double test4 = dz10 * (coordsY[i] - coordsY[0]);
     if((fabs(test1 - test2) > Point3D<double>::TOLERANCE) || (fabs(test3 - test4) > Point3D<double>::TOLERANCE))
       return false;
   }
   ///// all collinearity tests passed
-  return true;
+  return cache.linear = true;
 }
 
 ///// isChanged ///////////////////////////////////////////////////////////////
@@ -894,6 +1079,17 @@ bool AtomSet::isChanged() const
   return changed;
 }
 
+///// geometryVersion /////////////////////////////////////////////////////////
+unsigned int AtomSet::geometryVersion() const
+/// Returns the version of the geometry. It changes each time atoms are
+/// added, removed or moved, so a result derived from the geometry only needs
+/// to be recalculated when the version differs from the one it was calculated
+/// for. Versions are unique over all AtomSets and only shared by copies, so
+/// this also holds when the AtomSet of a view is replaced.
+{
+  return version;
+}
+
 ///// dx //////////////////////////////////////////////////////////////////////
 double AtomSet::dx(const unsigned int index) const
 /// Returns the x-component of the force on the atom
@@ -934,27 +1130,68 @@ double AtomSet::dz(const unsigned int index) const
 double AtomSet::bond(const unsigned int atom1, const unsigned int atom2) const
 /// Returns the distance between the two atoms.
 {
-  Vector3D<double> bondSize(coords[atom1], coords[atom2]);
-  return bondSize.length();
+  assert(atom1 < numAtoms && atom2 < numAtoms);
+
+  const unsigned int atomList[2] = {atom1, atom2};
+  return bondValue(atomList);
 }
 
 ///// angle ///////////////////////////////////////////////////////////////////
 double AtomSet::angle(const unsigned int atom1, const unsigned int atom2, const unsigned int atom3) const
 /// Returns the value of the valence angle 1-2-3.
 {
-  Vector3D<double> bond1(coords[atom2], coords[atom1]);
-  Vector3D<double> bond2(coords[atom2], coords[atom3]);
-  return bond1.angle(bond2);
+  assert(atom1 < numAtoms && atom2 < numAtoms && atom3 < numAtoms);
+
+  const unsigned int atomList[3] = {atom1, atom2, atom3};
+  return angleValue(atomList);
 }
 
 ///// torsion /////////////////////////////////////////////////////////////////
 double AtomSet::torsion(const unsigned int atom1, const unsigned int atom2, const unsigned int atom3, const unsigned int atom4) const
 /// Returns the value of the torsion angle 1-2-3-4.
 {
-  Vector3D<double> bond1(coords[atom2], coords[atom1]);
-  Vector3D<double> centralbond(coords[atom2], coords[atom3]);
-  Vector3D<double> bond2(coords[atom3], coords[atom4]);
-  return bond1.torsion(bond2, centralbond);
+  assert(atom1 < numAtoms && atom2 < numAtoms && atom3 < numAtoms && atom4 < numAtoms);
+
+  const unsigned int atomList[4] = {atom1, atom2, atom3, atom4};
+  return torsionValue(atomList);
+}
+
+///// bondValues //////////////////////////////////////////////////////////////
+void AtomSet::bondValues(const vector<unsigned int>& definitions, vector<double>& values) const
+/// Calculates the distances between many pairs of atoms in one pass.
+/// \a definitions contains the indices of the atoms of each pair
+/// consecutively. The distances are returned in \a values in the same order.
+{
+  icValues(IC_BOND, definitions, values);
+}
+
+///// angleValues /////////////////////////////////////////////////////////////
+void AtomSet::angleValues(const vector<unsigned int>& definitions, vector<double>& values) const
+/// Calculates the valence angles 1-2-3 of many triplets of atoms in one pass.
+/// \a definitions contains the indices of the atoms of each triplet
+/// consecutively. The angles are returned in \a values in the same order.
+{
+  icValues(IC_ANGLE, definitions, values);
+}
+
+///// torsionValues ///////////////////////////////////////////////////////////
+void AtomSet::torsionValues(const vector<unsigned int>& definitions, vector<double>& values) const
+/// Calculates the torsion angles 1-2-3-4 of many quadruplets of atoms in one
+/// pass. \a definitions contains the indices of the atoms of each quadruplet
+/// consecutively. The angles are returned in \a values in the same order.
+{
+  icValues(IC_TORSION, definitions, values);
+}
+
+///// outOfPlaneValues ////////////////////////////////////////////////////////
+void AtomSet::outOfPlaneValues(const vector<unsigned int>& definitions, vector<double>& values) const
+/// Calculates the out-of-plane angles of many quadruplets of atoms in one
+/// pass. This is the angle between the bond 2-1 and the plane through the
+/// atoms 2, 3 and 4. \a definitions contains the indices of the atoms of each
+/// quadruplet consecutively. The angles are returned in \a values in the same
+/// order.
+{
+  icValues(IC_OUTOFPLANE, definitions, values);
 }
 
 ///// charge //////////////////////////////////////////////////////////////////
@@ -1027,15 +1264,43 @@ bool AtomSet::hasForces() const
 
 //// rotationCenter ///////////////////////////////////////////////////////////
 Point3D<float> AtomSet::rotationCenter() const
-/// Returns the optimal center of rotation for the molecule.
+/// Returns the optimal center of rotation for the molecule. This is the center
+/// of the smallest box surrounding the atoms.
 {
+  updateBoxDimensions();
   return Point3D<float>(static_cast<float>((boxMax->x() + boxMin->x())/2.0),
                         static_cast<float>((boxMax->y() + boxMin->y())/2.0),
                         static_cast<float>((boxMax->z() + boxMin->z())/2.0));
 }
 
+///// boundingSphereRadius ////////////////////////////////////////////////////
+double AtomSet::boundingSphereRadius() const
+/// Returns the radius of the smallest sphere around rotationCenter containing
+/// all atoms, with each atom drawn as a sphere of half its Van der Waals
+/// radius. The result is calculated once for each version of the geometry.
+{
+  if(cache.radiusVersion == version)
+    return cache.radius;
+  cache.radiusVersion = version;
+
+  updateBoxDimensions();
+  const double centerX = (boxMax->x() + boxMin->x())/2.0;
+  const double centerY = (boxMax->y() + boxMin->y())/2.0;
+  const double centerZ = (boxMax->z() + boxMin->z())/2.0;
+  double radius = 0.0;
+  for(unsigned int i = 0; i < numAtoms; i++)
+  {
+    const double x = coordsX[i] - centerX;
+    const double y = coordsY[i] - centerY;
+    const double z = coordsZ[i] - centerZ;
+    radius = std::max(radius, sqrt(x*x + y*y + z*z) + vanderWaals(elements[i])/2.0);
+  }
+  cache.radius = radius;
+  return radius;
+}
+
 //// needsExtendedFormat //////////////////////////////////////////////////////
-bool AtomSet::needsExtendedFormat()
+bool AtomSet::needsExtendedFormat() const
 /// Returns true if the coordinates need to be written in BRABO's extended
 /// format in order to prevent clipping. This is needed as soon as one coordinate
 /// value is at least 100.0 or a negative value at least -10.0.
@@ -1045,35 +1310,246 @@ bool AtomSet::needsExtendedFormat()
          boxMin->x() <= -10.0 || boxMin->y() <= -10.0 || boxMin->z() <= -10.0);
 }
 
-///// ramSize /////////////////////////////////////////////////////////////////
-unsigned int AtomSet::ramSize() const
-/// Returns the size of the class in bytes
+///// atomsInSphere ///////////////////////////////////////////////////////////
+vector<unsigned int> AtomSet::atomsInSphere(const Point3D<double>& center, const double radius) const
+/// Returns the indices of all atoms within a distance radius of center in
+/// ascending order. Only the cells overlapping the sphere are searched.
 {
-  unsigned int result = sizeof(this);
-  result += numAtoms * (sizeof(Point3D<double>) + sizeof(QColor));
-  if(forces != NULL)
-    result += numAtoms * sizeof(Point3D<double>);
-  result += bonds1.size() * 2 * sizeof(unsigned int);
-  if(chargesMulliken != NULL)
-    result += numAtoms * sizeof(double);
-  if(chargesStockholder != NULL)
-    result += numAtoms * sizeof(double);
-  result += coordsPC.size() * sizeof(Point3D<double>);
-  result += chargesPC.size() * sizeof(double);
-  //qDebug("AtomSet::ramSize: returning %d bytes (%d KB, %d MB)", result, result/1024, result/(1024*1024));
+  vector<unsigned int> result;
+  updateSpatialCells();
+  if(numAtoms == 0 || radius < 0.0)
+    return result;
+
+  const BondCells& cells = spatialCells;
+  const unsigned int firstX = cellCoordinate(center.x() - radius, cells.minX, cells.numX);
+  const unsigned int firstY = cellCoordinate(center.y() - radius, cells.minY, cells.numY);
+  const unsigned int firstZ = cellCoordinate(center.z() - radius, cells.minZ, cells.numZ);
+  const unsigned int lastX = cellCoordinate(center.x() + radius, cells.minX, cells.numX);
+  const unsigned int lastY = cellCoordinate(center.y() + radius, cells.minY, cells.numY);
+  const unsigned int lastZ = cellCoordinate(center.z() + radius, cells.minZ, cells.numZ);
+  const double radius2 = radius*radius;
+  for(unsigned int cellZ = firstZ; cellZ <= lastZ; cellZ++)
+  {
+    for(unsigned int cellY = firstY; cellY <= lastY; cellY++)
+    {
+      for(unsigned int cellX = firstX; cellX <= lastX; cellX++)
+      {
+        const vector<unsigned int>& atoms = cells.atoms[cellX + cells.numX*cellY + cells.numX*cells.numY*cellZ];
+        for(vector<unsigned int>::const_iterator it = atoms.begin(); it != atoms.end(); it++)
+        {
+          const double dx = coordsX[*it] - center.x();
+          const double dy = coordsY[*it] - center.y();
+          const double dz = coordsZ[*it] - center.z();
+          if(dx*dx + dy*dy + dz*dz <= radius2)
+            result.push_back(*it);
+        }
+      }
+    }
+  }
+  std::sort(result.begin(), result.end());
   return result;
 }
-
-///// countPointCharges ///////////////////////////////////////////////////////
-unsigned int AtomSet::countPointCharges() const
-/// Returns the number of point charges
-{
-  return coordsPC.size();
-}
-
-///// pointChargeCoordinates //////////////////////////////////////////////////
-Point3D<double> AtomSet::pointChargeCoordinates(const unsigned int index) const
-/// Returns the coordinates for the given point charge
+
+///// nearestAtoms ////////////////////////////////////////////////////////////
+vector<unsigned int> AtomSet::nearestAtoms(const Point3D<double>& point, const unsigned int number) const
+/// Returns the indices of the number atoms closest to point, the closest one
+/// first. Atoms at the same distance are ordered by index. The cells are
+/// searched in shells around the cell containing point until no atom in the
+/// remaining cells can be closer than the ones already found.
+{
+  vector<unsigned int> result;
+  updateSpatialCells();
+  const unsigned int numWanted = number < numAtoms ? number : numAtoms;
+  if(numWanted == 0)
+    return result;
+
+  const BondCells& cells = spatialCells;
+  const int centerX = static_cast<int>(cellCoordinate(point.x(), cells.minX, cells.numX));
+  const int centerY = static_cast<int>(cellCoordinate(point.y(), cells.minY, cells.numY));
+  const int centerZ = static_cast<int>(cellCoordinate(point.z(), cells.minZ, cells.numZ));
+  const int maxShell = static_cast<int>(std::max(cells.numX, std::max(cells.numY, cells.numZ)));
+  vector< std::pair<double, unsigned int> > candidates; // squared distance and index
+  for(int shell = 0; shell <= maxShell; shell++)
+  {
+    ///// add the atoms of all cells at a distance shell from the center cell
+    const int firstZ = std::max(centerZ - shell, 0);
+    const int lastZ = std::min(centerZ + shell, static_cast<int>(cells.numZ) - 1);
+    const int firstY = std::max(centerY - shell, 0);
+    const int lastY = std::min(centerY + shell, static_cast<int>(cells.numY) - 1);
+    const int firstX = std::max(centerX - shell, 0);
+    const int lastX = std::min(centerX + shell, static_cast<int>(cells.numX) - 1);
+    for(int cellZ = firstZ; cellZ <= lastZ; cellZ++)
+    {
+      for(int cellY = firstY; cellY <= lastY; cellY++)
+      {
+        // inside the shell only the first and last cell of a row belong to it
+        const bool fullRow = std::abs(cellZ - centerZ) == shell || std::abs(cellY - centerY) == shell;
+        const int stepX = fullRow ? 1 : 2*shell;
+        for(int cellX = fullRow ? firstX : centerX - shell; cellX <= lastX; cellX += stepX)
+        {
+          if(cellX < 0)
+            continue;
+          const vector<unsigned int>& atoms = cells.atoms[cellX + cells.numX*cellY + cells.numX*cells.numY*cellZ];
+          for(vector<unsigned int>::const_iterator it = atoms.begin(); it != atoms.end(); it++)
+          {
+            const double dx = coordsX[*it] - point.x();
+            const double dy = coordsY[*it] - point.y();
+            const double dz = coordsZ[*it] - point.z();
+            candidates.push_back(std::make_pair(dx*dx + dy*dy + dz*dz, *it));
+          }
+        }
+      }
+    }
+
+    ///// stop if the atoms outside the shell are further away than the
+    ///// numWanted'th closest atom found up till now
+    if(candidates.size() >= numWanted)
+    {
+      std::nth_element(candidates.begin(), candidates.begin() + (numWanted - 1), candidates.end());
+      const double limit = shell*cellSize;
+      if(candidates[numWanted - 1].first <= limit*limit)
+        break;
+    }
+  }
+
+  std::partial_sort(candidates.begin(), candidates.begin() + numWanted, candidates.end());
+  result.reserve(numWanted);
+  for(unsigned int i = 0; i < numWanted; i++)
+    result.push_back(candidates[i].second);
+  return result;
+}
+
+///// atomsAlongRay ///////////////////////////////////////////////////////////
+vector<unsigned int> AtomSet::atomsAlongRay(const Point3D<double>& origin, const Point3D<double>& direction, const double radius) const
+/// Returns the indices of all atoms within a distance radius of the ray
+/// starting at origin in the given direction. They are ordered by their
+/// distance from origin along the ray, the closest one first. Only the cells
+/// near the part of the ray crossing the atoms are searched.
+{
+  vector<unsigned int> result;
+  updateSpatialCells();
+  const double length = sqrt(direction.x()*direction.x() + direction.y()*direction.y() + direction.z()*direction.z());
+  if(numAtoms == 0 || radius < 0.0 || length == 0.0)
+    return result;
+
+  const BondCells& cells = spatialCells;
+  const double rayOrigin[3] = {origin.x(), origin.y(), origin.z()};
+  const double rayDirection[3] = {direction.x()/length, direction.y()/length, direction.z()/length};
+  const double cellMin[3] = {cells.minX, cells.minY, cells.minZ};
+  const unsigned int cellNum[3] = {cells.numX, cells.numY, cells.numZ};
+
+  ///// clip the ray to the cells enlarged by radius
+  double tMin = 0.0;
+  double tMax = HUGE_VAL;
+  for(unsigned int axis = 0; axis < 3; axis++)
+  {
+    const double lower = cellMin[axis] - radius;
+    const double upper = cellMin[axis] + cellNum[axis]*cellSize + radius;
+    if(rayDirection[axis] == 0.0)
+    {
+      if(rayOrigin[axis] < lower || rayOrigin[axis] > upper)
+        return result;
+      continue;
+    }
+    double t1 = (lower - rayOrigin[axis])/rayDirection[axis];
+    double t2 = (upper - rayOrigin[axis])/rayDirection[axis];
+    if(t1 > t2)
+      std::swap(t1, t2);
+    tMin = std::max(tMin, t1);
+    tMax = std::min(tMax, t2);
+  }
+  if(tMin > tMax)
+    return result;
+
+  ///// visit the cells around points on the ray at most cellSize apart. Every
+  ///// point of the clipped ray is within cellSize/2 of one of them, so the
+  ///// cells within radius + cellSize/2 contain all atoms near the ray
+  const int range = static_cast<int>(ceil(radius/cellSize + 0.5));
+  const unsigned int numSteps = static_cast<unsigned int>(ceil((tMax - tMin)/cellSize));
+  const double step = numSteps == 0 ? 0.0 : (tMax - tMin)/numSteps;
+  vector<bool> visited(cells.atoms.size(), false);
+  vector< std::pair<double, unsigned int> > hits; // distance along the ray and index
+  const double radius2 = radius*radius;
+  for(unsigned int i = 0; i <= numSteps; i++)
+  {
+    const double t = tMin + i*step;
+    int center[3];
+    for(unsigned int axis = 0; axis < 3; axis++)
+      center[axis] = static_cast<int>(cellCoordinate(rayOrigin[axis] + t*rayDirection[axis], cellMin[axis], cellNum[axis]));
+    const int firstX = std::max(center[0] - range, 0);
+    const int lastX = std::min(center[0] + range, static_cast<int>(cells.numX) - 1);
+    const int firstY = std::max(center[1] - range, 0);
+    const int lastY = std::min(center[1] + range, static_cast<int>(cells.numY) - 1);
+    const int firstZ = std::max(center[2] - range, 0);
+    const int lastZ = std::min(center[2] + range, static_cast<int>(cells.numZ) - 1);
+    for(int cellZ = firstZ; cellZ <= lastZ; cellZ++)
+    {
+      for(int cellY = firstY; cellY <= lastY; cellY++)
+      {
+        for(int cellX = firstX; cellX <= lastX; cellX++)
+        {
+          const unsigned int cell = cellX + cells.numX*cellY + cells.numX*cells.numY*cellZ;
+          if(visited[cell])
+            continue;
+          visited[cell] = true;
+          for(vector<unsigned int>::const_iterator it = cells.atoms[cell].begin(); it != cells.atoms[cell].end(); it++)
+          {
+            const double vx = coordsX[*it] - rayOrigin[0];
+            const double vy = coordsY[*it] - rayOrigin[1];
+            const double vz = coordsZ[*it] - rayOrigin[2];
+            const double along = vx*rayDirection[0] + vy*rayDirection[1] + vz*rayDirection[2];
+            // atoms behind the origin are compared to the origin itself
+            const double distance2 = vx*vx + vy*vy + vz*vz - (along > 0.0 ? along*along : 0.0);
+            if(distance2 <= radius2)
+              hits.push_back(std::make_pair(along, *it));
+          }
+        }
+      }
+    }
+  }
+
+  std::sort(hits.begin(), hits.end());
+  result.reserve(hits.size());
+  for(vector< std::pair<double, unsigned int> >::const_iterator it = hits.begin(); it != hits.end(); it++)
+    result.push_back(it->second);
+  return result;
+}
+
+///// ramSize /////////////////////////////////////////////////////////////////
+unsigned int AtomSet::ramSize() const
+/// Returns the size of the class in bytes
+{
+  unsigned int result = sizeof(this);
+  result += numAtoms * (3*sizeof(double) + sizeof(unsigned char) + sizeof(unsigned short));
+  result += palette.size() * sizeof(QColor);
+  if(forces != NULL)
+    result += numAtoms * sizeof(Point3D<double>);
+  result += bonds1.size() * 2 * sizeof(unsigned int);
+  result += bondCells.cellOfAtom.size() * 2 * sizeof(unsigned int); // in cellOfAtom and atoms
+  result += bondCells.atoms.size() * sizeof(vector<unsigned int>);
+  if(cache.spatialCellsVersion == version)
+    result += numAtoms * sizeof(unsigned int) + spatialCells.atoms.size() * sizeof(vector<unsigned int>);
+  result += (neighbourOffsets.size() + neighbourCounts.size() + neighbourList.size()) * sizeof(unsigned int);
+  if(chargesMulliken != NULL)
+    result += numAtoms * sizeof(double);
+  if(chargesStockholder != NULL)
+    result += numAtoms * sizeof(double);
+  result += coordsPC.size() * sizeof(Point3D<double>);
+  result += chargesPC.size() * sizeof(double);
+  //qDebug("AtomSet::ramSize: returning %d bytes (%d KB, %d MB)", result, result/1024, result/(1024*1024));
+  return result;
+}
+
+///// countPointCharges ///////////////////////////////////////////////////////
+unsigned int AtomSet::countPointCharges() const
+/// Returns the number of point charges
+{
+  return coordsPC.size();
+}
+
+///// pointChargeCoordinates //////////////////////////////////////////////////
+Point3D<double> AtomSet::pointChargeCoordinates(const unsigned int index) const
+/// Returns the coordinates for the given point charge
 {
   assert(index < coordsPC.size());
 
@@ -1220,9 +1696,9 @@ void AtomSet::saveCML(QDomElement* root)
     childNode = root->ownerDocument().createElement("atom");
     childNode.setAttribute("id", QString(numToAtom(atomicNumber(i)).stripWhiteSpace() + QString::number(i + 1)));
     childNode.setAttribute("elementType", numToAtom(atomicNumber(i)).stripWhiteSpace());
-    childNode.setAttribute("x3", QString::number(coords[i].x(), 'f', 12));
-    childNode.setAttribute("y3", QString::number(coords[i].y(), 'f', 12));
-    childNode.setAttribute("z3", QString::number(coords[i].z(), 'f', 12));
+    childNode.setAttribute("x3", QString::number(coordsX[i], 'f', 12));
+    childNode.setAttribute("y3", QString::number(coordsY[i], 'f', 12));
+    childNode.setAttribute("z3", QString::number(coordsZ[i], 'f', 12));
     atomArray.appendChild(childNode);
     ///// color
     grandChildNode = root->ownerDocument().createElement("scalar");
@@ -1560,89 +2036,367 @@ void AtomSet::setGeometryChanged()
   clearProperties(); // properties like forces and charges do not coincide with the
                      // structure anymore
   ///// set 'dirty' flags for a number of other things
+  ///// (the bonds are updated separately as they depend on which atoms changed)
+  version = ++lastVersion; // invalidates all results derived from the geometry
+}
+
+///// setAtomMoved ////////////////////////////////////////////////////////////
+void AtomSet::setAtomMoved(const unsigned int index)
+/// Indicates the bonds of the atom at position index have to be recalculated.
+/// If too many atoms moved, all bonds will be recalculated instead.
+{
+  if(dirtyBonds || isMovedAtom[index])
+    return;
+  if(movedAtoms.size() >= numAtoms/movedAtomsRatio)
+  {
+    setBondsChanged();
+    return;
+  }
+  isMovedAtom[index] = true;
+  movedAtoms.push_back(index);
+}
+
+///// setBondsChanged /////////////////////////////////////////////////////////
+void AtomSet::setBondsChanged()
+/// Indicates all bonds have to be recalculated.
+{
+  dirtyBonds = true;
+  dirtyNeighbours = true;
+  dirtyBondList = false;
+  changedBondAtoms.clear();
   bonds1.clear();
   bonds2.clear();
-  dirtyBox = true;
-}
-
-///// addBondList /////////////////////////////////////////////////////
-bool AtomSet::addBondList(const unsigned int callingAtom, const unsigned int startAtom, const unsigned int endAtom1, const unsigned int endAtom2, std::vector<unsigned int>* result)
-/// Returns all direct and indirectly bonded atoms to startAtom in result.
-/// If any atom of this list (except startAtom) is bonded to endAtom, false is returned (indicates the presence of
-/// a ring-structure including the startAtom-endAtom bond. If true is returned the resulting list of bonded atoms
-/// is complete
-/// -> recursive !
-{
-  qDebug("entering AtomSet::addBondList");
-  ///// exit if callingAtom only has at most 1 bond
-  unsigned int numBonds = std::count(bonds1.begin(), bonds1.end(), callingAtom);
-  numBonds += std::count(bonds2.begin(), bonds2.end(), callingAtom);
-  if(numBonds == 0)
-    return false; // if the atom is not bonded, it is to be changed independently
-  if(numBonds == 1)
-  {
-    //qDebug("atom %d has only 1 bond.", callingAtom);
-    if(callingAtom == startAtom)
-      return false; // if startAtom is only bonded to endAtom, it can be changed indepedently
-    else
-      return true; // end of list has been reached
+  movedAtoms.clear();
+}
+
+///// insertBondAtoms /////////////////////////////////////////////////////////
+void AtomSet::insertBondAtoms(const unsigned int index, const unsigned int number)
+/// Updates the bonds for a number of atoms inserted at position index. The
+/// following atoms are renumbered and the bonds of the new atoms will be
+/// calculated.
+{
+  if(dirtyBonds)
+    return;
+
+  updateBondList();
+  dirtyNeighbours = true;
+  shiftBondIndices(index, number);
+  bondCells.cellOfAtom.insert(bondCells.cellOfAtom.begin() + index, number, noCell);
+  isMovedAtom.insert(isMovedAtom.begin() + index, number, false);
+  for(unsigned int i = index; i < index + number; i++)
+    setAtomMoved(i);
+}
+
+///// removeBondAtoms /////////////////////////////////////////////////////////
+void AtomSet::removeBondAtoms(const vector<bool>& removed)
+/// Updates the bonds for the removal of the atoms for which removed is true.
+/// Their bonds are removed and the remaining atoms are renumbered, all in a
+/// single pass over the bonds and the cells.
+{
+  if(dirtyBonds)
+    return;
+
+  updateBondList();
+  dirtyNeighbours = true;
+  // determine the new index of each remaining atom
+  vector<unsigned int> newIndex(removed.size());
+  unsigned int numKept = 0;
+  for(unsigned int i = 0; i < removed.size(); i++)
+    newIndex[i] = removed[i] ? noCell : numKept++;
+
+  // remove the bonds of the atoms
+  numKept = 0;
+  for(unsigned int i = 0; i < bonds1.size(); i++)
+  {
+    if(!removed[bonds1[i]] && !removed[bonds2[i]])
+    {
+      bonds1[numKept] = newIndex[bonds1[i]];
+      bonds2[numKept++] = newIndex[bonds2[i]];
+    }
   }
+  bonds1.resize(numKept);
+  bonds2.resize(numKept);
 
-  ///// more than 1 bond is present so further traverse the bond list
-  vector<unsigned int>::iterator it1 = bonds1.begin();
-  vector<unsigned int>::iterator it2 = bonds2.begin();
-  while(it1 != bonds1.end() && it2 != bonds2.end())
+  // remove the atoms from their cells
+  for(vector< vector<unsigned int> >::iterator cell = bondCells.atoms.begin(); cell != bondCells.atoms.end(); cell++)
   {
-    if(*it1 == callingAtom)
+    numKept = 0;
+    for(unsigned int i = 0; i < cell->size(); i++)
     {
-      // check for ring structures
-      if(*it2 == endAtom1 || *it2 == endAtom2)
-      {
-        if(callingAtom != startAtom)
-          return false;
-      }
-      else if(*it2 != startAtom)
+      if(!removed[cell->operator[](i)])
+        cell->operator[](numKept++) = newIndex[cell->operator[](i)];
+    }
+    cell->resize(numKept);
+  }
+
+  // remove the atoms from the list of moved atoms
+  numKept = 0;
+  for(unsigned int i = 0; i < movedAtoms.size(); i++)
+  {
+    if(!removed[movedAtoms[i]])
+      movedAtoms[numKept++] = newIndex[movedAtoms[i]];
+  }
+  movedAtoms.resize(numKept);
+
+  // remove the atoms from the per-atom data
+  numKept = 0;
+  for(unsigned int i = 0; i < removed.size(); i++)
+  {
+    if(!removed[i])
+    {
+      bondCells.cellOfAtom[numKept] = bondCells.cellOfAtom[i];
+      isMovedAtom[numKept++] = isMovedAtom[i];
+    }
+  }
+  bondCells.cellOfAtom.resize(numKept);
+  isMovedAtom.resize(numKept);
+}
+
+///// shiftBondIndices ////////////////////////////////////////////////////////
+void AtomSet::shiftBondIndices(const unsigned int first, const int amount)
+/// Adds amount to all atom indices of at least first in the bonds, the cells
+/// and the moved atoms.
+{
+  vector<unsigned int>::iterator it;
+  for(it = bonds1.begin(); it != bonds1.end(); it++)
+  {
+    if(*it >= first)
+      *it += amount;
+  }
+  for(it = bonds2.begin(); it != bonds2.end(); it++)
+  {
+    if(*it >= first)
+      *it += amount;
+  }
+  for(vector< vector<unsigned int> >::iterator cell = bondCells.atoms.begin(); cell != bondCells.atoms.end(); cell++)
+  {
+    for(it = cell->begin(); it != cell->end(); it++)
+    {
+      if(*it >= first)
+        *it += amount;
+    }
+  }
+  for(it = movedAtoms.begin(); it != movedAtoms.end(); it++)
+  {
+    if(*it >= first)
+      *it += amount;
+  }
+}
+
+///// updateNeighbours ////////////////////////////////////////////////////////
+void AtomSet::updateNeighbours() const
+/// Updates the lists of atoms bonded to each atom. They are only rebuilt
+/// completely when the bonds were recalculated or atoms were added or
+/// removed, as updateBonds keeps them up to date for moved atoms.
+{
+  if(dirtyBonds)
+    findAllBonds();
+  else if(!movedAtoms.empty())
+    updateBonds();
+  if(dirtyNeighbours)
+    buildNeighbours();
+}
+
+///// buildNeighbours /////////////////////////////////////////////////////////
+void AtomSet::buildNeighbours() const
+/// Rebuilds the lists of atoms bonded to each atom from the bonds. The lists
+/// are stored one after another in neighbourList, with the list of atom i
+/// starting at neighbourOffsets[i] and containing neighbourCounts[i] atoms in
+/// increasing order. Each list is followed by neighbourSlack free positions
+/// for new bonds. From now on the lists hold the bonds, so the bonds will be
+/// rebuilt from them in canonical order.
+{
+  // count the bonds of each atom
+  neighbourCounts.assign(numAtoms, 0);
+  for(unsigned int i = 0; i < bonds1.size(); i++)
+  {
+    neighbourCounts[bonds1[i]]++;
+    neighbourCounts[bonds2[i]]++;
+  }
+  neighbourOffsets.resize(numAtoms + 1);
+  neighbourOffsets[0] = 0;
+  for(unsigned int i = 0; i < numAtoms; i++)
+    neighbourOffsets[i + 1] = neighbourOffsets[i] + neighbourCounts[i] + neighbourSlack;
+
+  // fill the lists
+  vector<unsigned int> position(neighbourOffsets.begin(), neighbourOffsets.end() - 1);
+  neighbourList.resize(neighbourOffsets[numAtoms]);
+  for(unsigned int i = 0; i < bonds1.size(); i++)
+  {
+    neighbourList[position[bonds1[i]]++] = bonds2[i];
+    neighbourList[position[bonds2[i]]++] = bonds1[i];
+  }
+  for(unsigned int i = 0; i < numAtoms; i++)
+    std::sort(neighbourList.begin() + neighbourOffsets[i], neighbourList.begin() + position[i]);
+  dirtyNeighbours = false;
+  dirtyBondList = true;
+  changedBondAtoms.clear();
+}
+
+///// addBond /////////////////////////////////////////////////////////////////
+void AtomSet::addBond(const unsigned int atom1, const unsigned int atom2) const
+/// Adds a bond between atom1 and atom2 to the lists of bonded atoms, which
+/// have to be up to date.
+{
+  insertNeighbour(atom1, atom2);
+  insertNeighbour(atom2, atom1);
+  changedBondAtoms.push_back(std::min(atom1, atom2));
+}
+
+///// expandNeighbours ////////////////////////////////////////////////////////
+void AtomSet::expandNeighbours() const
+/// Moves the lists of bonded atoms apart so each one is followed by
+/// neighbourSlack free positions again. This is only needed when an atom
+/// gains more bonds than there were free positions.
+{
+  vector<unsigned int> newOffsets(neighbourOffsets.size());
+  newOffsets[0] = 0;
+  for(unsigned int i = 0; i < neighbourCounts.size(); i++)
+    newOffsets[i + 1] = newOffsets[i] + neighbourCounts[i] + neighbourSlack;
+  vector<unsigned int> newList(newOffsets.back());
+  for(unsigned int i = 0; i < neighbourCounts.size(); i++)
+    std::copy(neighbourList.begin() + neighbourOffsets[i], neighbourList.begin() + neighbourOffsets[i] + neighbourCounts[i], newList.begin() + newOffsets[i]);
+  neighbourOffsets.swap(newOffsets);
+  neighbourList.swap(newList);
+}
+
+///// insertNeighbour /////////////////////////////////////////////////////////
+void AtomSet::insertNeighbour(const unsigned int atom, const unsigned int neighbour) const
+/// Adds neighbour to the list of atoms bonded to atom, keeping the list
+/// sorted.
+{
+  if(neighbourOffsets[atom] + neighbourCounts[atom] == neighbourOffsets[atom + 1])
+    expandNeighbours();
+  vector<unsigned int>::iterator first = neighbourList.begin() + neighbourOffsets[atom];
+  vector<unsigned int>::iterator last = first + neighbourCounts[atom]++;
+  vector<unsigned int>::iterator position = std::upper_bound(first, last, neighbour);
+  std::copy_backward(position, last, last + 1);
+  *position = neighbour;
+}
+
+///// removeNeighbour /////////////////////////////////////////////////////////
+void AtomSet::removeNeighbour(const unsigned int atom, const unsigned int neighbour) const
+/// Removes neighbour from the sorted list of atoms bonded to atom. The order
+/// of the remaining atoms is kept.
+{
+  vector<unsigned int>::iterator first = neighbourList.begin() + neighbourOffsets[atom];
+  vector<unsigned int>::iterator last = first + neighbourCounts[atom]--;
+  vector<unsigned int>::iterator position = std::lower_bound(first, last, neighbour);
+  std::copy(position + 1, last, position);
+}
+
+///// updateBondList //////////////////////////////////////////////////////////
+void AtomSet::updateBondList()
+/// Updates the bonds from the lists of bonded atoms. Each bond is added once,
+/// by the atom with the lowest index, so the bonds are sorted on the first and
+/// then on the second atom. After the bonds of some atoms were updated only
+/// the blocks of bonds starting at the atoms in changedBondAtoms are replaced.
+{
+  if(!dirtyBondList)
+  {
+    if(changedBondAtoms.empty())
+      return;
+
+    std::sort(changedBondAtoms.begin(), changedBondAtoms.end());
+    changedBondAtoms.erase(std::unique(changedBondAtoms.begin(), changedBondAtoms.end()), changedBondAtoms.end());
+    vector<unsigned int> newBonds1, newBonds2;
+    newBonds1.reserve(bonds1.size() + neighbourSlack*changedBondAtoms.size());
+    newBonds2.reserve(bonds2.size() + neighbourSlack*changedBondAtoms.size());
+    vector<unsigned int>::iterator first = bonds1.begin();
+    for(vector<unsigned int>::const_iterator it = changedBondAtoms.begin(); it != changedBondAtoms.end(); it++)
+    {
+      // keep the bonds up to the block of the atom
+      vector<unsigned int>::iterator last = std::lower_bound(first, bonds1.end(), *it);
+      newBonds1.insert(newBonds1.end(), first, last);
+      newBonds2.insert(newBonds2.end(), bonds2.begin() + (first - bonds1.begin()), bonds2.begin() + (last - bonds1.begin()));
+      first = std::upper_bound(last, bonds1.end(), *it);
+      // replace the block
+      for(unsigned int j = neighbourOffsets[*it]; j < neighbourOffsets[*it] + neighbourCounts[*it]; j++)
       {
-        // check whether the bonded atom is already in the list
-        if(std::find(result->begin(), result->end(), *it2) == result->end())
+        if(neighbourList[j] > *it)
         {
-          // add the bond
-          result->push_back(*it2);
-          //qDebug("adding the bond between atoms %d and %d", callingAtom, *it2);
-
-          // look for indirect bonds
-          if(!addBondList(*it2, startAtom, endAtom1, endAtom2, result))
-            return false;
+          newBonds1.push_back(*it);
+          newBonds2.push_back(neighbourList[j]);
         }
       }
     }
-    else if(*it2 == callingAtom)
+    newBonds1.insert(newBonds1.end(), first, bonds1.end());
+    newBonds2.insert(newBonds2.end(), bonds2.begin() + (first - bonds1.begin()), bonds2.end());
+    bonds1.swap(newBonds1);
+    bonds2.swap(newBonds2);
+    changedBondAtoms.clear();
+    return;
+  }
+
+  unsigned int numBonds = 0;
+  for(unsigned int i = 0; i < neighbourCounts.size(); i++)
+    numBonds += neighbourCounts[i];
+  bonds1.clear();
+  bonds2.clear();
+  bonds1.reserve(numBonds/2);
+  bonds2.reserve(numBonds/2);
+  for(unsigned int i = 0; i < neighbourCounts.size(); i++)
+  {
+    for(unsigned int j = neighbourOffsets[i]; j < neighbourOffsets[i] + neighbourCounts[i]; j++)
     {
-      // check for ring structures
-      if(*it1 == endAtom1 || *it1 == endAtom2)
+      if(neighbourList[j] > i)
       {
-        if(callingAtom != startAtom)
-          return false;
+        bonds1.push_back(i);
+        bonds2.push_back(neighbourList[j]);
       }
-      else if(*it1 != startAtom)
-      {
-        // check whether the bonded atom is already in the list
-        if(std::find(result->begin(), result->end(), *it1) == result->end())
-        {
-          // add the bond
-          result->push_back(*it1);
-          //qDebug("adding the bond between atoms %d and %d", callingAtom, *it1);
+    }
+  }
+  dirtyBondList = false;
+  changedBondAtoms.clear();
+}
 
-          // look for indirect bonds
-          if(!addBondList(*it1, startAtom, endAtom1, endAtom2, result))
-            return false;
-        }
+///// addBondList /////////////////////////////////////////////////////////////
+bool AtomSet::addBondList(const unsigned int startAtom, const unsigned int endAtom1, const unsigned int endAtom2, std::vector<unsigned int>* result)
+/// Returns all atoms directly and indirectly bonded to startAtom, except
+/// through its bonds to endAtom1 and endAtom2, in result. If any of these atoms
+/// is bonded to endAtom1 or endAtom2, false is returned, which indicates the
+/// presence of a ring structure including the startAtom-endAtom bond. If
+/// startAtom has at most 1 bond false is returned as well, as it can be
+/// changed independently. If true is returned the list of bonded atoms is
+/// complete. The atoms are visited breadth-first, with result as the queue.
+{
+  updateNeighbours();
+  if(numberOfBonds(startAtom) < 2)
+    return false;
+
+  vector<bool> visited(numAtoms, false);
+  visited[startAtom] = true;
+  const unsigned int firstAtom = result->size();
+
+  // the atoms bonded to startAtom
+  unsigned int i;
+  for(i = neighbourOffsets[startAtom]; i < neighbourOffsets[startAtom] + neighbourCounts[startAtom]; i++)
+  {
+    const unsigned int atom = neighbourList[i];
+    if(atom != endAtom1 && atom != endAtom2 && !visited[atom])
+    {
+      visited[atom] = true;
+      result->push_back(atom);
+    }
+  }
+
+  // the atoms bonded to the atoms in the list
+  for(unsigned int index = firstAtom; index < result->size(); index++)
+  {
+    const unsigned int current = result->operator[](index);
+    for(i = neighbourOffsets[current]; i < neighbourOffsets[current] + neighbourCounts[current]; i++)
+    {
+      const unsigned int atom = neighbourList[i];
+      if(atom == endAtom1 || atom == endAtom2)
+        return false; // ring structure
+      if(!visited[atom])
+      {
+        visited[atom] = true;
+        result->push_back(atom);
       }
     }
-    it1++;
-    it2++;
   }
-  return true; // surpresses a warning
+  return true;
 }
 
 ///// clearProperties /////////////////////////////////////////////////////////
@@ -1671,13 +2425,13 @@ void AtomSet::clearProperties()
 }
 
 ///// updateBoxDimensions /////////////////////////////////////////////////////
-void AtomSet::updateBoxDimensions()
+void AtomSet::updateBoxDimensions() const
 /// Calculates the dimensions of the smallest box (in the XYZ coordinate system)
 /// including all atoms.
 {
-  if(!dirtyBox)
+  if(cache.boxVersion == version)
     return;
-  dirtyBox = false;
+  cache.boxVersion = version;
 
   if(numAtoms == 0)
   {
@@ -1686,36 +2440,537 @@ void AtomSet::updateBoxDimensions()
   }
   else
   {
-    double maxx = coords[0].x();
-    double maxy = coords[0].y();
-    double maxz = coords[0].z();
+    // each direction is a separate pass over a contiguous array
+    double maxx = coordsX[0];
     double minx = maxx;
+    for(unsigned int i = 1; i < numAtoms; i++)
+    {
+      maxx = coordsX[i] > maxx ? coordsX[i] : maxx;
+      minx = coordsX[i] < minx ? coordsX[i] : minx;
+    }
+    double maxy = coordsY[0];
     double miny = maxy;
+    for(unsigned int i = 1; i < numAtoms; i++)
+    {
+      maxy = coordsY[i] > maxy ? coordsY[i] : maxy;
+      miny = coordsY[i] < miny ? coordsY[i] : miny;
+    }
+    double maxz = coordsZ[0];
     double minz = maxz;
     for(unsigned int i = 1; i < numAtoms; i++)
     {
-      if(coords[i].x() > maxx)
-        maxx = coords[i].x();
-      else if(coords[i].x() < minx)
-        minx = coords[i].x();
-      if(coords[i].y() > maxy)
-        maxy = coords[i].y();
-      else if(coords[i].y() < miny)
-        miny = coords[i].y();
-      if(coords[i].z() > maxz)
-        maxz = coords[i].z();
-      else if(coords[i].z() < minz)
-        minz = coords[i].z();
+      maxz = coordsZ[i] > maxz ? coordsZ[i] : maxz;
+      minz = coordsZ[i] < minz ? coordsZ[i] : minz;
     }
     boxMax->setValues(maxx, maxy, maxz);
     boxMin->setValues(minx, miny, minz);
   }
 }
 
+///// findAllBonds ////////////////////////////////////////////////////////////
+void AtomSet::findAllBonds() const
+/// Calculates all bonds. This routine puts atoms in boxes of 4x4x4 Angstrom and
+/// only looks for bonds between neighbouring boxes. For large systems the
+/// planes of boxes are divided over multiple threads. Their bonds are merged in
+/// the order of the planes, so the result does not depend on the number of
+/// threads. The boxes are kept for updating the bonds of moved atoms.
+{
+  QTime timer;
+  timer.start();
+  dirtyBonds = false;
+  dirtyNeighbours = true;
+  dirtyBondList = false;
+  changedBondAtoms.clear();
+  bonds1.clear();
+  bonds2.clear();
+  movedAtoms.clear();
+  isMovedAtom.assign(numAtoms, false);
+  BondCells& cells = bondCells;
+  cells.atoms.clear();
+  cells.cellOfAtom.assign(numAtoms, noCell);
+  if(numAtoms == 0)
+  {
+    cells.numX = cells.numY = cells.numZ = 0;
+    return;
+  }
+
+  // reserve some space (guesstimate of the number of bonds to be generated, normally between 0.67x and 1x the number of atoms)
+  bonds1.reserve(numAtoms);
+  bonds2.reserve(numAtoms);
+  // divide the box surrounding the atoms into cells of 4x4x4 Angstrom
+  setupCells(cells);
+
+  // assign all atoms to their cells
+  for(unsigned int i = 0; i < numAtoms; i++)
+  {
+    const unsigned int cell = bondCell(i);
+    if(cell != noCell)
+    {
+      cells.atoms[cell].push_back(i);
+      cells.cellOfAtom[i] = cell;
+    }
+  }
+
+  const unsigned int numThreads = numAtoms < parallelBondAtoms ? 1 : std::min(SystemInfo::numProcessors(), cells.numZ);
+  if(numThreads == 1)
+  {
+    for(unsigned int cellZ = 0; cellZ < cells.numZ; cellZ++)
+      addPlaneBonds(cells, cellZ, bonds1, bonds2);
+  }
+  else
+  {
+    // each plane gets its own list of bonds
+    vector< vector<unsigned int> > planeBonds1(cells.numZ), planeBonds2(cells.numZ);
+    QMutex planeMutex;
+    unsigned int nextPlane = 0;
+    vector<BondWorker*> pool;
+    for(unsigned int i = 0; i < numThreads; i++)
+    {
+      pool.push_back(new BondWorker(this, &cells, &planeBonds1, &planeBonds2, &planeMutex, &nextPlane));
+      pool.back()->start();
+    }
+    for(unsigned int i = 0; i < numThreads; i++)
+    {
+      pool[i]->wait();
+      delete pool[i];
+    }
+    // merge the lists in the order of the planes
+    unsigned int numBonds = 0;
+    for(unsigned int cellZ = 0; cellZ < cells.numZ; cellZ++)
+      numBonds += planeBonds1[cellZ].size();
+    bonds1.reserve(numBonds);
+    bonds2.reserve(numBonds);
+    for(unsigned int cellZ = 0; cellZ < cells.numZ; cellZ++)
+    {
+      bonds1.insert(bonds1.end(), planeBonds1[cellZ].begin(), planeBonds1[cellZ].end());
+      bonds2.insert(bonds2.end(), planeBonds2[cellZ].begin(), planeBonds2[cellZ].end());
+    }
+  }
+  qDebug("bonds generation took %f seconds using %d threads", timer.restart()/1000.0f, numThreads);
+  // old unoptimized code (44 times slower for 8870 atoms of acetone cluster, 25 times slower for GFP)
+  /*if(bonds1.empty() && numAtoms != 0) // only recalculate when necessary
+  {
+    float distance2, refdistance, dx, dy, dz;
+    unsigned int numBonds = 0;
+    unsigned int atomNumI, atomNumJ;
+
+    ///// do a double loop over all atoms and check whether the sum of their
+    ///// Van der Waals radii is less than the distance between them
+    ///// use the squared distances for speed
+    for(unsigned int i = 0; i < numAtoms; i++)
+    {
+      atomNumI = atomicNumbers[i];
+      if(atomNumI == 0)
+        continue;
+      for(unsigned int j = 0; j < i; j++)
+      {
+        atomNumJ = atomicNumbers[j];
+        if(atomNumJ == 0)
+          continue;
+        dx = static_cast<float>(coordsX[i] - coordsX[j]);
+        dy = static_cast<float>(coordsY[i] - coordsY[j]);
+        dz = static_cast<float>(coordsZ[i] - coordsZ[j]);
+        distance2 = dx*dx + dy*dy +dz*dz;
+        refdistance = 1.25f*(vanderWaals(atomNumI) + vanderWaals(atomNumJ));
+        if(distance2 <= refdistance*refdistance)
+        {
+          numBonds++;
+          if(numBonds == bonds1.max_size())
+          {
+            qDebug("AtomSet::bonds: the maximum number of bonds has been reached.");
+            first = &bonds1;
+            second = &bonds2;
+            return;
+          }
+          bonds1.push_back(i);
+          bonds2.push_back(j);
+        }
+      }
+    }
+    qDebug("old bonds generation took %f seconds", timer.restart()/1000.0f);
+  }
+  */
+}
+
+///// updateBonds /////////////////////////////////////////////////////////////
+void AtomSet::updateBonds() const
+/// Recalculates the bonds of the atoms in movedAtoms. Their old bonds are
+/// found through the lists of bonded atoms and removed, they are moved to
+/// their new cells and only their distances to the atoms in the surrounding
+/// cells are checked. Only the lists of bonded atoms are patched, so the work
+/// does not depend on the size of the system. Only after atoms were added or
+/// removed the lists are rebuilt first.
+{
+  if(dirtyNeighbours)
+    buildNeighbours();
+
+  // remove the old bonds of the moved atoms
+  vector<unsigned int>::const_iterator it;
+  for(it = movedAtoms.begin(); it != movedAtoms.end(); it++)
+  {
+    for(unsigned int i = neighbourOffsets[*it]; i < neighbourOffsets[*it] + neighbourCounts[*it]; i++)
+    {
+      if(isMovedAtom[neighbourList[i]])
+        continue;
+      removeNeighbour(neighbourList[i], *it);
+      if(neighbourList[i] < *it)
+        changedBondAtoms.push_back(neighbourList[i]);
+    }
+    neighbourCounts[*it] = 0;
+    changedBondAtoms.push_back(*it);
+  }
+
+  // move the atoms to their new cells
+  for(it = movedAtoms.begin(); it != movedAtoms.end(); it++)
+  {
+    const unsigned int oldCell = bondCells.cellOfAtom[*it];
+    const unsigned int newCell = bondCell(*it);
+    if(newCell == oldCell)
+      continue;
+    if(oldCell != noCell)
+    {
+      vector<unsigned int>& cellAtoms = bondCells.atoms[oldCell];
+      cellAtoms.erase(std::find(cellAtoms.begin(), cellAtoms.end(), *it));
+    }
+    if(newCell != noCell)
+      bondCells.atoms[newCell].push_back(*it);
+    bondCells.cellOfAtom[*it] = newCell;
+  }
+
+  // check the atoms in the cell of each moved atom and the 26 surrounding cells
+  const unsigned int cellsXY = bondCells.numX * bondCells.numY;
+  for(it = movedAtoms.begin(); it != movedAtoms.end(); it++)
+  {
+    const unsigned int cell = bondCells.cellOfAtom[*it];
+    if(cell == noCell)
+      continue;
+    const unsigned int cellX = cell % bondCells.numX;
+    const unsigned int cellY = (cell / bondCells.numX) % bondCells.numY;
+    const unsigned int cellZ = cell / cellsXY;
+    for(unsigned int z = (cellZ == 0 ? 0 : cellZ - 1); z <= cellZ + 1 && z < bondCells.numZ; z++)
+    {
+      for(unsigned int y = (cellY == 0 ? 0 : cellY - 1); y <= cellY + 1 && y < bondCells.numY; y++)
+      {
+        for(unsigned int x = (cellX == 0 ? 0 : cellX - 1); x <= cellX + 1 && x < bondCells.numX; x++)
+        {
+          const vector<unsigned int>& cellAtoms = bondCells.atoms[x + bondCells.numX*y + cellsXY*z];
+          for(vector<unsigned int>::const_iterator other = cellAtoms.begin(); other != cellAtoms.end(); other++)
+          {
+            // a bond between two moved atoms is only added by the one with the lowest index
+            if(*other == *it || (isMovedAtom[*other] && *other < *it))
+              continue;
+            if(isBonded(*it, *other))
+              addBond(*it, *other);
+          }
+        }
+      }
+    }
+  }
+
+  // all bonds are up to date
+  for(it = movedAtoms.begin(); it != movedAtoms.end(); it++)
+    isMovedAtom[*it] = false;
+  movedAtoms.clear();
+}
+
+///// bondCell ////////////////////////////////////////////////////////////////
+unsigned int AtomSet::bondCell(const unsigned int index) const
+/// Returns the cell of bondCells containing the atom at position index, or
+/// noCell if it cannot have bonds. Atoms outside the cells are assigned to the
+/// nearest one, which keeps neighbouring atoms in neighbouring cells.
+{
+  if(elements[index] == 0) // check for point charges, because they never have bonds
+    return noCell;
+
+  return cellIndex(bondCells, coordsX[index], coordsY[index], coordsZ[index]);
+}
+
+///// setupCells //////////////////////////////////////////////////////////////
+void AtomSet::setupCells(BondCells& cells) const
+/// Divides the smallest box surrounding the atoms into empty cubic cells with
+/// sides of cellSize.
+{
+  updateBoxDimensions();
+  cells.numX = static_cast<unsigned int>((boxMax->x() - boxMin->x())/cellSize) + 1;
+  cells.numY = static_cast<unsigned int>((boxMax->y() - boxMin->y())/cellSize) + 1;
+  cells.numZ = static_cast<unsigned int>((boxMax->z() - boxMin->z())/cellSize) + 1;
+  cells.minX = boxMin->x();
+  cells.minY = boxMin->y();
+  cells.minZ = boxMin->z();
+  cells.atoms.clear();
+  cells.atoms.resize(cells.numX * cells.numY * cells.numZ); // each cell contains a vector of all assigned atom indices
+}
+
+///// updateSpatialCells //////////////////////////////////////////////////////
+void AtomSet::updateSpatialCells() const
+/// Divides all atoms over the cells of spatialCells if the geometry changed.
+/// Unlike bondCells these also contain the atoms that cannot have bonds.
+{
+  if(cache.spatialCellsVersion == version)
+    return;
+  cache.spatialCellsVersion = version;
+
+  spatialCells.atoms.clear();
+  if(numAtoms == 0)
+  {
+    spatialCells.numX = spatialCells.numY = spatialCells.numZ = 0;
+    return;
+  }
+  setupCells(spatialCells);
+  for(unsigned int i = 0; i < numAtoms; i++)
+    spatialCells.atoms[cellIndex(spatialCells, coordsX[i], coordsY[i], coordsZ[i])].push_back(i);
+}
+
+///// resetPalette //////////////////////////////////////////////////////////////
+void AtomSet::resetPalette()
+/// Fills the palette with the standard colors of the elements only.
+{
+  palette.clear();
+  palette.reserve(maxElements + 1);
+  for(unsigned int i = 0; i <= maxElements; i++)
+    palette.push_back(stdColor(i));
+  customColors.clear();
+}
+
+///// findPaletteEntry ////////////////////////////////////////////////////////
+unsigned short AtomSet::findPaletteEntry(const QColor& color, const unsigned int atomicNumber)
+/// Returns the entry of the palette holding color for an atom of type
+/// atomicNumber. Most atoms have the standard color of their element, so that
+/// entry is checked first. Colors not present yet are added to the palette.
+{
+  if(color == palette[atomicNumber])
+    return atomicNumber;
+
+  std::map<unsigned int, unsigned short>::const_iterator it = customColors.find(color.rgb());
+  if(it != customColors.end())
+    return it->second;
+
+  if(palette.size() > USHRT_MAX)
+  {
+    compactPalette();
+    if(palette.size() > USHRT_MAX)
+    {
+      qDebug("AtomSet::findPaletteEntry: the maximum number of colors has been reached.");
+      return atomicNumber;
+    }
+  }
+  const unsigned short entry = palette.size();
+  palette.push_back(color);
+  customColors[color.rgb()] = entry;
+  return entry;
+}
+
+///// compactPalette //////////////////////////////////////////////////////////
+void AtomSet::compactPalette()
+/// Removes the custom colors that are no longer used by any atom from the
+/// palette.
+{
+  vector<bool> used(palette.size(), false);
+  for(vector<unsigned short>::const_iterator it = colorEntries.begin(); it != colorEntries.end(); it++)
+    used[*it] = true;
+
+  vector<unsigned short> newEntry(palette.size(), 0);
+  unsigned int numKept = maxElements + 1;
+  customColors.clear();
+  for(unsigned int i = maxElements + 1; i < palette.size(); i++)
+  {
+    if(used[i])
+    {
+      newEntry[i] = numKept;
+      palette[numKept] = palette[i];
+      customColors[palette[numKept].rgb()] = numKept;
+      numKept++;
+    }
+  }
+  palette.erase(palette.begin() + numKept, palette.end());
+  for(vector<unsigned short>::iterator it = colorEntries.begin(); it != colorEntries.end(); it++)
+  {
+    if(*it > maxElements)
+      *it = newEntry[*it];
+  }
+}
+
+///// cellIndex ///////////////////////////////////////////////////////////////
+unsigned int AtomSet::cellIndex(const BondCells& cells, const double x, const double y, const double z)
+/// Returns the cell of cells containing the point (x, y, z). Points outside the
+/// cells are assigned to the nearest one.
+{
+  return cellCoordinate(x, cells.minX, cells.numX) + cells.numX*cellCoordinate(y, cells.minY, cells.numY)
+         + cells.numX*cells.numY*cellCoordinate(z, cells.minZ, cells.numZ);
+}
+
+///// cellCoordinate //////////////////////////////////////////////////////////
+unsigned int AtomSet::cellCoordinate(const double value, const double minValue, const unsigned int numCells)
+/// Returns the position along one axis of the cell containing value, clamped to
+/// the range of numCells cells starting at minValue.
+{
+  const double plane = (value - minValue)/cellSize;
+  return plane < 0.0 ? 0 : (plane >= numCells ? numCells - 1 : static_cast<unsigned int>(plane));
+}
+
+///// isBonded ////////////////////////////////////////////////////////////////
+bool AtomSet::isBonded(const unsigned int atom1, const unsigned int atom2) const
+/// Returns whether two atoms with a known type are bonded. This is the case if 
+/// their distance is less than 1.25 times the sum of their Van der Waals radii.
+/// The test is identical to the one in addBonds.
+{
+  const float dx = static_cast<float>(coordsX[atom1] - coordsX[atom2]);
+  const float dy = static_cast<float>(coordsY[atom1] - coordsY[atom2]);
+  const float dz = static_cast<float>(coordsZ[atom1] - coordsZ[atom2]);
+  const float refdistance = 1.25f*(vanderWaals(elements[atom1]) + vanderWaals(elements[atom2]));
+  return dx*dx + dy*dy + dz*dz <= refdistance*refdistance;
+}
+
+///// bondValue /////////////////////////////////////////////////////////////
+double AtomSet::bondValue(const unsigned int* atoms) const
+/// Returns the distance between the atoms atoms[0] and atoms[1].
+{
+  const double dx = coordsX[atoms[1]] - coordsX[atoms[0]];
+  const double dy = coordsY[atoms[1]] - coordsY[atoms[0]];
+  const double dz = coordsZ[atoms[1]] - coordsZ[atoms[0]];
+  return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+///// angleValue //////////////////////////////////////////////////////////////
+double AtomSet::angleValue(const unsigned int* atoms) const
+/// Returns the valence angle atoms[0]-atoms[1]-atoms[2] in degrees.
+{
+  const double x1 = coordsX[atoms[0]] - coordsX[atoms[1]];
+  const double y1 = coordsY[atoms[0]] - coordsY[atoms[1]];
+  const double z1 = coordsZ[atoms[0]] - coordsZ[atoms[1]];
+  const double x2 = coordsX[atoms[2]] - coordsX[atoms[1]];
+  const double y2 = coordsY[atoms[2]] - coordsY[atoms[1]];
+  const double z2 = coordsZ[atoms[2]] - coordsZ[atoms[1]];
+  double cosine = (x1*x2 + y1*y2 + z1*z2)/sqrt((x1*x1 + y1*y1 + z1*z1)*(x2*x2 + y2*y2 + z2*z2));
+  cosine = std::max(-1.0, std::min(1.0, cosine)); // rounding errors for (nearly) linear angles
+  return acos(cosine)*Point3D<double>::RADTODEG;
+}
+
+///// torsionValue ////////////////////////////////////////////////////////////
+double AtomSet::torsionValue(const unsigned int* atoms) const
+/// Returns the torsion angle atoms[0]-atoms[1]-atoms[2]-atoms[3] in degrees,
+/// using the same convention as Vector3D::torsion.
+{
+  // the first bond, the central bond and the last bond
+  const double ax = coordsX[atoms[0]] - coordsX[atoms[1]];
+  const double ay = coordsY[atoms[0]] - coordsY[atoms[1]];
+  const double az = coordsZ[atoms[0]] - coordsZ[atoms[1]];
+  double bx = coordsX[atoms[2]] - coordsX[atoms[1]];
+  double by = coordsY[atoms[2]] - coordsY[atoms[1]];
+  double bz = coordsZ[atoms[2]] - coordsZ[atoms[1]];
+  const double cx = coordsX[atoms[3]] - coordsX[atoms[2]];
+  const double cy = coordsY[atoms[3]] - coordsY[atoms[2]];
+  const double cz = coordsZ[atoms[3]] - coordsZ[atoms[2]];
+  // only the length of the central bond matters
+  const double length = sqrt(bx*bx + by*by + bz*bz);
+  bx /= length;
+  by /= length;
+  bz /= length;
+  ///// -a.c + (a.b)(b.c) and a.(bxc) give the cosine and sine of the angle (apart from the sign)
+  const double argx = -(ax*cx + ay*cy + az*cz) + (ax*bx + ay*by + az*bz)*(bx*cx + by*cy + bz*cz);
+  const double argy = ax*(by*cz - bz*cy) + ay*(bz*cx - bx*cz) + az*(bx*cy - by*cx);
+  return atan2(-argy, -argx)*Point3D<double>::RADTODEG;
+}
+
+///// outOfPlaneValue /////////////////////////////////////////////////////////
+double AtomSet::outOfPlaneValue(const unsigned int* atoms) const
+/// Returns the angle in degrees between the bond atoms[1]-atoms[0] and the
+/// plane through atoms[1], atoms[2] and atoms[3].
+{
+  const double x1 = coordsX[atoms[0]] - coordsX[atoms[1]];
+  const double y1 = coordsY[atoms[0]] - coordsY[atoms[1]];
+  const double z1 = coordsZ[atoms[0]] - coordsZ[atoms[1]];
+  const double x2 = coordsX[atoms[2]] - coordsX[atoms[1]];
+  const double y2 = coordsY[atoms[2]] - coordsY[atoms[1]];
+  const double z2 = coordsZ[atoms[2]] - coordsZ[atoms[1]];
+  const double x3 = coordsX[atoms[3]] - coordsX[atoms[1]];
+  const double y3 = coordsY[atoms[3]] - coordsY[atoms[1]];
+  const double z3 = coordsZ[atoms[3]] - coordsZ[atoms[1]];
+  // the normal of the plane
+  const double nx = y2*z3 - z2*y3;
+  const double ny = z2*x3 - x2*z3;
+  const double nz = x2*y3 - y2*x3;
+  double sine = (x1*nx + y1*ny + z1*nz)/sqrt((x1*x1 + y1*y1 + z1*z1)*(nx*nx + ny*ny + nz*nz));
+  sine = std::max(-1.0, std::min(1.0, sine));
+  return asin(sine)*Point3D<double>::RADTODEG;
+}
+
+///// icValues ////////////////////////////////////////////////////////////////
+void AtomSet::icValues(const unsigned int type, const vector<unsigned int>& definitions, vector<double>& values) const
+/// Calculates the values of a list of internal coordinates of the given type.
+/// The atoms of each coordinate are stored consecutively in definitions. Long
+/// lists are divided into equal ranges over multiple threads.
+{
+  const unsigned int size = icSize(type);
+  assert(definitions.size() % size == 0);
+  assert(definitions.empty() || *std::max_element(definitions.begin(), definitions.end()) < numAtoms);
+
+  const unsigned int numValues = definitions.size()/size;
+  values.resize(numValues);
+  const unsigned int numThreads = numValues < parallelICValues ? 1 : SystemInfo::numProcessors();
+  if(numThreads == 1)
+  {
+    icValueRange(type, definitions, values, 0, numValues);
+    return;
+  }
+
+  vector<ICWorker*> pool;
+  for(unsigned int i = 0; i < numThreads; i++)
+  {
+    pool.push_back(new ICWorker(this, type, &definitions, &values, numValues*i/numThreads, numValues*(i + 1)/numThreads));
+    pool.back()->start();
+  }
+  for(unsigned int i = 0; i < numThreads; i++)
+  {
+    pool[i]->wait();
+    delete pool[i];
+  }
+}
+
+///// icValueRange ////////////////////////////////////////////////////////////
+void AtomSet::icValueRange(const unsigned int type, const vector<unsigned int>& definitions, vector<double>& values, const unsigned int first, const unsigned int last) const
+/// Calculates the internal coordinates from first up to last of a list.
+{
+  const unsigned int size = icSize(type);
+  const unsigned int* atoms = definitions.empty() ? 0 : &definitions[0];
+  switch(type)
+  {
+    case IC_BOND:
+      for(unsigned int i = first; i < last; i++)
+        values[i] = bondValue(atoms + size*i);
+      break;
+    case IC_ANGLE:
+      for(unsigned int i = first; i < last; i++)
+        values[i] = angleValue(atoms + size*i);
+      break;
+    case IC_TORSION:
+      for(unsigned int i = first; i < last; i++)
+        values[i] = torsionValue(atoms + size*i);
+      break;
+    case IC_OUTOFPLANE:
+      for(unsigned int i = first; i < last; i++)
+        values[i] = outOfPlaneValue(atoms + size*i);
+      break;
+  }
+}
+
+///// icSize //////////////////////////////////////////////////////////////////
+unsigned int AtomSet::icSize(const unsigned int type)
+/// Returns the number of atoms defining an internal coordinate of the given
+/// type.
+{
+  switch(type)
+  {
+    case IC_BOND:  return 2;
+    case IC_ANGLE: return 3;
+  }
+  return 4;
+}
+
 ///// addBonds ////////////////////////////////////////////////////////////////
-void AtomSet::addBonds(const vector<unsigned int>* atomList1, const vector<unsigned int>* atomList2)
+void AtomSet::addBonds(const vector<unsigned int>* atomList1, const vector<unsigned int>* atomList2, vector<unsigned int>& first, vector<unsigned int>& second) const
 /// Calculates all bonds between the atoms in the 2 provided lists and adds them
-/// to the bonds1 and bonds2 vectors
+/// to the first and second vectors
 {
   // check whether the second list contains any atoms (the first list is already checked in the
   // bonds function
@@ -1733,29 +2988,106 @@ void AtomSet::addBonds(const vector<unsigned int>* atomList1, const vector<unsig
   for(unsigned int i = 0; i < atomList1->size(); i++)
   {
     atomIndex1 = atomList1->operator[](i);
-    atomNum1 = coords[atomIndex1].id(); // can never be zero as that has been checked in bonds
+    atomNum1 = elements[atomIndex1]; // can never be zero as that has been checked in bonds
     if(atomList1 == atomList2)
       limit = i; // prevents bonds between same atoms or double counting of bonds between identical atom lists
     for(unsigned int j = 0; j < limit; j++)
     {
       atomIndex2 = atomList2->operator[](j);
-      dx = static_cast<float>(coords[atomIndex1].x() - coords[atomIndex2].x());
-      dy = static_cast<float>(coords[atomIndex1].y() - coords[atomIndex2].y());
-      dz = static_cast<float>(coords[atomIndex1].z() - coords[atomIndex2].z());
+      dx = static_cast<float>(coordsX[atomIndex1] - coordsX[atomIndex2]);
+      dy = static_cast<float>(coordsY[atomIndex1] - coordsY[atomIndex2]);
+      dz = static_cast<float>(coordsZ[atomIndex1] - coordsZ[atomIndex2]);
       distance2 = dx*dx + dy*dy +dz*dz;
-      refdistance = 1.25f*(vanderWaals(atomNum1) + vanderWaals(coords[atomIndex2].id()));
+      refdistance = 1.25f*(vanderWaals(atomNum1) + vanderWaals(elements[atomIndex2]));
       if(distance2 <= refdistance*refdistance)
       {
-        bonds1.push_back(atomIndex1);
-        bonds2.push_back(atomIndex2);
+        first.push_back(atomIndex1);
+        second.push_back(atomIndex2);
       }
     }
   }
 }
 
+///// addPlaneBonds ///////////////////////////////////////////////////////////
+void AtomSet::addPlaneBonds(const BondCells& cells, const unsigned int cellZ, vector<unsigned int>& first, vector<unsigned int>& second) const
+/// Calculates all bonds of the atoms in the cells of plane cellZ with the atoms
+/// in the same cell and in 13 of the 26 neighbouring cells, and adds them to
+/// the first and second vectors. Different planes can be handled at the same
+/// time.
+{
+  // loop over combinations of all cells and calculate bonds only if the cells
+  // are connected and cell2 has a larger index than cell1 in each direction
+  const unsigned int cellsXY = cells.numX * cells.numY;
+  const vector< vector<unsigned int> >& atomCell = cells.atoms;
+  unsigned int cellIndex = cellsXY*cellZ;
+  const vector<unsigned int>* atomList;
+  for(unsigned int cellY = 0; cellY < cells.numY; cellY++)
+  {
+    for(unsigned int cellX = 0; cellX < cells.numX; cellX++)
+    {
+      atomList = &atomCell[cellIndex++];
+      if(atomList->size() == 0)
+        continue; // an empty cell can be skipped
+      ///// find all surrounding cells (X/Y/Z, X+1/Y/Z, X/Y+1/Z, X/Y/Z+1, X+1/Y+1/Z, X+1/Y/Z+1, X/Y+1/Z+1, X+1/Y+1/Z+1,
+      /////                             X-1/Y/Z+1, X+1/Y+1/Z-1, X/Y+1/Z-1, X-1/Y+1/Z-1, X-1/Y+1/Z, X-1/Y+1/Z+1)
+      ///// other neighbouring cells (remaining of 13 total of 26) will already have been combined with this cell before
+      ///// (no double counting)
+      // X/Y/Z -> intra-cell bonds
+      addBonds(atomList, atomList, first, second);
+      // X+1/Y/Z
+      if(cellX != (cells.numX - 1))
+        addBonds(atomList, &atomCell[cellX+1 + cells.numX*cellY + cellsXY*cellZ], first, second);
+      // X/Y+1/Z
+      if(cellY != (cells.numY - 1))
+        addBonds(atomList, &atomCell[cellX + cells.numX*(cellY+1) + cellsXY*cellZ], first, second);
+      // X/Y/Z+1
+      if(cellZ != (cells.numZ - 1))
+        addBonds(atomList, &atomCell[cellX + cells.numX*cellY + cellsXY*(cellZ+1)], first, second);
+      // X+1/Y+1/Z
+      if(cellX != (cells.numX - 1) && cellY != (cells.numY - 1))
+        addBonds(atomList, &atomCell[(cellX+1) + cells.numX*(cellY+1) + cellsXY*cellZ], first, second);
+      // X+1/Y/Z+1
+      if(cellX != (cells.numX - 1) && cellZ != (cells.numZ - 1))
+        addBonds(atomList, &atomCell[(cellX+1) + cells.numX*cellY + cellsXY*(cellZ+1)], first, second);
+      // X/Y+1/Z+1
+      if(cellY != (cells.numY - 1) && cellZ != (cells.numZ - 1))
+        addBonds(atomList, &atomCell[cellX + cells.numX*(cellY+1) + cellsXY*(cellZ+1)], first, second);
+      // X+1/Y+1/Z+1
+      if(cellX != (cells.numX - 1) && cellY != (cells.numY - 1) && cellZ != (cells.numZ - 1))
+        addBonds(atomList, &atomCell[(cellX+1) + cells.numX*(cellY+1) + cellsXY*(cellZ+1)], first, second);
+      // X-1/Y/Z+1
+      if(cellX != 0 && cellZ != (cells.numZ - 1))
+        addBonds(atomList, &atomCell[(cellX-1) + cells.numX*cellY + cellsXY*(cellZ+1)], first, second);
+      // X+1/Y+1/Z-1
+      if(cellX != (cells.numX - 1) && cellY != (cells.numY - 1) && cellZ != 0)
+        addBonds(atomList, &atomCell[(cellX+1) + cells.numX*(cellY+1) + cellsXY*(cellZ-1)], first, second);
+      // X/Y+1/Z-1
+      if(cellY != (cells.numY - 1) && cellZ != 0)
+        addBonds(atomList, &atomCell[cellX + cells.numX*(cellY+1) + cellsXY*(cellZ-1)], first, second);
+      // X-1/Y+1/Z-1
+      if(cellX != 0 && cellY != (cells.numY - 1) && cellZ != 0)
+        addBonds(atomList, &atomCell[(cellX-1) + cells.numX*(cellY+1) + cellsXY*(cellZ-1)], first, second);
+      // X-1/Y+1/Z
+      if(cellX != 0 && cellY != (cells.numY - 1))
+        addBonds(atomList, &atomCell[(cellX-1) + cells.numX*(cellY+1) + cellsXY*cellZ], first, second);
+      // X-1/Y+1/Z+1
+      if(cellX != 0 && cellY != (cells.numY - 1) && cellZ != (cells.numZ - 1))
+        addBonds(atomList, &atomCell[(cellX-1) + cells.numX*(cellY+1) + cellsXY*(cellZ+1)], first, second);
+    }
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///// Static Variables                                                    /////
 ///////////////////////////////////////////////////////////////////////////////
 
 const unsigned int AtomSet::maxElements = 54;
+const unsigned int AtomSet::parallelBondAtoms = 20000;
+const unsigned int AtomSet::parallelICValues = 50000;
+const unsigned int AtomSet::movedAtomsRatio = 8;
+const unsigned int AtomSet::noCell = UINT_MAX;
+const unsigned int AtomSet::neighbourSlack = 2;
+// 4.0A because largest VdW radius = 3.0A => largest distance = 1.25*(3.0 + 3.0) = 7.5A < 2 * 4.0A
+const double AtomSet::cellSize = 4.0;
+unsigned int AtomSet::lastVersion = 0;
 
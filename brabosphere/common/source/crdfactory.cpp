@@ -48,6 +48,9 @@ is defined, the openbabel library is not needed for compilation.
 
 #include <qdatetime.h>
 
+// Point3D has to be declared before the Open Babel headers, as these define PI as a macro
+#include "point3d.h"
+
 #ifdef USE_OPENBABEL1
  // Open Babel 1.100.2 header files
  #ifdef Q_OS_WIN32
@@ -168,10 +171,15 @@ unsigned int CrdFactory::readFromFile(AtomSet* atoms, QString filename)
     }
     // fill the AtomSet
     atoms->clear();
-    atoms->reserve(mol->NumAtoms());
+    vector<Point3D<double> > locations;
+    locations.reserve(mol->NumAtoms());
     vector<OBNodeBase*>::iterator it;
     for(OBAtom* atom  = mol->BeginAtom(it); atom; atom = mol->NextAtom(it))
-      atoms->addAtom(atom->GetX(), atom->GetY(), atom->GetZ(), static_cast<unsigned int>(atom->GetAtomicNum()));
+    {
+      locations.push_back(Point3D<double>(atom->GetX(), atom->GetY(), atom->GetZ()));
+      locations.back().setID(static_cast<unsigned int>(atom->GetAtomicNum()));
+    }
+    atoms->addAtoms(locations);
     delete mol;
   }
 #endif
@@ -197,9 +205,14 @@ unsigned int CrdFactory::readFromFile(AtomSet* atoms, QString filename)
     qDebug("time to read the OpenBabel file: %f seconds", timer.restart()/1000.f);
     // fill the AtomSet
     atoms->clear();
-    atoms->reserve(mol.NumAtoms());
+    vector<Point3D<double> > locations;
+    locations.reserve(mol.NumAtoms());
     for(OBMolAtomIter atom(mol); atom; atom++)
-      atoms->addAtom(atom->x(), atom->y(), atom->z(), atom->GetAtomicNum());
+    {
+      locations.push_back(Point3D<double>(atom->x(), atom->y(), atom->z()));
+      locations.back().setID(atom->GetAtomicNum());
+    }
+    atoms->addAtoms(locations);
     qDebug("time to fill the AtomSet: %f seconds", timer.restart()/1000.f);
   }
 #endif
@@ -723,13 +736,16 @@ unsigned int CrdFactory::readBraboFile(AtomSet* atoms, const QString filename)
     qDebug("Coordinate were read as:");
     // rescale all coordinates
     toAngstrom = AUTOANG;
+    vector<unsigned int> indices(atoms->count());
+    vector<Point3D<double> > displacements;
+    displacements.reserve(atoms->count());
     for(unsigned int i = 0; i < atoms->count(); i++)
     {
       qDebug("(%f, %f, %f) atomnum = %d", atoms->x(i), atoms->y(i), atoms->z(i), atoms->atomicNumber(i));
-      atoms->setX(i,atoms->x(i) * toAngstrom);
-      atoms->setY(i,atoms->y(i) * toAngstrom);
-      atoms->setZ(i,atoms->z(i) * toAngstrom);
+      indices[i] = i;
+      displacements.push_back(Point3D<double>(atoms->x(i) * (toAngstrom - 1.0), atoms->y(i) * (toAngstrom - 1.0), atoms->z(i) * (toAngstrom - 1.0)));
     }
+    atoms->displaceAtoms(indices, displacements); // moves all atoms at once
   }
 
   ///// read the rest of the file and directly fill the AtomSet
@@ -737,6 +753,7 @@ unsigned int CrdFactory::readBraboFile(AtomSet* atoms, const QString filename)
   {
     double x, y, z, atomNum;
     unsigned int atomicNumber;
+    vector<Point3D<double> > locations;
 
     while(!stream.eof())
     {
@@ -768,9 +785,11 @@ unsigned int CrdFactory::readBraboFile(AtomSet* atoms, const QString filename)
           y = line.mid(40,20).stripWhiteSpace().toDouble() * toAngstrom;
           z = line.mid(60,20).stripWhiteSpace().toDouble() * toAngstrom;
         }
-        atoms->addAtom(x, y, z, atomicNumber);
+        locations.push_back(Point3D<double>(x, y, z));
+        locations.back().setID(atomicNumber);
       }
     }
+    atoms->addAtoms(locations);
   }
 
   qDebug("time to read the BRABO file: %f seconds", timer.restart()/1000.f);
@@ -789,20 +808,24 @@ unsigned int CrdFactory::writeBraboFile(AtomSet* atoms, const QString filename,
   QTextStream stream(&file);
   QString line;
 
+  const double* atomX = atoms->xCoordinates();
+  const double* atomY = atoms->yCoordinates();
+  const double* atomZ = atoms->zCoordinates();
+  const unsigned char* atomNum = atoms->atomicNumbers();
   for(unsigned int i = 0; i < atoms->count(); i++)
   {
     if(extendedFormat)
-      line = QString("N=%1      %2%3%4%5").arg(AtomSet::numToAtom(atoms->atomicNumber(i)), 2)
-                                          .arg(static_cast<double>(atoms->atomicNumber(i)), -10, 'f', 1)
-                                          .arg(atoms->x(i), 20, 'f', 12)
-                                          .arg(atoms->y(i), 20, 'f', 12)
-                                          .arg(atoms->z(i), 20, 'f', 12);
+      line = QString("N=%1      %2%3%4%5").arg(AtomSet::numToAtom(atomNum[i]), 2)
+                                          .arg(static_cast<double>(atomNum[i]), -10, 'f', 1)
+                                          .arg(atomX[i], 20, 'f', 12)
+                                          .arg(atomY[i], 20, 'f', 12)
+                                          .arg(atomZ[i], 20, 'f', 12);
     else
-      line = QString("N=%1      %2%3%4%5").arg(AtomSet::numToAtom(atoms->atomicNumber(i)), 2)
-                                          .arg(static_cast<double>(atoms->atomicNumber(i)), -10, 'f', 1)
-                                          .arg(atoms->x(i), 10, 'f', 7)
-                                          .arg(atoms->y(i), 10, 'f', 7)
-                                          .arg(atoms->z(i), 10, 'f', 7);
+      line = QString("N=%1      %2%3%4%5").arg(AtomSet::numToAtom(atomNum[i]), 2)
+                                          .arg(static_cast<double>(atomNum[i]), -10, 'f', 1)
+                                          .arg(atomX[i], 10, 'f', 7)
+                                          .arg(atomY[i], 10, 'f', 7)
+                                          .arg(atomZ[i], 10, 'f', 7);
     stream << line << "\n";
   }
   stream << "STOP\n";
@@ -864,7 +887,8 @@ void CrdFactory::readCrdAtoms(AtomSet* atoms, QStringList &lines, const bool ext
   QString line;
 
   atoms->clear();
-  atoms->reserve(lines.size());
+  vector<Point3D<double> > locations;
+  locations.reserve(lines.size());
   for(QStringList::iterator it = lines.begin(); it != lines.end(); it++)
   {
     line = *it;
@@ -893,8 +917,10 @@ void CrdFactory::readCrdAtoms(AtomSet* atoms, QStringList &lines, const bool ext
       y = line.mid(40,20).stripWhiteSpace().toDouble();
       z = line.mid(60,20).stripWhiteSpace().toDouble();
     }
-    atoms->addAtom(x, y, z, atomicNumber);
+    locations.push_back(Point3D<double>(x, y, z));
+    locations.back().setID(atomicNumber);
   }
+  atoms->addAtoms(locations);
 }
 
 ///// readPunchForces /////////////////////////////////////////////////////////
@@ -1087,7 +1113,8 @@ unsigned int CrdFactory::readXmolFile(AtomSet* atoms, const QString filename)
 
   ///// add the coordinates to the AtomSet
   atoms->clear();
-  atoms->reserve(allLines.size());
+  vector<Point3D<double> > locations;
+  locations.reserve(allLines.size());
   for(QStringList::iterator it = allLines.begin(); it != allLines.end(); it++)
   {
     // split it again by whitespace
@@ -1098,8 +1125,10 @@ unsigned int CrdFactory::readXmolFile(AtomSet* atoms, const QString filename)
     double x = (*(++it2)).toDouble();
     double y = (*(++it2)).toDouble();
     double z = (*(++it2)).toDouble();
-    atoms->addAtom(x, y, z, atomnum);
+    locations.push_back(Point3D<double>(x, y, z));
+    locations.back().setID(atomnum);
   }
+  atoms->addAtoms(locations);
   return OK;
 }
 
@@ -1148,13 +1177,16 @@ unsigned int CrdFactory::readGaussianFile(AtomSet* atoms, const QString filename
 
   ///// read the coordinates (5E16.8) => safe to read one by one
   atoms->clear();
-  atoms->reserve(natoms);
+  vector<Point3D<double> > locations;
+  locations.reserve(natoms);
   double x, y, z;
   for(unsigned int i = 0; i < natoms; i++)
   {
     stream >> x >> y >> z;
-	  atoms->addAtom(x*AUTOANG, y*AUTOANG, z*AUTOANG, atomnums[i]);
+    locations.push_back(Point3D<double>(x*AUTOANG, y*AUTOANG, z*AUTOANG));
+    locations.back().setID(atomnums[i]);
   }
+  atoms->addAtoms(locations);
 
   return OK;
 }
@@ -1186,6 +1218,7 @@ unsigned int CrdFactory::readMoldenFile(AtomSet* atoms, const QString filename)
 
   ///// read coordinates
   atoms->clear();
+  vector<Point3D<double> > locations;
   line = stream.readLine();
   double x, y, z;
   while(!line.contains("[") && !stream.atEnd())
@@ -1199,9 +1232,11 @@ unsigned int CrdFactory::readMoldenFile(AtomSet* atoms, const QString filename)
       y *= AUTOANG;
       z *= AUTOANG;
     }
-    atoms->addAtom(x, y, z, line.section(" ", 2, 2, QString::SectionSkipEmpty).toUInt());
+    locations.push_back(Point3D<double>(x, y, z));
+    locations.back().setID(line.section(" ", 2, 2, QString::SectionSkipEmpty).toUInt());
     line = stream.readLine();
   }
+  atoms->addAtoms(locations);
   return OK;
 }
 
@@ -1248,6 +1283,7 @@ unsigned int CrdFactory::readMolcasFile(AtomSet* atoms, const QString filename)
       // read all coordinate lines
       double x, y, z;
       bool okX, okY, okZ;
+      vector<Point3D<double> > locations;
       while(!stream.atEnd() && !line.contains("End of basis", false))
       {
         x = line.section(" ", 1, 1, QString::SectionSkipEmpty).toDouble(&okX);
@@ -1260,9 +1296,13 @@ unsigned int CrdFactory::readMolcasFile(AtomSet* atoms, const QString filename)
            z *= AUTOANG;
         }
         if(okX && okY && okZ && line.stripWhiteSpace().left(1) != "*")
-          atoms->addAtom(x, y, z, atomNumber);
+        {
+          locations.push_back(Point3D<double>(x, y, z));
+          locations.back().setID(atomNumber);
+        }
         line = stream.readLine();
       }
+      atoms->addAtoms(locations); // all atoms of this basis set at once
     }
     ///// for point charge subsections
     else
@@ -1308,12 +1348,16 @@ unsigned int CrdFactory::writeMolcasFile(AtomSet* atoms, const QString filename)
 
   ///// write the coordinates
   stream << " &SEWARD &END\n\nBasis set\nX.dummy\n";
+  const double* atomX = atoms->xCoordinates();
+  const double* atomY = atoms->yCoordinates();
+  const double* atomZ = atoms->zCoordinates();
+  const unsigned char* atomNum = atoms->atomicNumbers();
   for(unsigned int i = 0; i < atoms->count(); i++)
-    stream << QString("%1%2  %3  %4  %5\n").arg(AtomSet::numToAtom(atoms->atomicNumber(i)).stripWhiteSpace())
+    stream << QString("%1%2  %3  %4  %5\n").arg(AtomSet::numToAtom(atomNum[i]).stripWhiteSpace())
                                       .arg(i+1)
-                                      .arg(atoms->x(i)/AUTOANG, 20, 'f', 12)
-                                      .arg(atoms->y(i)/AUTOANG, 20, 'f', 12)
-                                      .arg(atoms->z(i)/AUTOANG, 20, 'f', 12);
+                                      .arg(atomX[i]/AUTOANG, 20, 'f', 12)
+                                      .arg(atomY[i]/AUTOANG, 20, 'f', 12)
+                                      .arg(atomZ[i]/AUTOANG, 20, 'f', 12);
   stream << "End of basis\n";
 
   ///// write the point charges
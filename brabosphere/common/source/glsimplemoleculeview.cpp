@@ -59,7 +59,10 @@
 GLSimpleMoleculeView::GLSimpleMoleculeView(AtomSet* atomset, QWidget* parent, const char* name ) : GLView(parent, name),
   atoms(atomset),
   chargeType(AtomSet::None),
-  scaleFactor(1.0f)
+  scaleFactor(1.0f),
+  sphereRadius(0.4f),
+  radiusVersion(0),
+  centerVersion(0)
 /// The default constructor.
 {
   moleculeStyle = moleculeParameters.defaultMoleculeStyle;
@@ -172,7 +175,7 @@ void GLSimpleMoleculeView::loadCML(QDomElement* root)
   orientationQuaternion->setValues(wQuat, xQuat, yQuat, zQuat);
 
   makeCurrent(); // needed for call to updateFog
-  updateFog(boundingSphereRadius());
+  updateFog(boundingSphereRadius()); // only recalculated when the geometry changed
   updateGL();
 }
 
@@ -262,7 +265,7 @@ void GLSimpleMoleculeView::updateAtomSet(const bool reset)
 /// \arg atoms have been added/removed/changes
 /// When reset = true, the scene will be reset completely
 {
-  centerMolecule(); // always keep the molecule centered
+  centerMolecule(); // always keep the molecule centered (only recalculated when the geometry changed)
   if(reset)
   {
     resetView(false);
@@ -284,6 +287,35 @@ void GLSimpleMoleculeView::selectAll(const bool update)
   emit changed();
 }
 
+///// selectNeighbours //////////////////////////////////////////////////////
+void GLSimpleMoleculeView::selectNeighbours(const double radius, const bool update)
+/// Adds all atoms within a distance radius of any of the selected atoms to
+/// the selection, in order of increasing index.
+{
+  vector<bool> selected(atoms->count(), false);
+  for(std::list<unsigned int>::const_iterator it = selectionList.begin(); it != selectionList.end(); it++)
+    selected[*it] = true;
+  vector<unsigned int> newAtoms;
+  for(std::list<unsigned int>::const_iterator it = selectionList.begin(); it != selectionList.end(); it++)
+  {
+    const vector<unsigned int> neighbours = atoms->atomsInSphere(Point3D<double>(atoms->x(*it), atoms->y(*it), atoms->z(*it)), radius);
+    for(vector<unsigned int>::const_iterator itn = neighbours.begin(); itn != neighbours.end(); itn++)
+    {
+      if(!selected[*itn])
+      {
+        selected[*itn] = true;
+        newAtoms.push_back(*itn);
+      }
+    }
+  }
+  std::sort(newAtoms.begin(), newAtoms.end());
+  selectionList.insert(selectionList.end(), newAtoms.begin(), newAtoms.end());
+
+  if(update)
+    updateGL();
+  emit changed();
+}
+
 ///// unselectAll /////////////////////////////////////////////////////////////
 void GLSimpleMoleculeView::unselectAll(const bool update)
 /// Unselects all atoms.
@@ -342,20 +374,15 @@ void GLSimpleMoleculeView::initializeGL()
 
 ///// boundingSphereRadius ////////////////////////////////////////////////////
 float GLSimpleMoleculeView::boundingSphereRadius()
-/// Calculates the radius of the bounding sphere.
+/// Calculates the radius of the bounding sphere. It is only recalculated when
+/// the geometry of the atoms changed.
 {
-  float radius = 0.0;
-  float x, y, z, tempradius;
-  for(unsigned int i = 0; i < atoms->count(); i++)
-  {
-    x = static_cast<float>(atoms->x(i) - centerX);
-    y = static_cast<float>(atoms->y(i) - centerY);
-    z = static_cast<float>(atoms->z(i) - centerZ);
-    ///// the following might have to be changed when scaling of atomsizes is permitted
-    tempradius = sqrt(x*x + y*y + z*z) + static_cast<float>(AtomSet::vanderWaals(atoms->atomicNumber(i)))/2.0f;
-    if(tempradius > radius)
-      radius = tempradius;
-  }
+  if(radiusVersion == atoms->geometryVersion())
+    return sphereRadius;
+  radiusVersion = atoms->geometryVersion();
+
+  ///// the following might have to be changed when scaling of atomsizes is permitted
+  float radius = static_cast<float>(atoms->boundingSphereRadius());
   if(radius > 25.0f)
   {
     scaleFactor = 25.0f/radius;
@@ -365,6 +392,7 @@ float GLSimpleMoleculeView::boundingSphereRadius()
     scaleFactor = 1.0f;
   if(radius < 0.4f) // VdW(H)
     radius = 0.4f;
+  sphereRadius = radius;
   return radius;
 }
 
@@ -595,33 +623,29 @@ void GLSimpleMoleculeView::changeObjects(const GLuint startList, const int numSl
 ///// selectEntity ////////////////////////////////////////////////////////////
 void GLSimpleMoleculeView::selectEntity(const QPoint position)
 /// Selects the entity (atom, bond, etc.) pointed to by the mouse position.
+/// Instead of rendering the scene in selection mode, a ray is cast from the
+/// mouse position into the scene and intersected with the atoms.
 {
+  if(atoms->count() == 0)
+    return;
+
   makeCurrent();
-  ///// needed storage
-  const unsigned int BUFFER_SIZE = 64;
-  GLuint selectionBuffer[BUFFER_SIZE]; // selection buffer
-  GLuint* pBuffer = selectionBuffer;
-  GLint viewport[4]; // viewport
+  GLint viewport[4];
+  GLdouble modelviewMatrix[16];
+  GLdouble projectionMatrix[16];
+  glGetIntegerv(GL_VIEWPORT, viewport);
 
-  // save the modelview matrix
-  glMatrixMode(GL_MODELVIEW);
+  ///// get the projection as set up in resizeGL
+  glMatrixMode(GL_PROJECTION);
   glPushMatrix();
-
-  ///// get the selections
-  glSelectBuffer(BUFFER_SIZE, pBuffer); // set up the selection buffer
-  glGetIntegerv(GL_VIEWPORT, viewport); // get the viewport
-  glMatrixMode(GL_PROJECTION); // set projection mode
-  glPushMatrix(); // save the matrix
   glLoadIdentity();
-  glRenderMode(GL_SELECT); // set selection mode
-  GLint xPosition = position.x();
-  GLint yPosition = viewport[3] - position.y();
-  gluPickMatrix(xPosition, yPosition, 2, 2, viewport); // set up a viewport of 2 pixels wide around the mouse position
   setPerspective(); // calls gluPerspective or glOrtho depending on the prespective setting
-  glMatrixMode(GL_MODELVIEW);
+  glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
   glPopMatrix();
 
-  // setup the scene as would be done in paintGL/drawScene
+  ///// get the transformation of the molecule as set up in paintGL/drawScene
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
   Vector3D<float> axis;
   float angle;
   orientationQuaternion->getAxisAngle(axis, angle);
@@ -630,76 +654,148 @@ void GLSimpleMoleculeView::selectEntity(const QPoint position)
   if(scaleFactor < 1.0f)
     glScalef(scaleFactor, scaleFactor, scaleFactor);
   glTranslatef(-centerX, -centerY, -centerZ);
-
-  // draw the atoms needed for selection
-  glInitNames();
-  glPushName(0);
-  if(moleculeStyle == None || moleculeStyle == Lines)
-    drawAtoms(Tubes, false); // colors are not needed
-  else
-    drawAtoms(moleculeStyle, false); // just draw the atoms
-
-  ///// generate the selection and reset the selection mode
-  GLint hits = glRenderMode(GL_RENDER);
-
-  ///// restore the original view
-  glMatrixMode(GL_PROJECTION);
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelviewMatrix);
   glPopMatrix();
-  glMatrixMode(GL_MODELVIEW);
 
-  ///// process the selection
-  if(hits != 0)
+  ///// the ray runs from the near to the far clipping plane through the mouse position
+  const GLdouble xPosition = position.x();
+  const GLdouble yPosition = viewport[3] - position.y();
+  GLdouble nearX, nearY, nearZ, farX, farY, farZ;
+  if(gluUnProject(xPosition, yPosition, 0.0, modelviewMatrix, projectionMatrix, viewport, &nearX, &nearY, &nearZ) == GL_FALSE
+     || gluUnProject(xPosition, yPosition, 1.0, modelviewMatrix, projectionMatrix, viewport, &farX, &farY, &farZ) == GL_FALSE)
+    return;
+
+  const int atom = pickAtom(Point3D<double>(nearX, nearY, nearZ), Point3D<double>(farX - nearX, farY - nearY, farZ - nearZ));
+  if(atom >= 0)
   {
-    GLuint count = *pBuffer++; // GLuint count = *pBuffer++; // the number of names in the buffer
-    pBuffer +=2; // GLuint minz = *pBuffer++; // minimum z-value of selection
-                 // GLuint maxz = *pBuffer++; // maximum z-value of selection
-    GLuint id = *pBuffer; // the id of the first selection
-    qDebug("Number of selections: %d", count);
-    qDebug("ID of first selection: %d", id);
-    processSelectionCommand(id);
+    qDebug("ID of selection: %d", START_ATOMS + atom);
+    processSelectionCommand(START_ATOMS + atom);
     updateGL();
     emit changed();
   }
 }
 
+///// pickAtom ////////////////////////////////////////////////////////////////
+int GLSimpleMoleculeView::pickAtom(const Point3D<double>& origin, const Point3D<double>& direction)
+/// Returns the index of the first atom hit by the ray starting at origin in
+/// the given direction, or -1 if no atom is hit. The atoms are spheres with
+/// the radius they are drawn with in the current style. A bond drawn as a
+/// cylinder in front of the atoms hides them.
+{
+  const double length = sqrt(direction.x()*direction.x() + direction.y()*direction.y() + direction.z()*direction.z());
+  if(length == 0.0)
+    return -1;
+  const double dirX = direction.x()/length;
+  const double dirY = direction.y()/length;
+  const double dirZ = direction.z()/length;
+
+  ///// the radii of the atoms and the bonds as drawn by drawAtoms and drawBonds
+  unsigned int style = moleculeStyle;
+  if(style == None || style == Lines || style == SmoothLines)
+    style = Tubes; // the atoms are not drawn, but can still be selected
+  const bool hasBonds = moleculeStyle != None && moleculeStyle != Lines && moleculeStyle != SmoothLines && moleculeStyle != VanDerWaals;
+  const double bondRadius = moleculeParameters.sizeBonds;
+  const unsigned char* atomNum = atoms->atomicNumbers();
+  const vector<unsigned int> elements = atoms->usedAtomicNumbers(); // cached by the AtomSet
+  float maxVanderWaals = 0.0f;
+  for(vector<unsigned int>::const_iterator it = elements.begin(); it != elements.end(); it++)
+    maxVanderWaals = std::max(maxVanderWaals, AtomSet::vanderWaals(*it));
+  double maxAtomRadius = bondRadius;
+  if(style == VanDerWaals)
+    maxAtomRadius = maxVanderWaals*1.5;
+  else if(style != Tubes)
+    maxAtomRadius = maxVanderWaals/2.0;
+
+  ///// a bond is never longer than 1.25 times the sum of the Van der Waals radii of
+  ///// its atoms, so one of them lies within half of that distance from the ray
+  double searchRadius = maxAtomRadius;
+  if(hasBonds)
+    searchRadius = std::max(searchRadius, bondRadius + 1.25*maxVanderWaals);
+  const vector<unsigned int> candidates = atoms->atomsAlongRay(origin, direction, searchRadius);
+
+  const double* atomX = atoms->xCoordinates();
+  const double* atomY = atoms->yCoordinates();
+  const double* atomZ = atoms->zCoordinates();
+  double closest = HUGE_VAL; // the distance along the ray of the first hit
+  int result = -1;
+  for(vector<unsigned int>::const_iterator it = candidates.begin(); it != candidates.end(); it++)
+  {
+    const unsigned int atom1 = *it;
+    const double vx = atomX[atom1] - origin.x();
+    const double vy = atomY[atom1] - origin.y();
+    const double vz = atomZ[atom1] - origin.z();
+    const double along = vx*dirX + vy*dirY + vz*dirZ;
+
+    ///// the sphere of the atom
+    double radius = bondRadius;
+    if(style == VanDerWaals)
+      radius = AtomSet::vanderWaals(atomNum[atom1])*1.5;
+    else if(style != Tubes)
+      radius = AtomSet::vanderWaals(atomNum[atom1])/2.0;
+    const double discriminant = radius*radius - (vx*vx + vy*vy + vz*vz - along*along);
+    if(discriminant >= 0.0)
+    {
+      const double hit = along - sqrt(discriminant);
+      if(hit >= 0.0 && hit < closest)
+      {
+        closest = hit;
+        result = atom1;
+      }
+    }
+
+    ///// the cylinders of its bonds
+    if(!hasBonds)
+      continue;
+    const unsigned int numBonds = atoms->numberOfBonds(atom1);
+    for(unsigned int i = 0; i < numBonds; i++)
+    {
+      const unsigned int atom2 = atoms->bondedAtom(atom1, i);
+      double axisX = atomX[atom2] - atomX[atom1];
+      double axisY = atomY[atom2] - atomY[atom1];
+      double axisZ = atomZ[atom2] - atomZ[atom1];
+      const double distance = sqrt(axisX*axisX + axisY*axisY + axisZ*axisZ);
+      if(distance < 0.01)
+        continue; // not drawn
+      axisX /= distance;
+      axisY /= distance;
+      axisZ /= distance;
+      // project the ray onto the plane perpendicular to the bond
+      const double dirAxis = dirX*axisX + dirY*axisY + dirZ*axisZ;
+      const double vAxis = vx*axisX + vy*axisY + vz*axisZ;
+      const double a = 1.0 - dirAxis*dirAxis;
+      if(a < 1.0e-12)
+        continue; // the ray is parallel to the bond
+      const double b = along - dirAxis*vAxis; // with the sign of -origin relative to atom1
+      const double c = vx*vx + vy*vy + vz*vz - vAxis*vAxis - bondRadius*bondRadius;
+      const double bondDiscriminant = b*b - a*c;
+      if(bondDiscriminant < 0.0)
+        continue;
+      const double hit = (b - sqrt(bondDiscriminant))/a;
+      const double position = hit*dirAxis - vAxis; // the position of the hit along the bond
+      if(hit >= 0.0 && hit < closest && position >= 0.0 && position <= distance)
+      {
+        closest = hit;
+        result = -1; // the bond hides the atoms behind it
+      }
+    }
+  }
+  return result;
+}
+
 ///// centerMolecule //////////////////////////////////////////////////////////
 void GLSimpleMoleculeView::centerMolecule()
 /// Calculates the translations needed to center the molecule. The center of
-/// mass cannot be used, just the largest extents of the molecule.
+/// mass cannot be used, just the largest extents of the molecule. They are
+/// only recalculated when the geometry of the atoms changed.
 {
-  centerX = 0.0f;
-  centerY = 0.0f;
-  centerZ = 0.0f;
-
-  if(atoms->count() == 0)
+  if(centerVersion == atoms->geometryVersion())
     return;
+  centerVersion = atoms->geometryVersion();
 
-  ///// determine maxima & minima
-  double maxx = atoms->x(0);
-  double maxy = atoms->y(0);
-  double maxz = atoms->z(0);
-  double minx = maxx;
-  double miny = maxy;
-  double minz = maxz;
-  for(unsigned int i = 1; i < atoms->count(); i++)
-  {
-    if(atoms->x(i) > maxx)
-      maxx = atoms->x(i);
-    else if(atoms->x(i) < minx)
-      minx = atoms->x(i);
-    if(atoms->y(i) > maxy)
-      maxy = atoms->y(i);
-    else if(atoms->y(i) < miny)
-      miny = atoms->y(i);
-    if(atoms->z(i) > maxz)
-      maxz = atoms->z(i);
-    else if(atoms->z(i) < minz)
-      minz = atoms->z(i);
-  }
-  ///// calculate the new centers
-  centerX = static_cast<GLfloat>((maxx + minx)/2.0);
-  centerY = static_cast<GLfloat>((maxy + miny)/2.0);
-  centerZ = static_cast<GLfloat>((maxz + minz)/2.0);
+  const Point3D<float> center = atoms->rotationCenter();
+  centerX = center.x();
+  centerY = center.y();
+  centerZ = center.z();
 }
 
 ///// updateMolecule //////////////////////////////////////////////////////////
@@ -881,20 +977,20 @@ void GLSimpleMoleculeView::drawAtoms(const unsigned int style, const bool useCol
   if(style == None || style == Lines || style == SmoothLines || style > BlackAndWhite)
     return;
 
+  const double* atomX = atoms->xCoordinates();
+  const double* atomY = atoms->yCoordinates();
+  const double* atomZ = atoms->zCoordinates();
+  const unsigned char* atomNum = atoms->atomicNumbers();
+  const unsigned short* colorEntry = atoms->paletteEntries();
+  vector<GLubyte> colorTable;
+  if(useColors)
+    makeColorTable(style == BlackAndWhite, colorTable);
   for(unsigned int i = 0; i < atoms->count(); i++)
   {
     glPushMatrix(); // save the current matrix
     if(useColors)
-    {
-      if(style == BlackAndWhite)
-      {
-        int gray = qGray(atoms->color(i).rgb());
-        qglColor(QColor(gray, gray, gray)); // grayscaled atom color
-      }
-      else
-        qglColor(atoms->color(i)); // set the color (works cos of glColorMaterial)
-    }
-    glTranslatef(atoms->x(i), atoms->y(i), atoms->z(i)); // set the position
+      glColor3ubv(&colorTable[3*colorEntry[i]]); // set the color (works cos of glColorMaterial)
+    glTranslatef(atomX[i], atomY[i], atomZ[i]); // set the position
     if(style == Tubes)
     {
       glScalef(moleculeParameters.sizeBonds,
@@ -903,21 +999,19 @@ void GLSimpleMoleculeView::drawAtoms(const unsigned int style, const bool useCol
     }
     else if(style == BallAndStick || style == Cartoon || style == BlackAndWhite)
     {
-      glScalef(AtomSet::vanderWaals(atoms->atomicNumber(i))/2.0f,
-               AtomSet::vanderWaals(atoms->atomicNumber(i))/2.0f,
-               AtomSet::vanderWaals(atoms->atomicNumber(i))/2.0f);
+      glScalef(AtomSet::vanderWaals(atomNum[i])/2.0f,
+               AtomSet::vanderWaals(atomNum[i])/2.0f,
+               AtomSet::vanderWaals(atomNum[i])/2.0f);
     }
     else if(style == VanDerWaals)
     {
-      glScalef(AtomSet::vanderWaals(atoms->atomicNumber(i))*1.5f,
-               AtomSet::vanderWaals(atoms->atomicNumber(i))*1.5f,
-               AtomSet::vanderWaals(atoms->atomicNumber(i))*1.5f);
+      glScalef(AtomSet::vanderWaals(atomNum[i])*1.5f,
+               AtomSet::vanderWaals(atomNum[i])*1.5f,
+               AtomSet::vanderWaals(atomNum[i])*1.5f);
     }
-    glLoadName(START_ATOMS+i);
     glCallList(atomObject); // make the atom
     glPopMatrix(); // restore the matrix
   }
-  glLoadName(0); // just to make sure the following items do not get the same name as the last atom
 
   ///// add the point charges
   for(unsigned int i = 0; i < atoms->countPointCharges(); i++)
@@ -955,7 +1049,12 @@ void GLSimpleMoleculeView::drawBonds(const unsigned int style, const bool useCol
   vector<unsigned int>* firstAtom;
   vector<unsigned int>* secondAtom;
   atoms->bonds(firstAtom, secondAtom); // assigns both pointers
-
+  const double* atomX = atoms->xCoordinates();
+  const double* atomY = atoms->yCoordinates();
+  const double* atomZ = atoms->zCoordinates();
+  const unsigned short* colorEntry = atoms->paletteEntries();
+  vector<GLubyte> colorTable;
+  makeColorTable(style == BlackAndWhite, colorTable);
 
   if(style == Lines || style == SmoothLines)
   {
@@ -968,34 +1067,36 @@ void GLSimpleMoleculeView::drawBonds(const unsigned int style, const bool useCol
       {
         const unsigned int atom1 = firstAtom->operator[](i);
         const unsigned int atom2 = secondAtom->operator[](i);
-        if(atoms->color(atom1) == atoms->color(atom2))
+        const GLubyte* color1 = &colorTable[3*colorEntry[atom1]];
+        const GLubyte* color2 = &colorTable[3*colorEntry[atom2]];
+        if(std::equal(color1, color1 + 3, color2))
         {
           ///// the bond has one color
-          qglColor(atoms->color(atom1));
-          glVertex3d(atoms->x(atom1), atoms->y(atom1), atoms->z(atom1));
-          glVertex3d(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2));
+          glColor3ubv(color1);
+          glVertex3d(atomX[atom1], atomY[atom1], atomZ[atom1]);
+          glVertex3d(atomX[atom2], atomY[atom2], atomZ[atom2]);
         }
         else if(style == Lines)
         {
           ///// 2 half-bonds
-          const double midX = (atoms->x(atom1) + atoms->x(atom2))/2.0;
-          const double midY = (atoms->y(atom1) + atoms->y(atom2))/2.0;
-          const double midZ = (atoms->z(atom1) + atoms->z(atom2))/2.0;
-          qglColor(atoms->color(atom1));
-          glVertex3d(atoms->x(atom1), atoms->y(atom1), atoms->z(atom1));
+          const double midX = (atomX[atom1] + atomX[atom2])/2.0;
+          const double midY = (atomY[atom1] + atomY[atom2])/2.0;
+          const double midZ = (atomZ[atom1] + atomZ[atom2])/2.0;
+          glColor3ubv(color1);
+          glVertex3d(atomX[atom1], atomY[atom1], atomZ[atom1]);
           glVertex3d(midX, midY, midZ);
 
-          qglColor(atoms->color(atom2));
+          glColor3ubv(color2);
           glVertex3d(midX, midY, midZ);
-          glVertex3d(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2));
+          glVertex3d(atomX[atom2], atomY[atom2], atomZ[atom2]);
         }
         else // SmoothLines
         {
-          qglColor(atoms->color(atom1));
-          glVertex3d(atoms->x(atom1), atoms->y(atom1), atoms->z(atom1));
+          glColor3ubv(color1);
+          glVertex3d(atomX[atom1], atomY[atom1], atomZ[atom1]);
 
-          qglColor(atoms->color(atom2));
-          glVertex3d(atoms->x(atom2), atoms->y(atom2), atoms->z(atom2));
+          glColor3ubv(color2);
+          glVertex3d(atomX[atom2], atomY[atom2], atomZ[atom2]);
         }
       }
     glEnd();
@@ -1013,12 +1114,12 @@ void GLSimpleMoleculeView::drawBonds(const unsigned int style, const bool useCol
     const unsigned int atom1 = firstAtom->operator[](i);
     const unsigned int atom2 = secondAtom->operator[](i);
 
-    x1 = static_cast<float>(atoms->x(atom1));
-    x2 = static_cast<float>(atoms->x(atom2));
-    y1 = static_cast<float>(atoms->y(atom1));
-    y2 = static_cast<float>(atoms->y(atom2));
-    z1 = static_cast<float>(atoms->z(atom1));
-    z2 = static_cast<float>(atoms->z(atom2));
+    x1 = static_cast<float>(atomX[atom1]);
+    x2 = static_cast<float>(atomX[atom2]);
+    y1 = static_cast<float>(atomY[atom1]);
+    y2 = static_cast<float>(atomY[atom2]);
+    z1 = static_cast<float>(atomZ[atom1]);
+    z2 = static_cast<float>(atomZ[atom2]);
     distanceXY = sqrt((x1 - x2)*(x1 - x2) + (y1 - y2)*(y1 - y2));
     distance = sqrt((x1 - x2)*(x1 - x2) + (y1 - y2)*(y1 - y2) + (z1 - z2)*(z1 - z2));
     if(distance < 0.01f)
@@ -1048,46 +1149,29 @@ void GLSimpleMoleculeView::drawBonds(const unsigned int style, const bool useCol
     glRotatef(phi, 0.0f, 1.0f, 0.0f);
 
     /////SCALE
+    const GLubyte* color1 = &colorTable[3*colorEntry[atom1]];
+    const GLubyte* color2 = &colorTable[3*colorEntry[atom2]];
+    const bool oneColor = !useColors || std::equal(color1, color1 + 3, color2);
     float scaleFactor = 1.0f;
-    if(atoms->color(atom1) != atoms->color(atom2) && useColors)
+    if(!oneColor)
       scaleFactor = 2.0f;
     glScalef(moleculeParameters.sizeBonds, moleculeParameters.sizeBonds, distance/(scaleFactor*cylinderHeight));
 
-    if(atoms->color(atom1) == atoms->color(atom2) || !useColors)
+    if(oneColor)
     {
       ///// the bond has one color
       if(useColors)
-      {
-        if(style == BlackAndWhite)
-        {
-          int gray = qGray(atoms->color(atom1).rgb());
-          qglColor(QColor(gray, gray, gray)); // grayscaled atom color
-        }
-        else
-          qglColor(atoms->color(atom1));
-      }
+        glColor3ubv(color1);
       glCallList(bondObject);
     }
     else
     {
       ///// the bond has two colors
       //// make firstAtom's part of bond
-      if(style == BlackAndWhite)
-      {
-        int gray = qGray(atoms->color(atom1).rgb());
-        qglColor(QColor(gray, gray, gray)); // grayscaled atom color
-      }
-      else
-        qglColor(atoms->color(atom1));
+      glColor3ubv(color1);
       glCallList(bondObject);
       ///// make secondAtom's part of bond
-      if(style == BlackAndWhite)
-      {
-        int gray = qGray(atoms->color(atom2).rgb());
-        qglColor(QColor(gray, gray, gray)); // grayscaled atom color
-      }
-      else
-        qglColor(atoms->color(atom2));
+      glColor3ubv(color2);
       glTranslatef(0.0f, 0.0f, cylinderHeight);
       glCallList(bondObject);
     }
@@ -1095,6 +1179,27 @@ void GLSimpleMoleculeView::drawBonds(const unsigned int style, const bool useCol
   }
 }
 
+///// makeColorTable //////////////////////////////////////////////////////////
+void GLSimpleMoleculeView::makeColorTable(const bool grayscale, vector<GLubyte>& table) const
+/// Fills table with the red, green and blue components of each color of the
+/// palette of the atoms for use with glColor3ubv. The palette is small, so
+/// this is much cheaper than converting the color of each atom.
+{
+  table.resize(3*atoms->paletteSize());
+  for(unsigned int i = 0; i < atoms->paletteSize(); i++)
+  {
+    const QColor color = atoms->paletteColor(i);
+    if(grayscale)
+      table[3*i] = table[3*i + 1] = table[3*i + 2] = static_cast<GLubyte>(qGray(color.rgb()));
+    else
+    {
+      table[3*i] = static_cast<GLubyte>(color.red());
+      table[3*i + 1] = static_cast<GLubyte>(color.green());
+      table[3*i + 2] = static_cast<GLubyte>(color.blue());
+    }
+  }
+}
+
 ///// drawForces //////////////////////////////////////////////////////////////
 void GLSimpleMoleculeView::drawForces(const unsigned int style, const bool useColors)
 /// Draws the forces.
@@ -1239,6 +1344,8 @@ void GLSimpleMoleculeView::drawICValue()
   qglColor(moleculeParameters.colorICs);
 
   std::list<unsigned int>::iterator it = selectionList.begin();
+  const vector<unsigned int> definition(selectionList.begin(), selectionList.end());
+  vector<double> value;
   switch(getSelectionType())
   {
     case SELECTION_BOND: ///// bond
@@ -1246,14 +1353,9 @@ void GLSimpleMoleculeView::drawICValue()
       // the atoms
       unsigned int atom1 = *it++;
       unsigned int atom2 = *it;
-      float x1 = static_cast<float>(atoms->x(atom1));
-      float x2 = static_cast<float>(atoms->x(atom2));
-      float y1 = static_cast<float>(atoms->y(atom1));
-      float y2 = static_cast<float>(atoms->y(atom2));
-      float z1 = static_cast<float>(atoms->z(atom1));
-      float z2 = static_cast<float>(atoms->z(atom2));
       // the text
-      float distance = sqrt((x1 - x2)*(x1 - x2) + (y1 - y2)*(y1 - y2) + (z1 - z2)*(z1 - z2));
+      atoms->bondValues(definition, value);
+      const double distance = value[0];
       // the actual rendering
       ///// on top of the selected bond -> old method
       /*
@@ -1284,19 +1386,9 @@ void GLSimpleMoleculeView::drawICValue()
       unsigned int atom1 = *it++;
       unsigned int atom2 = *it++;
       unsigned int atom3 = *it;
-      float x1 = static_cast<float>(atoms->x(atom1));
-      float x2 = static_cast<float>(atoms->x(atom2));
-      float x3 = static_cast<float>(atoms->x(atom3));
-      float y1 = static_cast<float>(atoms->y(atom1));
-      float y2 = static_cast<float>(atoms->y(atom2));
-      float y3 = static_cast<float>(atoms->y(atom3));
-      float z1 = static_cast<float>(atoms->z(atom1));
-      float z2 = static_cast<float>(atoms->z(atom2));
-      float z3 = static_cast<float>(atoms->z(atom3));
       // the text
-      Vector3D<float> bond1(x2, y2, z2, x1, y1, z1);
-      Vector3D<float> bond2(x2, y2, z2, x3, y3, z3);
-      float localAngle = bond1.angle(bond2);
+      atoms->angleValues(definition, value);
+      const double localAngle = value[0];
       // the actual rendering
       ///// on the bond 1-3 -> old method
       /*
@@ -1327,23 +1419,9 @@ void GLSimpleMoleculeView::drawICValue()
       unsigned int atom2 = *it++;
       unsigned int atom3 = *it++;
       unsigned int atom4 = *it;
-      float x1 = static_cast<float>(atoms->x(atom1));
-      float x2 = static_cast<float>(atoms->x(atom2));
-      float x3 = static_cast<float>(atoms->x(atom3));
-      float x4 = static_cast<float>(atoms->x(atom4));
-      float y1 = static_cast<float>(atoms->y(atom1));
-      float y2 = static_cast<float>(atoms->y(atom2));
-      float y3 = static_cast<float>(atoms->y(atom3));
-      float y4 = static_cast<float>(atoms->y(atom4));
-      float z1 = static_cast<float>(atoms->z(atom1));
-      float z2 = static_cast<float>(atoms->z(atom2));
-      float z3 = static_cast<float>(atoms->z(atom3));
-      float z4 = static_cast<float>(atoms->z(atom4));
       // the text
-      Vector3D<float> bond1(x2, y2, z2, x1, y1, z1);
-      Vector3D<float> bond2(x3, y3, z3, x4, y4, z4);
-      Vector3D<float> centralbond(x2, y2, z2, x3, y3, z3);
-      float localAngle = bond1.torsion(bond2, centralbond);
+      atoms->torsionValues(definition, value);
+      const double localAngle = value[0];
       // the actual rendering
       ///// on the central bond -> old method
       /*
@@ -1441,7 +1519,6 @@ void GLSimpleMoleculeView::drawSelections()
                AtomSet::vanderWaals(atoms->atomicNumber(*it))/2.0f * 1.1f);
     }
 
-    glLoadName(START_SELECTEDATOMS);
     glCallList(atomObject); // make the atom
     glPopMatrix();
     it++;
@@ -1487,7 +1564,6 @@ void GLSimpleMoleculeView::drawSelections()
       glRotatef(phi, 0.0f, 1.0f, 0.0f);
       ///// SCALE
       glScalef(moleculeParameters.sizeBonds * 1.1f, moleculeParameters.sizeBonds * 1.1f, distance/cylinderHeight);
-      glLoadName(START_SELECTEDBONDS);
       glCallList(bondObject);
 
       glPopMatrix();
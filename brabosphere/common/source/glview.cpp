@@ -338,6 +338,7 @@ void GLView::resizeGL(int w, int h)
   //aspectRatio = static_cast<float>(w) / static_cast<float>(h);
   setPerspective(); // calls gluPerspective or glOrtho depending on the prespective setting
   glMatrixMode(GL_MODELVIEW);
+  zoomChanged();
 }
 
 ///// paintGL /////////////////////////////////////////////////////////////////
@@ -565,6 +566,8 @@ void GLView::translateZ(const int amount)
       zPos = 0.1f;
     if(!baseParameters.perspectiveProjection)
       resizeGL(width(), height()); // zooming for ortho projection is in fact direct scaling of the view
+    else
+      zoomChanged();
   }
 }
 
@@ -735,11 +738,12 @@ void GLView::zoomFit(const bool update)
       zPos = maxRadius/tan(fieldOfView)/1.5f * static_cast<float>(height())/static_cast<float>(width());
     if(zPos < 0.1f)
       zPos = 0.1f;
+    zoomChanged();
   }
   else
   {
     zPos = 1.0f;
-    resizeGL(width(), height());
+    resizeGL(width(), height()); // calls zoomChanged
   }
 
   ///// update the scene
@@ -760,6 +764,15 @@ void GLView::resetView(const bool update)
     updateGL();
 }
 
+///// zoomChanged /////////////////////////////////////////////////////////////
+void GLView::zoomChanged()
+/// Is called each time the scale of the scene on screen changes: after
+/// zooming, fitting the scene and resizing the window. It can be overridden
+/// by subclasses that adapt the scene to the size on screen.
+{
+
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// Static Variables                                                    /////
@@ -0,0 +1,71 @@
+/***************************************************************************
+                       systeminfo.cpp  -  description
+                             -------------------
+    begin                : Sun Oct 18 2026
+    copyright            : (C) 2026 by the Brabosphere developers
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+///// Comments ////////////////////////////////////////////////////////////////
+/*!
+  \class SystemInfo
+  \brief This class provides information about the system the program runs on.
+
+  It is used for deciding how many threads to start for the parallel parts of
+  the program (finding bonds, sampling orbitals, extracting isosurfaces).
+*/
+/// \file
+/// Contains the implementation of the class SystemInfo
+
+///// Header files ////////////////////////////////////////////////////////////
+
+// Qt header files
+#include <qglobal.h>
+
+// Platform dependent header files (after the Qt headers which define Q_OS_WIN32)
+#ifdef Q_OS_WIN32
+  #define NOMINMAX // keeps std::min and std::max usable
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+// Xbrabo header files
+#include "systeminfo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///// Public Members                                                      /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// numProcessors ///////////////////////////////////////////////////////////
+unsigned int SystemInfo::numProcessors()
+/// Returns the number of processors available for running threads.
+{
+#ifdef Q_OS_WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const long result = static_cast<long>(info.dwNumberOfProcessors);
+#else
+  const long result = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return result > 0 ? static_cast<unsigned int>(result) : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// Private Members                                                     /////
+///////////////////////////////////////////////////////////////////////////////
+
+///// Constructor /////////////////////////////////////////////////////////////
+SystemInfo::SystemInfo()
+/// The default constructor. Made private to inhibit instantations.
+{
+}
+